@@ -2,11 +2,21 @@
 #ifndef _ALGORITHM_QMJ_
 #define _ALGORITHM_QMJ_
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 #include <utility>
 #include "allocator.h"
+#include "execution_qmj.h"
+#include "simd_qmj.h"
 
 namespace qmj {
     constexpr size_t sort_threshold = 32;
+    //a parallel sort stops forking once a partition is smaller than this
+    constexpr size_t sort_fork_grain = 1 << 14;
+    //a parallel merge stops forking once its output is smaller than this
+    constexpr size_t merge_fork_grain = 1 << 14;
 
     template<typename Iter>
     inline Iter next(Iter cur, _QMJ iter_dif_t<Iter> dif) {
@@ -21,10 +31,15 @@ namespace qmj {
 
     template<typename Iter>
     inline Iter prev(Iter cur, _QMJ iter_dif_t<Iter> dif) {
-        _QMJ advance(cur, dif);
+        _QMJ advance(cur, -dif);
         return (cur);
     }
 
+    template<typename Iter>
+    inline Iter prev(Iter cur) {
+        return (--cur);
+    }
+
     template<typename Iter>
     inline Iter pre(Iter cur) {
         return (--cur);
@@ -90,8 +105,43 @@ namespace qmj {
         return (_QMJ min(first, last, std::less<>()));
     }
 
+    //integer keys in contiguous storage, looked up by value or compared
+    //with ==, are scanned by the vector kernels of simd_qmj.h
+    template<typename Iter>
+    struct _simd_scan_key : std::remove_cv<iter_val_t<Iter>> {
+    };
+
+    template<typename Iter, typename value_type>
+    struct _simd_scannable : bool_type<is_mem_copy<Iter>::value &&
+                                       is_simd_scannable<typename _simd_scan_key<Iter>::type>::value &&
+                                       std::is_integral<value_type>::value> {
+    };
+
     template<typename Iter1, typename Iter2, typename Pred>
-    inline std::pair<Iter1, Iter2> mismatch(Iter1 first1, Iter1 last1, Iter2 first2, const Pred &pred) {
+    struct _simd_pair_scannable : bool_type<_simd_scannable<Iter1, typename _simd_scan_key<Iter1>::type>::value &&
+                                            is_mem_copy<Iter2>::value &&
+                                            is_same<typename _simd_scan_key<Iter1>::type,
+                                                    typename _simd_scan_key<Iter2>::type>::value &&
+                                            (is_same<Pred, std::equal_to<>>::value ||
+                                             is_same<Pred, std::equal_to<typename _simd_scan_key<Iter1>::type>>::value)> {
+    };
+
+    template<typename Iter>
+    inline const typename _simd_scan_key<Iter>::type *_simd_scan_ptr(Iter cur) {
+        return (&*cur);
+    }
+
+    //whether val comes back from a key unchanged, compared in the common
+    //type of the two just as *first == val would compare them
+    template<typename key, typename value_type>
+    inline bool _simd_key_holds(const value_type &val) {
+        typedef typename std::common_type<key, value_type>::type common;
+        return (static_cast<common>(static_cast<key>(val)) == static_cast<common>(val));
+    }
+
+    template<typename Iter1, typename Iter2, typename Pred>
+    inline std::pair<Iter1, Iter2> _mismatch_imple(Iter1 first1, Iter1 last1, Iter2 first2, const Pred &pred,
+                                                   false_type) {
         for (; first1 != last1 && pred(*first1, *first2);) {
             ++first1;
             ++first2;
@@ -100,13 +150,28 @@ namespace qmj {
     }
 
     template<typename Iter1, typename Iter2, typename Pred>
+    inline std::pair<Iter1, Iter2> _mismatch_imple(Iter1 first1, Iter1 last1, Iter2 first2, const Pred &,
+                                                   true_type) {
+        if (first1 == last1)
+            return (std::pair<Iter1, Iter2>(first1, first2));
+        const size_t pos = _QMJ simd_find_pair(_simd_scan_ptr(first1), _simd_scan_ptr(first2),
+                                               size_t(last1 - first1), false);
+        return (std::pair<Iter1, Iter2>(first1 + pos, first2 + pos));
+    }
+
+    template<typename Iter1, typename Iter2, typename Pred>
+    inline std::pair<Iter1, Iter2> mismatch(Iter1 first1, Iter1 last1, Iter2 first2, const Pred &pred) {
+        return (_QMJ _mismatch_imple(first1, last1, first2, pred, _simd_pair_scannable<Iter1, Iter2, Pred>()));
+    }
+
+    template<typename Iter1, typename Iter2>
     inline std::pair<Iter1, Iter2> mismatch(Iter1 first1, Iter1 last1, Iter2 first2) {
         return (_QMJ mismatch(first1, last1, first2, std::equal_to<>()));
     }
 
     template<typename Iter1, typename Iter2, typename Pred>
-    inline std::pair<Iter1, Iter2> mismatch(Iter1 first1, Iter1 last1, Iter2 first2,
-                                            Iter2 last2, const Pred &pred) {
+    inline std::pair<Iter1, Iter2> _mismatch_imple(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2,
+                                                   const Pred &pred, false_type) {
         for (; first1 != last1 && first2 != last2 && pred(*first1, *first2);) {
             ++first1;
             ++first2;
@@ -114,138 +179,86 @@ namespace qmj {
         return (std::pair<Iter1, Iter2>(first1, first2));
     }
 
-    template<typename Iter1, typename Iter2>
-    inline std::pair<Iter1, Iter2> mismatch(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2) {
-        return (_QMJ mismatch(first1, last1, first2, last2, std::equal_to<>()));
+    template<typename Iter1, typename Iter2, typename Pred>
+    inline std::pair<Iter1, Iter2> _mismatch_imple(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2,
+                                                   const Pred &pred, true_type) {
+        if (last2 - first2 < last1 - first1)
+            last1 = first1 + (last2 - first2);
+        return (_QMJ _mismatch_imple(first1, last1, first2, pred, true_type()));
     }
 
-    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
-    inline OIter set_union(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest, const Comp &cmp) {
-        if (first1 != last1 && first2 != last2) {
-            for (;;) {
-                if (cmp(*first1, *first2)) {
-                    *dest++ = *first1;
-                    if (++first1 == last1)
-                        break;
-                } else if (cmp(*first2, *first1)) {
-                    *dest++ = *first2;
-                    if (++first2 == last2)
-                        break;
-                } else {
-                    *dest = *first1;
-                    ++first1;
-                    ++first2;
-                    if (first1 == last1 || first2 = last2)
-                        break;
-                }
-            }
-        }
-        dest = std::copy(first1, last1, dest);
-        return (std::copy(first2, last2, dest));
+    template<typename Iter1, typename Iter2, typename Pred>
+    inline std::pair<Iter1, Iter2> mismatch(Iter1 first1, Iter1 last1, Iter2 first2,
+                                            Iter2 last2, const Pred &pred) {
+        return (_QMJ _mismatch_imple(first1, last1, first2, last2, pred,
+                                     _simd_pair_scannable<Iter1, Iter2, Pred>()));
     }
 
-    template<typename IIter1, typename IIter2, typename OIter>
-    inline OIter set_union(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest) {
-        return (_QMJ set_union(first1, last1, first2, last2, dest, std::less<>()));
+    template<typename Iter1, typename Iter2>
+    inline std::pair<Iter1, Iter2> mismatch(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2) {
+        return (_QMJ mismatch(first1, last1, first2, last2, std::equal_to<>()));
     }
 
-    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
-    inline OIter set_intersection(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
-                                  OIter dest, const Comp &cmp) {
-        if (first1 != last1 && first2 != last2) {
-            for (;;) {
-                if (cmp(*first1, *first2)) {
-                    if (++first1 == last1)
-                        break;
-                } else if (cmp(*first2, *first1)) {
-                    if (++first2 == last2)
-                        break;
-                } else {
-                    *dest++ = *first1;
-                    ++first1;
-                    ++first2;
-                    if (first1 == last1 || first2 == last2)
-                        break;
-                }
-            }
-        }
-        return (dest);
+    template<typename Iter1, typename Iter2, typename Pred>
+    inline bool equal(Iter1 first1, Iter1 last1, Iter2 first2, const Pred &pred) {
+        return (_QMJ mismatch(first1, last1, first2, pred).first == last1);
     }
 
-    template<typename IIter1, typename IIter2, typename OIter>
-    inline OIter set_intersection(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
-                                  OIter dest) {
-        return (_QMJ set_intersection(first1, last1, first2, last2, dest, std::less<>()));
+    template<typename Iter1, typename Iter2>
+    inline bool equal(Iter1 first1, Iter1 last1, Iter2 first2) {
+        return (_QMJ equal(first1, last1, first2, std::equal_to<>()));
     }
 
-    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
-    inline OIter set_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
-                                OIter dest, const Comp &cmp) {
-        if (first1 != last1 && first2 != last2) {
-            for (;;) {
-                if (cmp(*first1, *first2)) {
-                    *dest++ = *first1;
-                    if (++first1 == last1)
-                        break;
-                } else if (cmp(*first2, *first1)) {
-                    if (++first2 == last2)
-                        break;
-                } else {
-                    ++first1;
-                    ++first2;
-                    if (first1 == last1 || first2 == last2)
-                        break;
-                }
-            }
-        }
-        return (std::copy(first1, last1, dest));
+    template<typename Iter1, typename Iter2, typename Pred>
+    inline bool _equal_imple(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, const Pred &pred,
+                             std::input_iterator_tag, std::input_iterator_tag) {
+        const std::pair<Iter1, Iter2> pos = _QMJ mismatch(first1, last1, first2, last2, pred);
+        return (pos.first == last1 && pos.second == last2);
     }
 
-    template<typename IIter1, typename IIter2, typename OIter>
-    inline OIter set_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
-                                OIter dest) {
-        return (_QMJ set_difference(first1, last1, first2, last2, dest, std::less<>()));
+    //ranges of different lengths are told apart without a scan
+    template<typename RIter1, typename RIter2, typename Pred>
+    inline bool _equal_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2, const Pred &pred,
+                             std::random_access_iterator_tag, std::random_access_iterator_tag) {
+        if (last1 - first1 != last2 - first2)
+            return (false);
+        return (_QMJ equal(first1, last1, first2, pred));
     }
 
-    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
-    inline OIter set_symmetric_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
-                                          OIter dest, const Comp &cmp) {
-        if (first1 != last1 && first2 != last2) {
-            for (;;) {
-                if (cmp(*first1, *first2)) {
-                    *dest++ = *first1;
-                    if (++first1 == last1)
-                        break;
-                } else if (cmp(*first2, *first1)) {
-                    *dest++ = *first2;
-                    if (++first2 == last2)
-                        break;
-                } else {
-                    ++first1;
-                    ++first2;
-                    if (first1 == last1 || first2 == last2)
-                        break;
-                }
-            }
-        }
-        dest = std::copy(first2, last2, dest);
-        return (std::copy(first1, last1, dest));
+    template<typename Iter1, typename Iter2, typename Pred>
+    inline bool equal(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, const Pred &pred) {
+        return (_QMJ _equal_imple(first1, last1, first2, last2, pred, iter_cate_t<Iter1>(), iter_cate_t<Iter2>()));
     }
 
-    template<typename IIter1, typename IIter2, typename OIter>
-    inline OIter set_symmetric_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
-                                          OIter dest) {
-        return (_QMJ set_symmetric_difference(first1, last1, first2, last2, dest, std::less<>()));
+    template<typename Iter1, typename Iter2>
+    inline bool equal(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2) {
+        return (_QMJ equal(first1, last1, first2, last2, std::equal_to<>()));
     }
 
     template<typename FIter, typename Pred>
-    inline FIter adjacent_find(FIter first, FIter last, const Pred &pred) {
+    inline FIter _adjacent_find_imple(FIter first, FIter last, const Pred &pred, false_type) {
         if (first != last) {
             for (FIter next = first; ++next != last; first = next)
                 if (pred(*first, *next))
                     return (first);
         }
-        return (first);
+        return (last);
+    }
+
+    //each key is compared with the next by reading the range twice, one
+    //key apart
+    template<typename FIter, typename Pred>
+    inline FIter _adjacent_find_imple(FIter first, FIter last, const Pred &, true_type) {
+        if (last - first < 2)
+            return (last);
+        const size_t n = size_t(last - first) - 1;
+        const size_t pos = _QMJ simd_find_pair(_simd_scan_ptr(first), _simd_scan_ptr(first) + 1, n, true);
+        return (pos == n ? last : first + pos);
+    }
+
+    template<typename FIter, typename Pred>
+    inline FIter adjacent_find(FIter first, FIter last, const Pred &pred) {
+        return (_QMJ _adjacent_find_imple(first, last, pred, _simd_pair_scannable<FIter, FIter, Pred>()));
     }
 
     template<typename FIter>
@@ -263,13 +276,27 @@ namespace qmj {
     }
 
     template<typename Iter, typename value_type>
-    iter_dif_t<Iter> inline count(Iter first, Iter last, const value_type &val) {
+    inline iter_dif_t<Iter> _count_imple(Iter first, Iter last, const value_type &val, false_type) {
         iter_dif_t<Iter> counter = 0;
         for (; first != last; ++first)
             if (*first == val) ++counter;
         return (counter);
     }
 
+    //a value no key can hold equals none of them
+    template<typename Iter, typename value_type>
+    inline iter_dif_t<Iter> _count_imple(Iter first, Iter last, const value_type &val, true_type) {
+        typedef typename _simd_scan_key<Iter>::type key;
+        if (first == last || !_simd_key_holds<key>(val))
+            return (0);
+        return (iter_dif_t<Iter>(_QMJ simd_count(_simd_scan_ptr(first), size_t(last - first), static_cast<key>(val))));
+    }
+
+    template<typename Iter, typename value_type>
+    iter_dif_t<Iter> inline count(Iter first, Iter last, const value_type &val) {
+        return (_QMJ _count_imple(first, last, val, _simd_scannable<Iter, value_type>()));
+    }
+
     template<typename FIter, typename Pred>
     FIter _partition_imple(FIter first, FIter last, const Pred &pred, std::forward_iterator_tag) {
         for (; first != last && pred(*first);)
@@ -316,14 +343,169 @@ namespace qmj {
         return (last1);
     }
 
-    template<typename FIter1, typename FIter2, typename Pred>
-    inline FIter1 _search_imple(FIter1 first1, FIter1 last1, FIter2 first2, FIter2 last2,
-                                const Pred &pred, std::random_access_iterator_tag, std::random_access_iterator_tag) {
-        iter_dif_t<FIter1> count1 = last1 - first1;
-        iter_dif_t<FIter2> count2 = last2 - first2;
+    //the critical factorization of a needle for the two-way search: keys
+    //after split are matched forward, then the ones up to it backward, and
+    //a periodic needle remembers how much of its left half already matched
+    template<typename Dif>
+    struct _two_way_factor {
+        Dif split;
+        Dif period;
+        bool periodic;
+    };
+
+    //start of the maximal suffix of the needle, lexicographically or in
+    //reverse order, and the period of that suffix
+    template<typename RIter>
+    inline iter_dif_t<RIter> _max_suffix(RIter needle, const iter_dif_t<RIter> m, iter_dif_t<RIter> &period,
+                                         const bool reversed) {
+        typedef iter_dif_t<RIter> Dif;
+        Dif start = -1, j = 0, k = 1;
+        period = 1;
+        while (j + k < m) {
+            const auto &a = needle[j + k];
+            const auto &b = needle[start + k];
+            if (reversed ? b < a : a < b) {
+                j += k;
+                k = 1;
+                period = j - start;
+            } else if (a == b) {
+                if (k != period)
+                    ++k;
+                else {
+                    j += period;
+                    k = 1;
+                }
+            } else {
+                start = j++;
+                k = period = 1;
+            }
+        }
+        return (start);
+    }
+
+    template<typename RIter>
+    inline _two_way_factor<iter_dif_t<RIter>> _two_way_factorize(RIter needle, const iter_dif_t<RIter> m) {
+        typedef iter_dif_t<RIter> Dif;
+        Dif period1, period2;
+        const Dif split1 = _QMJ _max_suffix(needle, m, period1, false);
+        const Dif split2 = _QMJ _max_suffix(needle, m, period2, true);
+        _two_way_factor<Dif> factor;
+        factor.split = split1 > split2 ? split1 : split2;
+        factor.period = split1 > split2 ? period1 : period2;
+        factor.periodic = true;
+        for (Dif i = 0; i <= factor.split; ++i)
+            if (!(needle[i] == needle[i + factor.period])) {
+                factor.periodic = false;
+                break;
+            }
+        if (!factor.periodic) {
+            const Dif left = factor.split + 1, right = m - factor.split - 1;
+            factor.period = (left > right ? left : right) + 1;
+        }
+        return (factor);
+    }
+
+    //the first match starting at or after pos, n when there is none; no
+    //haystack key is compared more than twice
+    template<typename RIter1, typename RIter2, typename Dif>
+    inline Dif _two_way_search(RIter1 hay, const Dif n, Dif pos, RIter2 needle, const Dif m,
+                               const _two_way_factor<Dif> &factor) {
+        const Dif split = factor.split, period = factor.period;
+        Dif memory = -1;
+        while (pos <= n - m) {
+            Dif i = (split > memory ? split : memory) + 1;
+            for (; i < m && needle[i] == hay[pos + i]; ++i);
+            if (i < m) {
+                pos += i - split;
+                memory = -1;
+                continue;
+            }
+            for (i = split; i > memory && needle[i] == hay[pos + i]; --i);
+            if (i <= memory)
+                return (pos);
+            pos += period;
+            memory = factor.periodic ? m - period - 1 : -1;
+        }
+        return (n);
+    }
+
+    //horspool over byte keys from pos on: the key under the needle's last
+    //position says how far the needle can move; like the vector kernels it
+    //gives up where its comparisons outgrow the scan
+    template<typename RIter1, typename RIter2, typename Dif>
+    inline Dif _horspool_search(RIter1 hay, const Dif n, Dif pos, RIter2 needle, const Dif m, bool &matched) {
+        Dif shift[256];
+        for (int c = 0; c != 256; ++c)
+            shift[c] = m;
+        for (Dif i = 0; i != m - 1; ++i)
+            shift[uint8_t(needle[i])] = m - 1 - i;
+        const auto last_key = needle[m - 1];
+        const Dif begin = pos;
+        matched = false;
+        size_t work = 0;
+        while (pos <= n - m) {
+            const auto key = hay[pos + m - 1];
+            if (key == last_key) {
+                Dif i = 0;
+                for (; i != m - 1 && hay[pos + i] == needle[i]; ++i);
+                if (i == m - 1) {
+                    matched = true;
+                    return (pos);
+                }
+                if (_QMJ _search_budget_spent(work += size_t(i + 1), size_t(pos - begin)))
+                    return (pos + 1);
+            }
+            pos += shift[uint8_t(key)];
+        }
+        return (n);
+    }
+
+    //byte needles at least this long are searched with horspool where no
+    //vector kernel runs; it skips most of the haystack the two-way reads
+    constexpr size_t horspool_threshold = 4;
+
+    //the scalar search from pos on, for needles of 2 <= m <= n integer keys
+    template<typename RIter1, typename RIter2, typename Dif>
+    inline Dif _scalar_search(RIter1 hay, const Dif n, Dif pos, RIter2 needle, const Dif m) {
+        if (sizeof(*needle) == 1 && size_t(m) >= horspool_threshold) {
+            bool matched;
+            pos = _QMJ _horspool_search(hay, n, pos, needle, m, matched);
+            if (matched || pos > n - m)
+                return (matched ? pos : n);
+        }
+        return (_QMJ _two_way_search(hay, n, pos, needle, m, _QMJ _two_way_factorize(needle, m)));
+    }
+
+    struct _search_naive_tag {
+    };
+
+    struct _search_two_way_tag {
+    };
+
+    struct _search_simd_tag {
+    };
+
+    //integer keys compared with == get horspool or the two-way search, in
+    //contiguous storage behind the vector filter; anything else is
+    //compared in place
+    template<typename RIter1, typename RIter2, typename Pred>
+    struct _search_kernel
+            : If<_simd_pair_scannable<RIter1, RIter2, Pred>::value, _search_simd_tag,
+                    typename If<std::is_integral<typename _simd_scan_key<RIter1>::type>::value &&
+                                is_same<typename _simd_scan_key<RIter1>::type,
+                                        typename _simd_scan_key<RIter2>::type>::value &&
+                                is_same<Pred, std::equal_to<>>::value,
+                            _search_two_way_tag, _search_naive_tag>::type> {
+    };
+
+    template<typename RIter1, typename RIter2, typename Pred>
+    inline RIter1 _search_dispatch(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+                                   const Pred &pred, _search_naive_tag) {
+        iter_dif_t<RIter1> count1 = last1 - first1;
+        iter_dif_t<RIter2> count2 = last2 - first2;
         for (; count2 <= count1; --count1, ++first1) {
-            FIter1 cpf1 = first1;
-            for (FIter2 cpf2 = first2;; ++cpf1, ++cpf2) {
+            RIter1 cpf1 = first1;
+            for (RIter2 cpf2 = first2;; ++cpf1, ++cpf2) {
                 if (cpf2 == last2)
                     return (first1);
                 else if (!pred(*cpf1, *cpf2))
@@ -333,6 +515,47 @@ namespace qmj {
         return (last1);
     }
 
+    template<typename RIter1, typename RIter2, typename Pred>
+    inline RIter1 _search_dispatch(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+                                   const Pred &, _search_two_way_tag) {
+        typedef iter_dif_t<RIter1> Dif;
+        const Dif n = last1 - first1, m = Dif(last2 - first2);
+        if (!m)
+            return (first1);
+        if (m > n)
+            return (last1);
+        if (m == 1)
+            return (_QMJ _search_dispatch(first1, last1, first2, last2, std::equal_to<>(), _search_naive_tag()));
+        return (first1 + _QMJ _scalar_search(first1, n, Dif(0), first2, m));
+    }
+
+    template<typename RIter1, typename RIter2, typename Pred>
+    inline RIter1 _search_dispatch(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+                                   const Pred &, _search_simd_tag) {
+        typedef iter_dif_t<RIter1> Dif;
+        const Dif n = last1 - first1, m = Dif(last2 - first2);
+        if (!m)
+            return (first1);
+        if (m > n)
+            return (last1);
+        if (m == 1)
+            return (first1 + _QMJ simd_find(_simd_scan_ptr(first1), size_t(n), *_simd_scan_ptr(first2), true));
+        bool matched;
+        const Dif pos = Dif(_QMJ simd_search(_simd_scan_ptr(first1), size_t(n), _simd_scan_ptr(first2),
+                                             size_t(m), matched));
+        if (matched)
+            return (first1 + pos);
+        if (pos > n - m)
+            return (last1);
+        return (first1 + _QMJ _scalar_search(first1, n, pos, first2, m));
+    }
+
+    template<typename RIter1, typename RIter2, typename Pred>
+    inline RIter1 _search_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+                                const Pred &pred, std::random_access_iterator_tag, std::random_access_iterator_tag) {
+        return (_QMJ _search_dispatch(first1, last1, first2, last2, pred, typename _search_kernel<RIter1, RIter2, Pred>::type()));
+    }
+
     template<typename FIter1, typename FIter2, typename Pred>
     inline FIter1 search(FIter1 first1, FIter1 last1, FIter2 first2, FIter2 last2,
                          const Pred &pred) {
@@ -345,6 +568,12 @@ namespace qmj {
         return (_QMJ search(first1, last1, first2, last2, std::equal_to<>()));
     }
 
+    //a searcher holds a needle prepared once, see searcher_qmj.h
+    template<typename FIter, typename Searcher>
+    inline FIter search(FIter first, FIter last, const Searcher &searcher) {
+        return (searcher(first, last).first);
+    }
+
     template<typename FIter, typename Dif, typename value_type, typename Pred>
     inline FIter _search_n_imple(FIter first, FIter last, Dif n,
                                  const value_type &val, const Pred &pred, std::forward_iterator_tag) {
@@ -386,23 +615,72 @@ namespace qmj {
         return (last);
     }
 
+    //a run can only start at a key equal to val and ends at the first key
+    //that is not, both found by the scan kernels; runs longer than a cache
+    //line are left to the strided probe, which reads less of the range
     template<typename FIter, typename Dif, typename value_type, typename Pred>
-    inline FIter search_n(FIter first, FIter last, Dif n, const value_type &val, const Pred &pred) {
+    inline FIter _search_n_scan(FIter first, FIter last, Dif n, const value_type &val, const Pred &pred,
+                                true_type) {
+        typedef typename _simd_scan_key<FIter>::type key;
+        if (n <= 0)
+            return (first);
+        if (size_t(n) * sizeof(key) > 64)
+            return (_QMJ _search_n_imple(first, last, n, val, pred, iter_cate_t<FIter>()));
+        if (first == last || !_simd_key_holds<key>(val))
+            return (last);
+        const key *base = _simd_scan_ptr(first);
+        const key k = static_cast<key>(val);
+        const size_t len = size_t(last - first), run = size_t(n);
+        for (size_t pos = 0;;) {
+            pos += _QMJ simd_find(base + pos, len - pos, k, true);
+            if (len - pos < run)
+                return (last);
+            const size_t equal_len = _QMJ simd_find(base + pos, run, k, false);
+            if (equal_len == run)
+                return (first + pos);
+            pos += equal_len;
+        }
+    }
+
+    template<typename FIter, typename Dif, typename value_type, typename Pred>
+    inline FIter _search_n_scan(FIter first, FIter last, Dif n, const value_type &val, const Pred &pred,
+                                false_type) {
         return (_QMJ _search_n_imple(first, last, n, val, pred, iter_cate_t<FIter>()));
     }
 
+    template<typename FIter, typename Dif, typename value_type, typename Pred>
+    inline FIter search_n(FIter first, FIter last, Dif n, const value_type &val, const Pred &pred) {
+        return (_QMJ _search_n_scan(first, last, n, val, pred,
+                                    bool_type<_simd_scannable<FIter, value_type>::value &&
+                                              is_same<Pred, std::equal_to<>>::value>()));
+    }
+
     template<typename FIter, typename Dif, typename value_type>
     inline FIter search_n(FIter first, FIter last, Dif n, const value_type &val) {
         return (_QMJ search_n(first, last, n, val, std::equal_to<>()));
     }
 
     template<typename Iter, typename value_type>
-    inline Iter find(Iter first, Iter last, const value_type &val) {
+    inline Iter _find_imple(Iter first, Iter last, const value_type &val, false_type) {
         for (; first != last && *first != val;)
             ++first;
         return (first);
     }
 
+    //a value no key can hold is not there
+    template<typename Iter, typename value_type>
+    inline Iter _find_imple(Iter first, Iter last, const value_type &val, true_type) {
+        typedef typename _simd_scan_key<Iter>::type key;
+        if (first == last || !_simd_key_holds<key>(val))
+            return (last);
+        return (first + _QMJ simd_find(_simd_scan_ptr(first), size_t(last - first), static_cast<key>(val), true));
+    }
+
+    template<typename Iter, typename value_type>
+    inline Iter find(Iter first, Iter last, const value_type &val) {
+        return (_QMJ _find_imple(first, last, val, _simd_scannable<Iter, value_type>()));
+    }
+
     template<typename Iter, typename Pred>
     inline Iter find_if(Iter first, Iter last, const Pred &pred) {
         for (; first != last && (!pred(*first));)
@@ -492,32 +770,6 @@ namespace qmj {
         return (first);
     }
 
-    template<typename IIter1, typename IIter2, typename Comp>
-    inline bool includes(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
-                         const Comp &cmp) {
-        if (first1 != last1 && first2 != last2) {
-            for (;;) {
-                if (cmp(*first2, *first1))
-                    return (false);
-                else if (cmp(*first1, *first2)) {
-                    if (++first1 == last1)
-                        break;
-                } else {
-                    ++first1;
-                    ++first2;
-                    if (first1 == last1 || first2 == last2)
-                        break;
-                }
-            }
-        }
-        return (first2 == last2);
-    }
-
-    template<typename IIter1, typename IIter2>
-    inline bool includes(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2) {
-        return (_QMJ includes(first1, last1, first2, last2, std::less<>()));
-    }
-
     template<typename FIter, typename Comp>
     inline FIter max_element(FIter first, FIter last, const Comp &cmp) {
         FIter result = first;
@@ -598,7 +850,7 @@ namespace qmj {
 
     template<typename Iter, typename Pred>
     inline Iter remove_if(Iter first, Iter last, const Pred &pred) {
-        first = _QMJ find(first, last, pred);
+        first = _QMJ find_if(first, last, pred);
         if (first != last) {
             for (Iter next = first; ++next != last;)
                 if (!pred(*next))
@@ -1061,44 +1313,6 @@ namespace qmj {
         _QMJ make_heap(first, last, std::less<>());
     }
 
-    template<typename RIter, typename Comp>
-    inline void partial_sort(RIter first, RIter middle, RIter last, const Comp &cmp) {
-        iter_dif_t<RIter> len = middle - first;
-        if (!len)
-            return;
-        else if (len == 1) {
-            _QMJ iter_swap(first, _QMJ min_element(first, last, cmp));
-            return;
-        }
-        _QMJ make_heap(first, middle, cmp);
-        for (RIter cur = middle; cur != last; ++cur) {
-            if (cmp(*cur, *first)) {
-                iter_val_t<RIter> val = std::move(*cur);
-                *cur = std::move(*first);
-                _QMJ _heapify(first, iter_dif_t<RIter>(0), len, std::move(val), cmp);
-            }
-        }
-        _QMJ sort_heap(first, middle, cmp);
-    }
-
-    template<typename RIter>
-    inline void partial_sort(RIter first, RIter middle, RIter last) {
-        _QMJ partial_sort(first, middle, last, std::less<>());
-    }
-
-    template<typename IIter, typename RIter, typename Comp>
-    inline RIter partial_sort_copy(IIter first, IIter last, RIter dest_first, RIter dest_last,
-                                   const Comp &cmp) {
-        RIter result = std::copy(first, last, dest_first);
-        _QMJ partial_sort(dest_first, result, result, cmp);
-        return (result);
-    }
-
-    template<typename IIter, typename RIter>
-    inline RIter partial_sort_copy(IIter first, IIter last, RIter dest_first, RIter dest_last) {
-        return (_QMJ partial_sort_copy(first, last, dest_first, dest_last, std::less<>()));
-    }
-
     template<typename BIter, typename value_type, typename Comp>
     inline void _unguarded_linear_insert(BIter last, value_type val, const Comp &cmp) {
         for (BIter prev = _QMJ prev(last); cmp(val, *prev); last = prev, --prev)
@@ -1116,7 +1330,7 @@ namespace qmj {
     inline void _linear_insert(BIter first, BIter last, const Comp &cmp) {
         iter_val_t<BIter> val = std::move(*last);
         if (cmp(val, *first)) {
-            std::copy_backward(first, last, last + 1);
+            std::copy_backward(first, last, _QMJ next(last));
             *first = std::move(val);
         } else
             _unguarded_linear_insert(last, std::move(val), cmp);
@@ -1135,80 +1349,377 @@ namespace qmj {
         _QMJ _insert_sort_imple(first, last, cmp);
     }
 
+    inline size_t _lg2(size_t n) {
+        size_t k = 0;
+        for (; n > 1; n >>= 1)
+            ++k;
+        return (k);
+    }
+
+    //pdqsort tuning: pivots are ninthers above ninther_threshold, blocks of
+    //pdq_block_size comparisons are buffered before any swap, and a run
+    //that is almost sorted is finished by insertion sort only while it
+    //needs fewer than pdq_partial_insert_limit moves
+    constexpr size_t ninther_threshold = 128;
+    constexpr size_t pdq_block_size = 64;
+    constexpr size_t pdq_partial_insert_limit = 8;
+
+    //the block partition pays off when a comparison is one cheap
+    //instruction whose outcome can be used as a number
     template<typename value_type, typename Comp>
-    inline const value_type &_get_piovt(const value_type &a, const value_type &b,
-                                        const value_type &c, const Comp &cmp) {
-        if (cmp(a, b)) {
-            if (cmp(b, c))
-                return (b);
-            else if (cmp(a, c))
-                return (c);
-            else
-                return (a);
-        } else if (cmp(a, c))
-            return (a);
-        else if (cmp(b, c))
-            return (c);
-        else
-            return (b);
+    struct _pdq_branchless : bool_type<std::is_arithmetic<value_type>::value &&
+                                       (is_same<Comp, std::less<>>::value ||
+                                        is_same<Comp, std::less<value_type>>::value ||
+                                        is_same<Comp, std::greater<>>::value ||
+                                        is_same<Comp, std::greater<value_type>>::value)> {
+    };
+
+    template<typename RIter, typename Comp>
+    inline void _sort3(RIter a, RIter b, RIter c, const Comp &cmp) {
+        if (cmp(*b, *a))
+            std::iter_swap(a, b);
+        if (cmp(*c, *b))
+            std::iter_swap(b, c);
+        if (cmp(*b, *a))
+            std::iter_swap(a, b);
     }
 
+    //moves the median of three, or of three medians for a long range, to
+    //*first
     template<typename RIter, typename Comp>
-    inline RIter _mid_partition(RIter first, RIter last, const Comp &cmp) {
-        iter_val_t<RIter> piovt = _get_piovt(
-                *first, *(first + ((size_t) (last - first) >> 1)), *(last - 1), cmp);
-        for (;; ++first) {
-            for (; cmp(*first, piovt); ++first);
-            for (--last; cmp(piovt, *last); --last);
-            if (!(first < last))
-                return (first);
-            _QMJ iter_swap(first, last);
-        }
-        return (first);
+    inline void _pdq_choose_pivot(RIter first, RIter last, const Comp &cmp) {
+        const iter_dif_t<RIter> len = last - first;
+        const iter_dif_t<RIter> half = len / 2;
+        if (size_t(len) > ninther_threshold) {
+            _sort3(first, first + half, last - 1, cmp);
+            _sort3(first + 1, first + (half - 1), last - 2, cmp);
+            _sort3(first + 2, first + (half + 1), last - 3, cmp);
+            _sort3(first + (half - 1), first + half, first + (half + 1), cmp);
+            std::iter_swap(first, first + half);
+        } else
+            _sort3(first + half, first, last - 1, cmp);
     }
 
+    //insertion sort that gives up, returning false, once it has moved more
+    //than pdq_partial_insert_limit elements
     template<typename RIter, typename Comp>
-    inline void _introsort_imple(RIter first, RIter last, size_t depth_limit, const Comp &cmp) {
-        for (; last - first > sort_threshold;) {
-            if (depth_limit-- == 0) {
-                _QMJ _make_heap_imple(first, iter_dif_t<RIter>(last - first), cmp);
-                _QMJ sort_heap(first, last, cmp);
-                return;
+    inline bool _partial_insert_sort(RIter first, RIter last, const Comp &cmp) {
+        if (first == last)
+            return (true);
+        size_t moves = 0;
+        for (RIter cur = first + 1; cur != last; ++cur) {
+            RIter sift = cur;
+            RIter sift_1 = cur - 1;
+            if (cmp(*sift, *sift_1)) {
+                iter_val_t<RIter> val = std::move(*sift);
+                do {
+                    *sift-- = std::move(*sift_1);
+                } while (sift != first && cmp(val, *--sift_1));
+                *sift = std::move(val);
+                moves += size_t(cur - sift);
             }
+            if (moves > pdq_partial_insert_limit)
+                return (false);
+        }
+        return (true);
+    }
 
-            RIter cut = _mid_partition(first, last, cmp);
+    //partitions around the pivot at *first into [< pivot] pivot [>= pivot]
+    //and returns the pivot's place, plus whether nothing had to move
+    template<typename RIter, typename Comp>
+    inline std::pair<RIter, bool> _pdq_partition_right(RIter first, RIter last, const Comp &cmp, false_type) {
+        iter_val_t<RIter> pivot(std::move(*first));
+        RIter lo = first;
+        RIter hi = last;
+        while (cmp(*++lo, pivot));
+        if (lo - 1 == first)
+            while (lo < hi && !cmp(*--hi, pivot));
+        else
+            while (!cmp(*--hi, pivot));
+        const bool already_partitioned = lo >= hi;
+        while (lo < hi) {
+            std::iter_swap(lo, hi);
+            while (cmp(*++lo, pivot));
+            while (!cmp(*--hi, pivot));
+        }
+        RIter pivot_pos = lo - 1;
+        *first = std::move(*pivot_pos);
+        *pivot_pos = std::move(pivot);
+        return (std::pair<RIter, bool>(pivot_pos, already_partitioned));
+    }
 
-            if (cut - first > last - cut) {
-                _introsort_imple(cut, last, depth_limit, cmp);
-                last = cut;
-            } else {
-                _introsort_imple(first, cut, depth_limit, cmp);
-                first = cut;
+    //swaps the misplaced elements recorded by the block partition; when
+    //both sides hold the same count a cyclic move saves a third of the
+    //writes
+    template<typename RIter>
+    inline void _pdq_swap_offsets(RIter first, RIter last, const unsigned char *offsets_l,
+                                  const unsigned char *offsets_r, size_t num, bool use_swaps) {
+        if (use_swaps) {
+            for (size_t i = 0; i != num; ++i)
+                std::iter_swap(first + offsets_l[i], last - offsets_r[i]);
+        } else if (num) {
+            RIter l = first + offsets_l[0];
+            RIter r = last - offsets_r[0];
+            iter_val_t<RIter> val(std::move(*l));
+            *l = std::move(*r);
+            for (size_t i = 1; i != num; ++i) {
+                l = first + offsets_l[i];
+                *r = std::move(*l);
+                r = last - offsets_r[i];
+                *l = std::move(*r);
             }
+            *r = std::move(val);
         }
     }
 
+    //the same partition as above, but comparisons only record offsets of
+    //misplaced elements a block at a time (BlockQuicksort), so the loop
+    //has no data dependent branch to mispredict
     template<typename RIter, typename Comp>
-    inline void _final_insert_sort(RIter first, RIter last, const Comp &cmp) {
-        if (last - first > sort_threshold) {
-            _insert_sort(first, first + sort_threshold, cmp);
-            _unguarded_insert_sort(first + sort_threshold, last, cmp);
-        } else
+    inline std::pair<RIter, bool> _pdq_partition_right(RIter begin, RIter end, const Comp &cmp, true_type) {
+        iter_val_t<RIter> pivot(std::move(*begin));
+        RIter first = begin;
+        RIter last = end;
+        while (cmp(*++first, pivot));
+        if (first - 1 == begin)
+            while (first < last && !cmp(*--last, pivot));
+        else
+            while (!cmp(*--last, pivot));
+        const bool already_partitioned = first >= last;
+        if (!already_partitioned) {
+            std::iter_swap(first, last);
+            ++first;
+            alignas(64) unsigned char offsets_l[pdq_block_size];
+            alignas(64) unsigned char offsets_r[pdq_block_size];
+            RIter offsets_l_base = first;
+            RIter offsets_r_base = last;
+            size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+            while (first < last) {
+                const size_t num_unknown = size_t(last - first);
+                const size_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+                const size_t right_split = num_r == 0 ? (num_unknown - left_split) : 0;
+                const size_t left_count = left_split < pdq_block_size ? left_split : pdq_block_size;
+                const size_t right_count = right_split < pdq_block_size ? right_split : pdq_block_size;
+                for (size_t i = 0; i != left_count; ++i, ++first) {
+                    offsets_l[num_l] = (unsigned char) i;
+                    num_l += !cmp(*first, pivot);
+                }
+                for (size_t i = 0; i != right_count;) {
+                    offsets_r[num_r] = (unsigned char) ++i;
+                    num_r += cmp(*--last, pivot);
+                }
+                const size_t num = num_l < num_r ? num_l : num_r;
+                _pdq_swap_offsets(offsets_l_base, offsets_r_base, offsets_l + start_l, offsets_r + start_r,
+                                  num, num_l == num_r);
+                num_l -= num;
+                num_r -= num;
+                start_l += num;
+                start_r += num;
+                if (num_l == 0) {
+                    start_l = 0;
+                    offsets_l_base = first;
+                }
+                if (num_r == 0) {
+                    start_r = 0;
+                    offsets_r_base = last;
+                }
+            }
+            if (num_l) {
+                while (num_l--)
+                    std::iter_swap(offsets_l_base + offsets_l[start_l + num_l], --last);
+                first = last;
+            }
+            if (num_r) {
+                while (num_r--)
+                    std::iter_swap(offsets_r_base - offsets_r[start_r + num_r], first++);
+                last = first;
+            }
+        }
+        RIter pivot_pos = first - 1;
+        *begin = std::move(*pivot_pos);
+        *pivot_pos = std::move(pivot);
+        return (std::pair<RIter, bool>(pivot_pos, already_partitioned));
+    }
+
+    //primitive keys in contiguous storage under std::less/std::greater are
+    //partitioned and finished by the vector kernels of simd_qmj.h
+    struct _simd_sort_tag {
+    };
+
+    template<typename RIter, typename Comp>
+    struct _simd_sortable : bool_type<is_mem_copy<RIter>::value && is_simd_sortable<iter_val_t<RIter>>::value &&
+                                      _pdq_branchless<iter_val_t<RIter>, Comp>::value> {
+    };
+
+    template<typename value_type, typename Comp>
+    struct _simd_descending : bool_type<is_same<Comp, std::greater<>>::value ||
+                                        is_same<Comp, std::greater<value_type>>::value> {
+    };
+
+    template<typename RIter, typename Comp>
+    struct _pdq_kernel : If<_simd_sortable<RIter, Comp>::value, _simd_sort_tag,
+            _pdq_branchless<iter_val_t<RIter>, Comp>> {
+    };
+
+    //the opening scans are pdq's, what they leave goes to the vector
+    //partition; without a kernel for the key it is the block partition
+    template<typename RIter, typename Comp>
+    inline std::pair<RIter, bool> _pdq_partition_right(RIter first, RIter last, const Comp &cmp, _simd_sort_tag) {
+        typedef iter_val_t<RIter> T;
+        if (!simd_partition_enabled<T>())
+            return (_pdq_partition_right(first, last, cmp, true_type()));
+        T *const base = &*first;
+        const size_t len = size_t(last - first);
+        const T pivot = base[0];
+        size_t lo = 1, hi = len;
+        while (lo != hi && cmp(base[lo], pivot))
+            ++lo;
+        while (lo != hi && !cmp(base[hi - 1], pivot))
+            --hi;
+        const bool already_partitioned = lo == hi;
+        if (!already_partitioned)
+            lo = size_t(simd_partition<T, _simd_descending<T, Comp>::value>(base + lo, base + hi, pivot) - base);
+        base[0] = base[lo - 1];
+        base[lo - 1] = pivot;
+        return (std::pair<RIter, bool>(first + (lo - 1), already_partitioned));
+    }
+
+    template<typename RIter, typename Comp>
+    inline std::pair<RIter, bool> _pdq_partition_right(RIter first, RIter last, const Comp &cmp) {
+        return (_pdq_partition_right(first, last, cmp, typename _pdq_kernel<RIter, Comp>::type()));
+    }
+
+    template<typename RIter, typename Comp, typename Tag>
+    inline bool _pdq_reversed_run(RIter, RIter, const Comp &, Tag) { return (false); }
+
+    //the mirror swaps of the block partition turn a descending range
+    //around, the vector partition scatters it instead; so such a range is
+    //reversed up front. the scan stops at the first pair in order, which on
+    //most inputs is the first or second
+    template<typename RIter, typename Comp>
+    inline bool _pdq_reversed_run(RIter first, RIter last, const Comp &cmp, _simd_sort_tag) {
+        RIter cur = first + 1;
+        while (cur != last && cmp(*cur, *(cur - 1)))
+            ++cur;
+        if (cur != last)
+            return (false);
+        _QMJ reverse(first, last);
+        return (true);
+    }
+
+    template<typename RIter, typename Comp, typename Tag>
+    inline void _pdq_small_sort(RIter first, RIter last, const Comp &cmp, bool leftmost, Tag) {
+        if (leftmost)
             _insert_sort(first, last, cmp);
+        else
+            _unguarded_insert_sort(first, last, cmp);
     }
 
-    inline size_t _lg2(size_t n) {
-        size_t k = 0;
-        for (; n > 1; n >>= 1)
-            ++k;
-        return (k);
+    template<typename RIter, typename Comp>
+    inline void _pdq_small_sort(RIter first, RIter last, const Comp &cmp, bool leftmost, _simd_sort_tag) {
+        typedef iter_val_t<RIter> T;
+        static_assert(sort_threshold <= simd_network_size, "a leaf must fit one network");
+        if (last - first < 2 ||
+            !simd_network_sort<T, _simd_descending<T, Comp>::value>(&*first, size_t(last - first)))
+            _pdq_small_sort(first, last, cmp, leftmost, true_type());
+    }
+
+    //partitions into [<= pivot] pivot [> pivot]; used once the pivot
+    //equals the element before the range, so the left side is a run of
+    //equal keys that needs no more sorting
+    template<typename RIter, typename Comp>
+    inline RIter _pdq_partition_left(RIter first, RIter last, const Comp &cmp) {
+        iter_val_t<RIter> pivot(std::move(*first));
+        RIter lo = first;
+        RIter hi = last;
+        while (cmp(pivot, *--hi));
+        if (hi + 1 == last)
+            while (lo < hi && !cmp(pivot, *++lo));
+        else
+            while (!cmp(pivot, *++lo));
+        while (lo < hi) {
+            std::iter_swap(lo, hi);
+            while (cmp(pivot, *--hi));
+            while (!cmp(pivot, *++lo));
+        }
+        *first = std::move(*hi);
+        *hi = std::move(pivot);
+        return (hi);
+    }
+
+    //scrambles a few elements on both sides of a lopsided split so that
+    //patterns which fooled the pivot choice do not repeat
+    template<typename RIter>
+    inline void _pdq_break_patterns(RIter first, RIter pivot_pos, RIter last) {
+        const size_t l_size = size_t(pivot_pos - first);
+        const size_t r_size = size_t(last - (pivot_pos + 1));
+        if (l_size >= sort_threshold) {
+            std::iter_swap(first, first + l_size / 4);
+            std::iter_swap(pivot_pos - 1, pivot_pos - l_size / 4);
+            if (l_size > ninther_threshold) {
+                std::iter_swap(first + 1, first + (l_size / 4 + 1));
+                std::iter_swap(first + 2, first + (l_size / 4 + 2));
+                std::iter_swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+                std::iter_swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+            }
+        }
+        if (r_size >= sort_threshold) {
+            std::iter_swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+            std::iter_swap(last - 1, last - r_size / 4);
+            if (r_size > ninther_threshold) {
+                std::iter_swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+                std::iter_swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+                std::iter_swap(last - 2, last - (1 + r_size / 4));
+                std::iter_swap(last - 3, last - (2 + r_size / 4));
+            }
+        }
+    }
+
+    //pattern-defeating quicksort: a split worse than 1:7 counts against
+    //bad_allowed and breaks patterns, and when bad_allowed runs out the
+    //range goes to heapsort. a range that partitioned without a swap is
+    //tried with a bounded insertion sort first. leftmost is false when the
+    //element before first is known to be <= the whole range, which lets the
+    //insertion sort run unguarded and the equal key case be detected
+    template<typename RIter, typename Comp>
+    inline void _introsort_imple(RIter first, RIter last, int bad_allowed, const Comp &cmp, bool leftmost) {
+        for (;;) {
+            const size_t len = size_t(last - first);
+            if (len < sort_threshold) {
+                _pdq_small_sort(first, last, cmp, leftmost, typename _pdq_kernel<RIter, Comp>::type());
+                return;
+            }
+            if (_pdq_reversed_run(first, last, cmp, typename _pdq_kernel<RIter, Comp>::type()))
+                return;
+            _pdq_choose_pivot(first, last, cmp);
+            if (!leftmost && !cmp(*(first - 1), *first)) {
+                first = _pdq_partition_left(first, last, cmp) + 1;
+                continue;
+            }
+            std::pair<RIter, bool> part = _pdq_partition_right(first, last, cmp);
+            RIter pivot_pos = part.first;
+            const size_t l_size = size_t(pivot_pos - first);
+            const size_t r_size = size_t(last - (pivot_pos + 1));
+            if (l_size < len / 8 || r_size < len / 8) {
+                if (--bad_allowed == 0) {
+                    _QMJ _make_heap_imple(first, iter_dif_t<RIter>(len), cmp);
+                    _QMJ sort_heap(first, last, cmp);
+                    return;
+                }
+                _pdq_break_patterns(first, pivot_pos, last);
+            } else if (part.second && _partial_insert_sort(first, pivot_pos, cmp) &&
+                       _partial_insert_sort(pivot_pos + 1, last, cmp))
+                return;
+            _introsort_imple(first, pivot_pos, bad_allowed, cmp, leftmost);
+            first = pivot_pos + 1;
+            leftmost = false;
+        }
     }
 
     template<typename RIter, typename Comp>
     inline void sort(RIter first, RIter last, const Comp &cmp) {
-        if (last - first > sort_threshold)
-            _introsort_imple(first, last, size_t(_lg2((size_t) (last - first)) * 1.5), cmp);
-        _final_insert_sort(first, last, cmp);
+        if (last - first > 1)
+            _introsort_imple(first, last, int(_lg2(size_t(last - first))), cmp, true);
     }
 
     template<typename RIter>
@@ -1216,6 +1727,50 @@ namespace qmj {
         _QMJ sort(first, last, std::less<>());
     }
 
+    //each partition step hands its two sides to fork_join until the forks
+    //run out or the pieces drop below sort_fork_grain, every piece is then
+    //sorted on its own so no final pass spans the whole range
+    template<typename RIter, typename Comp>
+    inline void _par_introsort_imple(RIter first, RIter last, int bad_allowed, int depth, const Comp &cmp,
+                                     bool leftmost) {
+        while (depth > 0 && bad_allowed > 1 && size_t(last - first) >= 2 * sort_fork_grain) {
+            if (_pdq_reversed_run(first, last, cmp, typename _pdq_kernel<RIter, Comp>::type()))
+                return;
+            _pdq_choose_pivot(first, last, cmp);
+            if (!leftmost && !cmp(*(first - 1), *first)) {
+                first = _pdq_partition_left(first, last, cmp) + 1;
+                continue;
+            }
+            RIter pivot_pos = _pdq_partition_right(first, last, cmp).first;
+            const size_t len = size_t(last - first);
+            if (size_t(pivot_pos - first) < len / 8 || size_t(last - (pivot_pos + 1)) < len / 8) {
+                --bad_allowed;
+                _pdq_break_patterns(first, pivot_pos, last);
+            }
+            fork_join([&] { _par_introsort_imple(first, pivot_pos, bad_allowed, depth - 1, cmp, leftmost); },
+                      [&] { _par_introsort_imple(pivot_pos + 1, last, bad_allowed, depth - 1, cmp, false); });
+            return;
+        }
+        if (last - first > 1)
+            _introsort_imple(first, last, bad_allowed, cmp, leftmost);
+    }
+
+    //with qmj::par the partitions are sorted on separate threads until
+    //every hardware thread has its share, cmp must be safe to call
+    //concurrently
+    template<typename policy, typename RIter, typename Comp>
+    inline enable_if_t<is_execution_policy<policy>::value>
+    sort(policy &&exec, RIter first, RIter last, const Comp &cmp) {
+        const size_t n = size_t(last - first);
+        _par_introsort_imple(first, last, int(_lg2(n)), fork_depth(exec, n, sort_fork_grain), cmp, true);
+    }
+
+    template<typename policy, typename RIter>
+    inline enable_if_t<is_execution_policy<policy>::value>
+    sort(policy &&exec, RIter first, RIter last) {
+        _QMJ sort(exec, first, last, std::less<>());
+    }
+
     template<typename RIter, typename value_type, typename Comp>
     inline std::pair<RIter, RIter> equal_range(RIter first, RIter last, const value_type &val, const Comp &cmp) {
         iter_dif_t<RIter> len = last - first;
@@ -1249,11 +1804,11 @@ namespace qmj {
         typedef Alloc alloc;
         typedef value_type *pointer;
 
-        temporary_buffer(size_t len) : len(len) { allocate_construct(); }
+        temporary_buffer(size_t len) : len(len), first(nullptr) { allocate_construct(); }
 
         ~temporary_buffer() {
             alloc::destroy(first, first + len);
-            alloc::deallocate(first);
+            alloc::deallocate(first, len);
         }
 
         size_t size() const { return (len); }
@@ -1267,7 +1822,7 @@ namespace qmj {
             while (len) {
                 try {
                     first = alloc::allocate(len);
-                    alloc::construct(first, len);
+                    alloc::construct_n(first, len);
                     return;
                 } catch (_BAD_ALLOC) {
                     len >>= 1;
@@ -1287,7 +1842,7 @@ namespace qmj {
                                    Dif len1, Dif len2, BIter2 buf, Dif buf_size) {
         BIter2 buf_end;
         if (len1 > len2 && len2 <= buf_size) {
-            buf_end = copy(middle, last, buf);
+            buf_end = std::copy(middle, last, buf);
             std::copy_backward(first, middle, last);
             return (std::copy(buf, buf_end, first));
         } else if (len1 <= buf_size) {
@@ -1308,13 +1863,17 @@ namespace qmj {
             for (--last1, --last2;;) {
                 if (cmp(*last2, *last1)) {
                     *--dest = *last1;
-                    if (last1 == first1)
+                    if (last1 == first1) {
+                        ++last2;
                         break;
+                    }
                     --last1;
                 } else {
                     *--dest = *last2;
-                    if (last2 == first2)
+                    if (last2 == first2) {
+                        ++last1;
                         break;
+                    }
                     --last2;
                 }
             }
@@ -1332,16 +1891,19 @@ namespace qmj {
         } else if (len2 <= buf_size) {
             pointer end_buf = std::copy(middle, last, buf);
             _QMJ _merge_backward(first, middle, buf, end_buf, last, cmp);
+        } else if (len1 + len2 == 2) {
+            if (cmp(*middle, *first))
+                std::iter_swap(first, middle);
         } else {
             BIter first_cut = first;
             BIter second_cut = middle;
             Dif len11 = 0;
             Dif len22 = 0;
             if (len1 > len2) {
-                len11 = (size_t) len2 >> 1;
+                len11 = (size_t) len1 >> 1;
                 _QMJ advance(first_cut, len11);
                 second_cut = _QMJ lower_bound(middle, last, *first_cut, cmp);
-                len2 = _QMJ distance(middle, second_cut);
+                len22 = _QMJ distance(middle, second_cut);
             } else {
                 len22 = (size_t) len2 >> 1;
                 _QMJ advance(second_cut, len22);
@@ -1377,7 +1939,7 @@ namespace qmj {
     template<typename BIter, typename Dif, typename pointer, typename Comp>
     inline void _stable_sort_imple(BIter first, BIter last, pointer buf, Dif buf_size, const Comp &cmp) {
         iter_dif_t<BIter> len = _QMJ distance(first, last);
-        if (len > sort_threshold) {
+        if (len > iter_dif_t<BIter>(sort_threshold)) {
             Dif len1 = (size_t) len >> 1;
             Dif len2 = len - len1;
             BIter middle = first;
@@ -1389,15 +1951,210 @@ namespace qmj {
             _insert_sort(first, last, cmp);
     }
 
+    //a merge leaves one-at-a-time mode once one side has won this many
+    //comparisons in a row
+    constexpr size_t min_gallop = 7;
+
+    template<typename Comp>
+    struct _flip_comp {
+        explicit _flip_comp(const Comp &cmp) : cmp(cmp) {}
+
+        template<typename T1, typename T2>
+        bool operator()(const T1 &a, const T2 &b) const { return (cmp(b, a)); }
+
+        const Comp &cmp;
+    };
+
+    //upper_bound probing 1, 3, 7, ... places from first, so a cut near the
+    //front costs log of its distance instead of log of the range
+    template<typename RIter, typename T, typename Comp>
+    inline RIter _gallop_upper(RIter first, RIter last, const T &val, const Comp &cmp) {
+        iter_dif_t<RIter> len = last - first, lo = 0, step = 1;
+        while (lo + step <= len && !cmp(val, first[lo + step - 1])) {
+            lo += step;
+            step <<= 1;
+        }
+        return (_QMJ upper_bound(first + lo, lo + step <= len ? first + lo + step - 1 : last, val, cmp));
+    }
+
+    template<typename RIter, typename T, typename Comp>
+    inline RIter _gallop_lower(RIter first, RIter last, const T &val, const Comp &cmp) {
+        iter_dif_t<RIter> len = last - first, lo = 0, step = 1;
+        while (lo + step <= len && cmp(first[lo + step - 1], val)) {
+            lo += step;
+            step <<= 1;
+        }
+        return (_QMJ lower_bound(first + lo, lo + step <= len ? first + lo + step - 1 : last, val, cmp));
+    }
+
+    //merges the buffered left run [first1,last1) with the right run
+    //[first2,last2) into dest, which ends where the right run starts. ties
+    //go to the left run; when one side keeps winning, whole blocks of it
+    //are found by galloping and moved at once
+    template<typename Iter1, typename Iter2, typename Comp>
+    inline void _merge_gallop(Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2,
+                              Iter2 dest, const Comp &cmp) {
+        size_t gallop = min_gallop;
+        while (first1 != last1 && first2 != last2) {
+            size_t win1 = 0, win2 = 0;
+            while (first1 != last1 && first2 != last2 && win1 < gallop && win2 < gallop)
+                if (cmp(*first2, *first1)) {
+                    *dest++ = std::move(*first2++);
+                    ++win2;
+                    win1 = 0;
+                } else {
+                    *dest++ = std::move(*first1++);
+                    ++win1;
+                    win2 = 0;
+                }
+            while (first1 != last1 && first2 != last2) {
+                Iter1 cut1 = _QMJ _gallop_upper(first1, last1, *first2, cmp);
+                win1 = cut1 - first1;
+                dest = std::copy(std::make_move_iterator(first1), std::make_move_iterator(cut1), dest);
+                if ((first1 = cut1) == last1)
+                    break;
+                *dest++ = std::move(*first2++);
+                Iter2 cut2 = _QMJ _gallop_lower(first2, last2, *first1, cmp);
+                win2 = cut2 - first2;
+                dest = std::copy(std::make_move_iterator(first2), std::make_move_iterator(cut2), dest);
+                if ((first2 = cut2) == last2)
+                    break;
+                *dest++ = std::move(*first1++);
+                if (win1 < min_gallop && win2 < min_gallop) {
+                    ++gallop;
+                    break;
+                }
+                if (gallop > 1)
+                    --gallop;
+            }
+        }
+        std::copy(std::make_move_iterator(first1), std::make_move_iterator(last1), dest);
+    }
+
+    //merges the adjacent sorted runs [first,middle) and [middle,last). the
+    //parts of each run already in place are trimmed off by galloping, the
+    //rest goes through the buffer from whichever end the shorter run is,
+    //and _merge_adaptive takes over when neither fits
+    template<typename RIter, typename pointer, typename Comp>
+    inline void _merge_runs(RIter first, RIter middle, RIter last,
+                            pointer buf, iter_dif_t<RIter> buf_size, const Comp &cmp) {
+        first = _QMJ _gallop_upper(first, middle, *middle, cmp);
+        if (first == middle)
+            return;
+        typedef std::reverse_iterator<RIter> riter;
+        last = _QMJ _gallop_upper(riter(last), riter(middle), *(middle - 1), _flip_comp<Comp>(cmp)).base();
+        iter_dif_t<RIter> len1 = middle - first, len2 = last - middle;
+        if (len1 <= len2 && len1 <= buf_size) {
+            pointer end_buf = std::copy(std::make_move_iterator(first), std::make_move_iterator(middle), buf);
+            _QMJ _merge_gallop(buf, end_buf, middle, last, first, cmp);
+        } else if (len2 <= buf_size) {
+            typedef std::reverse_iterator<pointer> rbuf;
+            pointer end_buf = std::copy(std::make_move_iterator(middle), std::make_move_iterator(last), buf);
+            _QMJ _merge_gallop(rbuf(end_buf), rbuf(buf), riter(middle), riter(first), riter(last),
+                               _flip_comp<Comp>(cmp));
+        } else
+            _QMJ _merge_adaptive(first, middle, last, len1, len2, buf, buf_size, cmp);
+    }
+
+    //end of the natural run starting at first; a strictly descending run
+    //is reversed in place, which keeps equal elements in order
+    template<typename RIter, typename Comp>
+    inline RIter _count_run(RIter first, RIter last, const Comp &cmp) {
+        RIter cur = first + 1;
+        if (cur == last)
+            return (last);
+        if (cmp(*cur, *first)) {
+            while (++cur != last && cmp(*cur, *(cur - 1)));
+            _QMJ reverse(first, cur);
+        } else
+            while (++cur != last && !cmp(*cur, *(cur - 1)));
+        return (cur);
+    }
+
+    //depth of the boundary between runs [b1,b2) and [b2,e2) in the
+    //powersort merge tree: the first bit where the two runs' midpoints,
+    //taken as fractions of n, differ
+    inline int _run_power(size_t b1, size_t b2, size_t e2, size_t n) {
+        size_t a = b1 + b2, b = b2 + e2;
+        int power = 0;
+        for (;;) {
+            ++power;
+            bool bit_a = a >= n, bit_b = b >= n;
+            if (bit_a != bit_b)
+                return (power);
+            if (bit_a) {
+                a -= n;
+                b -= n;
+            }
+            a <<= 1;
+            b <<= 1;
+        }
+    }
+
+    //powersort: natural runs, short ones grown to sort_threshold by
+    //insertion, are pushed on a stack and merged whenever the boundary
+    //below the top is deeper than the one just found, so a range made of
+    //k runs costs O(n log k) and an already sorted one a single scan
+    template<typename RIter, typename pointer, typename Comp>
+    inline void _power_sort_imple(RIter first, RIter last, pointer buf,
+                                  iter_dif_t<RIter> buf_size, const Comp &cmp) {
+        struct run {
+            size_t begin;
+            int power;
+        };
+        const size_t n = last - first;
+        run stack[sizeof(size_t) * 8 + 1];
+        int top = 0;
+        size_t begin1 = 0, end1 = _QMJ _count_run(first, last, cmp) - first;
+        if (end1 < sort_threshold) {
+            end1 = n < sort_threshold ? n : sort_threshold;
+            _insert_sort(first, first + end1, cmp);
+        }
+        while (end1 != n) {
+            size_t end2 = _QMJ _count_run(first + end1, last, cmp) - first;
+            if (end2 - end1 < sort_threshold) {
+                end2 = n - end1 < sort_threshold ? n : end1 + sort_threshold;
+                _insert_sort(first + end1, first + end2, cmp);
+            }
+            int power = _QMJ _run_power(begin1, end1, end2, n);
+            while (top && stack[top - 1].power > power) {
+                --top;
+                _QMJ _merge_runs(first + stack[top].begin, first + begin1, first + end1, buf, buf_size, cmp);
+                begin1 = stack[top].begin;
+            }
+            stack[top++] = run{begin1, power};
+            begin1 = end1;
+            end1 = end2;
+        }
+        while (top) {
+            --top;
+            _QMJ _merge_runs(first + stack[top].begin, first + begin1, last, buf, buf_size, cmp);
+            begin1 = stack[top].begin;
+        }
+    }
+
+    template<typename BIter, typename Comp>
+    inline void _stable_sort_dispatch(BIter first, BIter last, iter_dif_t<BIter> len, const Comp &cmp,
+                                      std::bidirectional_iterator_tag) {
+        iter_dif_t<BIter> len1 = (size_t) (len >> 1);
+        iter_dif_t<BIter> len2 = len - len1;
+        _QMJ temporary_buffer<iter_val_t<BIter>> buf((len1 < len2 ? len1 : len2));
+        _QMJ _stable_sort_imple(first, last, buf.begin(), iter_dif_t<BIter>(buf.size()), cmp);
+    }
+
+    template<typename RIter, typename Comp>
+    inline void _stable_sort_dispatch(RIter first, RIter last, iter_dif_t<RIter> len, const Comp &cmp,
+                                      std::random_access_iterator_tag) {
+        _QMJ temporary_buffer<iter_val_t<RIter>> buf(len >> 1);
+        _QMJ _power_sort_imple(first, last, buf.begin(), iter_dif_t<RIter>(buf.size()), cmp);
+    }
+
     template<typename BIter, typename Comp>
     inline void stable_sort(BIter first, BIter last, const Comp &cmp) {
         iter_dif_t<BIter> len = _QMJ distance(first, last);
-        if (1 < len) {
-            iter_dif_t<BIter> len1 = (size_t) (len >> 1);
-            iter_dif_t<BIter> len2 = len - len1;
-            _QMJ temporary_buffer<iter_val_t<BIter>> buf((len1 < len2 ? len1 : len2));
-            _QMJ _stable_sort_imple(first, last, buf.begin(), iter_dif_t<BIter>(buf.size()), cmp);
-        } else
+        if (len > iter_dif_t<BIter>(sort_threshold))
+            _QMJ _stable_sort_dispatch(first, last, len, cmp, _QMJ iterator_category(first));
+        else
             _insert_sort(first, last, cmp);
     }
 
@@ -1406,22 +2163,1065 @@ namespace qmj {
         _QMJ stable_sort(first, last, std::less<>());
     }
 
-    template<typename RIter, typename Comp>
-    inline void nth_element(RIter first, RIter nth, RIter last, const Comp &cmp) {
-        RIter cut;
-        while (last - first > 3) {
-            cut = _QMJ _mid_partition(first, last, cmp);
-            if (cut <= nth)
-                first = cut;
+    //co-ranking: how many of the first k elements of the stable merge of
+    //[first1,first1+len1) and [first2,first2+len2) come from the first range
+    template<typename RIter1, typename RIter2, typename Dif, typename Comp>
+    inline Dif _co_rank(Dif k, RIter1 first1, Dif len1, RIter2 first2, Dif len2, const Comp &cmp) {
+        Dif lo = k > len2 ? k - len2 : 0;
+        Dif hi = k < len1 ? k : len1;
+        while (lo < hi) {
+            Dif mid = lo + (hi - lo) / 2;
+            if (!cmp(first2[k - mid - 1], first1[mid]))
+                lo = mid + 1;
             else
-                last = cut;
+                hi = mid;
+        }
+        return (lo);
+    }
+
+    //merge path: the output is cut in half, co-ranking finds where each
+    //input crosses the cut and the halves are merged on their own, so every
+    //thread writes an equal share of the output whatever the data
+    template<typename RIter1, typename RIter2, typename RIter3, typename Comp>
+    inline void _par_merge_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+                                 RIter3 dest, int depth, const Comp &cmp) {
+        typedef iter_dif_t<RIter3> Dif;
+        const Dif len1 = Dif(last1 - first1), len2 = Dif(last2 - first2);
+        if (depth <= 0 || size_t(len1 + len2) < 2 * merge_fork_grain) {
+            _QMJ merge(first1, last1, first2, last2, dest, cmp);
+            return;
         }
-        _QMJ _insert_sort(first, last, cmp);
+        const Dif k = (len1 + len2) / 2;
+        const Dif i = _QMJ _co_rank(k, first1, len1, first2, len2, cmp);
+        fork_join([&] { _par_merge_imple(first1, first1 + i, first2, first2 + (k - i), dest, depth - 1, cmp); },
+                  [&] { _par_merge_imple(first1 + i, last1, first2 + (k - i), last2, dest + k, depth - 1, cmp); });
     }
 
-    template<typename RIter>
-    inline void nth_element(RIter first, RIter nth, RIter last) {
-        _QMJ nth_element(first, nth, last, std::less<>());
+    template<typename RIter1, typename RIter2>
+    inline void _par_move(RIter1 first, RIter1 last, RIter2 dest, int depth) {
+        if (depth <= 0 || size_t(last - first) < 2 * merge_fork_grain) {
+            std::copy(std::make_move_iterator(first), std::make_move_iterator(last), dest);
+            return;
+        }
+        const iter_dif_t<RIter1> half = (last - first) / 2;
+        fork_join([&] { _par_move(first, first + half, dest, depth - 1); },
+                  [&] { _par_move(first + half, last, dest + half, depth - 1); });
+    }
+
+    //with qmj::par equal segments of the output are merged on separate
+    //threads, cmp must be safe to call concurrently
+    template<typename policy, typename RIter1, typename RIter2, typename RIter3, typename Comp>
+    inline enable_if_t<is_execution_policy<policy>::value, RIter3>
+    merge(policy &&exec, RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+          RIter3 dest, const Comp &cmp) {
+        const size_t n = size_t(last1 - first1) + size_t(last2 - first2);
+        _par_merge_imple(first1, last1, first2, last2, dest, fork_depth(exec, n, merge_fork_grain), cmp);
+        return (dest + n);
+    }
+
+    template<typename policy, typename RIter1, typename RIter2, typename RIter3>
+    inline enable_if_t<is_execution_policy<policy>::value, RIter3>
+    merge(policy &&exec, RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2, RIter3 dest) {
+        return (_QMJ merge(exec, first1, last1, first2, last2, dest, std::less<>()));
+    }
+
+    //the runs are merged in parallel into a buffer as long as the whole
+    //range and moved back; without such a buffer it is the serial merge
+    template<typename policy, typename RIter, typename Comp>
+    inline enable_if_t<is_execution_policy<policy>::value>
+    inplace_merge(policy &&exec, RIter first, RIter middle, RIter last, const Comp &cmp) {
+        if (first == middle || middle == last)
+            return;
+        const size_t n = size_t(last - first);
+        const int depth = fork_depth(exec, n, merge_fork_grain);
+        if (depth > 0) {
+            _QMJ temporary_buffer<iter_val_t<RIter>> buf(n);
+            if (buf.size() == n) {
+                _par_merge_imple(std::make_move_iterator(first), std::make_move_iterator(middle),
+                                 std::make_move_iterator(middle), std::make_move_iterator(last),
+                                 buf.begin(), depth, cmp);
+                _par_move(buf.begin(), buf.end(), first, depth);
+                return;
+            }
+        }
+        _QMJ _inplace_merge_imple(first, middle, last, cmp);
+    }
+
+    template<typename policy, typename RIter>
+    inline enable_if_t<is_execution_policy<policy>::value>
+    inplace_merge(policy &&exec, RIter first, RIter middle, RIter last) {
+        _QMJ inplace_merge(exec, first, middle, last, std::less<>());
+    }
+
+    //sorts [first,last) leaving the result in place, or in the matching
+    //slice of buf when to_buf is set. the halves are sorted into the other
+    //side, so each level is a single parallel merge with no copy back
+    template<typename RIter, typename pointer, typename Comp>
+    inline void _par_stable_sort_imple(RIter first, RIter last, pointer buf, int depth,
+                                       const Comp &cmp, bool to_buf) {
+        const iter_dif_t<RIter> len = last - first;
+        if (depth <= 0 || size_t(len) < 2 * sort_fork_grain) {
+            if (size_t(len) > sort_threshold)
+                _QMJ _power_sort_imple(first, last, buf, len, cmp);
+            else
+                _insert_sort(first, last, cmp);
+            if (to_buf)
+                std::copy(std::make_move_iterator(first), std::make_move_iterator(last), buf);
+            return;
+        }
+        const iter_dif_t<RIter> len1 = len / 2;
+        RIter middle = first + len1;
+        fork_join([&] { _par_stable_sort_imple(first, middle, buf, depth - 1, cmp, !to_buf); },
+                  [&] { _par_stable_sort_imple(middle, last, buf + len1, depth - 1, cmp, !to_buf); });
+        if (to_buf)
+            _par_merge_imple(std::make_move_iterator(first), std::make_move_iterator(middle),
+                             std::make_move_iterator(middle), std::make_move_iterator(last),
+                             buf, depth, cmp);
+        else
+            _par_merge_imple(std::make_move_iterator(buf), std::make_move_iterator(buf + len1),
+                             std::make_move_iterator(buf + len1), std::make_move_iterator(buf + len),
+                             first, depth, cmp);
+    }
+
+    //with qmj::par the halves are sorted on separate threads and merged by
+    //merge path, which needs a buffer as long as the range; when that
+    //cannot be had it falls back to the serial stable_sort
+    template<typename policy, typename RIter, typename Comp>
+    inline enable_if_t<is_execution_policy<policy>::value>
+    stable_sort(policy &&exec, RIter first, RIter last, const Comp &cmp) {
+        const size_t n = size_t(last - first);
+        const int depth = fork_depth(exec, n, sort_fork_grain);
+        if (depth > 0) {
+            _QMJ temporary_buffer<iter_val_t<RIter>> buf(n);
+            if (buf.size() == n) {
+                _par_stable_sort_imple(first, last, buf.begin(), depth, cmp, false);
+                return;
+            }
+        }
+        _QMJ stable_sort(first, last, cmp);
+    }
+
+    template<typename policy, typename RIter>
+    inline enable_if_t<is_execution_policy<policy>::value>
+    stable_sort(policy &&exec, RIter first, RIter last) {
+        _QMJ stable_sort(exec, first, last, std::less<>());
+    }
+
+    //sorted ranges whose lengths differ by more than this factor are
+    //combined by galloping through the longer one for each key of the
+    //shorter, which costs about log of the gap per key instead of the gap
+    constexpr size_t set_gallop_ratio = 32;
+    //the same for an intersection the vector kernel would otherwise take
+    constexpr size_t simd_set_gallop_ratio = 64;
+
+    template<typename RIter1, typename RIter2>
+    inline bool _set_gallops(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+                             const size_t ratio = set_gallop_ratio) {
+        const size_t len1 = size_t(last1 - first1), len2 = size_t(last2 - first2);
+        return (len1 / ratio > len2 || len2 / ratio > len1);
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_union_merge(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest,
+                                  const Comp &cmp) {
+        if (first1 != last1 && first2 != last2) {
+            for (;;) {
+                if (cmp(*first1, *first2)) {
+                    *dest++ = *first1;
+                    if (++first1 == last1)
+                        break;
+                } else if (cmp(*first2, *first1)) {
+                    *dest++ = *first2;
+                    if (++first2 == last2)
+                        break;
+                } else {
+                    *dest++ = *first1;
+                    ++first1;
+                    ++first2;
+                    if (first1 == last1 || first2 == last2)
+                        break;
+                }
+            }
+        }
+        dest = std::copy(first1, last1, dest);
+        return (std::copy(first2, last2, dest));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_union_imple(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest,
+                                  const Comp &cmp, std::input_iterator_tag, std::input_iterator_tag) {
+        return (_QMJ _set_union_merge(first1, last1, first2, last2, dest, cmp));
+    }
+
+    //the keys of the longer range up to the next key of the shorter are
+    //copied as one block
+    template<typename RIter1, typename RIter2, typename OIter, typename Comp>
+    inline OIter _set_union_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2, OIter dest,
+                                  const Comp &cmp, std::random_access_iterator_tag,
+                                  std::random_access_iterator_tag) {
+        if (!_QMJ _set_gallops(first1, last1, first2, last2))
+            return (_QMJ _set_union_merge(first1, last1, first2, last2, dest, cmp));
+        if (last1 - first1 < last2 - first2) {
+            for (; first1 != last1; ++first1) {
+                const RIter2 cut = _QMJ _gallop_lower(first2, last2, *first1, cmp);
+                dest = std::copy(first2, cut, dest);
+                first2 = cut;
+                if (first2 != last2 && !cmp(*first1, *first2))
+                    ++first2;
+                *dest++ = *first1;
+            }
+            return (std::copy(first2, last2, dest));
+        }
+        for (; first2 != last2; ++first2) {
+            const RIter1 cut = _QMJ _gallop_lower(first1, last1, *first2, cmp);
+            dest = std::copy(first1, cut, dest);
+            first1 = cut;
+            if (first1 != last1 && !cmp(*first2, *first1))
+                *dest++ = *first1++;
+            else
+                *dest++ = *first2;
+        }
+        return (std::copy(first1, last1, dest));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter set_union(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest, const Comp &cmp) {
+        return (_QMJ _set_union_imple(first1, last1, first2, last2, dest, cmp,
+                                      iter_cate_t<IIter1>(), iter_cate_t<IIter2>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter>
+    inline OIter set_union(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest) {
+        return (_QMJ set_union(first1, last1, first2, last2, dest, std::less<>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_intersection_merge(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest,
+                                         const Comp &cmp, false_type) {
+        if (first1 != last1 && first2 != last2) {
+            for (;;) {
+                if (cmp(*first1, *first2)) {
+                    if (++first1 == last1)
+                        break;
+                } else if (cmp(*first2, *first1)) {
+                    if (++first2 == last2)
+                        break;
+                } else {
+                    *dest++ = *first1;
+                    ++first1;
+                    ++first2;
+                    if (first1 == last1 || first2 == last2)
+                        break;
+                }
+            }
+        }
+        return (dest);
+    }
+
+    //4-byte integer keys in contiguous storage, under std::less or
+    //std::greater, are intersected by the vector kernel of simd_qmj.h
+    template<typename RIter1, typename RIter2, typename Comp>
+    struct _simd_set_kernel : bool_type<is_mem_copy<RIter1>::value && is_mem_copy<RIter2>::value &&
+                                        std::is_integral<typename _simd_scan_key<RIter1>::type>::value &&
+                                        sizeof(typename _simd_scan_key<RIter1>::type) == 4 &&
+                                        is_same<typename _simd_scan_key<RIter1>::type,
+                                                typename _simd_scan_key<RIter2>::type>::value &&
+                                        (is_same<Comp, std::less<>>::value || is_same<Comp, std::greater<>>::value ||
+                                         is_same<Comp, std::less<typename _simd_scan_key<RIter1>::type>>::value ||
+                                         is_same<Comp, std::greater<typename _simd_scan_key<RIter1>::type>>::value)> {
+    };
+
+    template<typename RIter1, typename RIter2, typename OIter, typename Comp>
+    inline OIter _set_intersection_merge(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2, OIter dest,
+                                         const Comp &cmp, true_type) {
+        typedef typename _simd_scan_key<RIter1>::type key;
+        if (first1 != last1 && first2 != last2) {
+            const key *a = _simd_scan_ptr(first1), *b = _simd_scan_ptr(first2);
+            const key *const a_begin = a, *const b_begin = b;
+            dest = _QMJ simd_intersect<key, !is_same<Comp, std::less<>>::value &&
+                                            !is_same<Comp, std::less<key>>::value>(
+                    a, a + (last1 - first1), b, b + (last2 - first2), dest);
+            first1 += a - a_begin;
+            first2 += b - b_begin;
+        }
+        return (_QMJ _set_intersection_merge(first1, last1, first2, last2, dest, cmp, false_type()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_intersection_imple(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest,
+                                         const Comp &cmp, std::input_iterator_tag, std::input_iterator_tag) {
+        return (_QMJ _set_intersection_merge(first1, last1, first2, last2, dest, cmp, false_type()));
+    }
+
+    //each key of the shorter range is galloped to from where the last one
+    //was found in the longer range; a match is copied from the first range
+    template<typename RIter1, typename RIter2, typename OIter, typename Comp>
+    inline OIter _set_intersection_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2, OIter dest,
+                                         const Comp &cmp, std::random_access_iterator_tag,
+                                         std::random_access_iterator_tag) {
+        typedef _simd_set_kernel<RIter1, RIter2, Comp> kernel;
+        const size_t ratio = kernel::value && _QMJ simd_intersect_enabled() ? simd_set_gallop_ratio
+                                                                            : set_gallop_ratio;
+        if (!_QMJ _set_gallops(first1, last1, first2, last2, ratio))
+            return (_QMJ _set_intersection_merge(first1, last1, first2, last2, dest, cmp, kernel()));
+        if (last1 - first1 < last2 - first2) {
+            for (; first1 != last1 && first2 != last2; ++first1) {
+                first2 = _QMJ _gallop_lower(first2, last2, *first1, cmp);
+                if (first2 != last2 && !cmp(*first1, *first2)) {
+                    *dest++ = *first1;
+                    ++first2;
+                }
+            }
+            return (dest);
+        }
+        for (; first2 != last2 && first1 != last1; ++first2) {
+            first1 = _QMJ _gallop_lower(first1, last1, *first2, cmp);
+            if (first1 != last1 && !cmp(*first2, *first1))
+                *dest++ = *first1++;
+        }
+        return (dest);
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter set_intersection(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                  OIter dest, const Comp &cmp) {
+        return (_QMJ _set_intersection_imple(first1, last1, first2, last2, dest, cmp,
+                                             iter_cate_t<IIter1>(), iter_cate_t<IIter2>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter>
+    inline OIter set_intersection(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                  OIter dest) {
+        return (_QMJ set_intersection(first1, last1, first2, last2, dest, std::less<>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_difference_merge(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest,
+                                       const Comp &cmp) {
+        if (first1 != last1 && first2 != last2) {
+            for (;;) {
+                if (cmp(*first1, *first2)) {
+                    *dest++ = *first1;
+                    if (++first1 == last1)
+                        break;
+                } else if (cmp(*first2, *first1)) {
+                    if (++first2 == last2)
+                        break;
+                } else {
+                    ++first1;
+                    ++first2;
+                    if (first1 == last1 || first2 == last2)
+                        break;
+                }
+            }
+        }
+        return (std::copy(first1, last1, dest));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_difference_imple(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, OIter dest,
+                                       const Comp &cmp, std::input_iterator_tag, std::input_iterator_tag) {
+        return (_QMJ _set_difference_merge(first1, last1, first2, last2, dest, cmp));
+    }
+
+    template<typename RIter1, typename RIter2, typename OIter, typename Comp>
+    inline OIter _set_difference_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2, OIter dest,
+                                       const Comp &cmp, std::random_access_iterator_tag,
+                                       std::random_access_iterator_tag) {
+        if (!_QMJ _set_gallops(first1, last1, first2, last2))
+            return (_QMJ _set_difference_merge(first1, last1, first2, last2, dest, cmp));
+        if (last1 - first1 < last2 - first2) {
+            for (; first1 != last1; ++first1) {
+                first2 = _QMJ _gallop_lower(first2, last2, *first1, cmp);
+                if (first2 != last2 && !cmp(*first1, *first2))
+                    ++first2;
+                else
+                    *dest++ = *first1;
+            }
+            return (dest);
+        }
+        for (; first2 != last2; ++first2) {
+            const RIter1 cut = _QMJ _gallop_lower(first1, last1, *first2, cmp);
+            dest = std::copy(first1, cut, dest);
+            first1 = cut;
+            if (first1 != last1 && !cmp(*first2, *first1))
+                ++first1;
+        }
+        return (std::copy(first1, last1, dest));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter set_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                OIter dest, const Comp &cmp) {
+        return (_QMJ _set_difference_imple(first1, last1, first2, last2, dest, cmp,
+                                           iter_cate_t<IIter1>(), iter_cate_t<IIter2>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter>
+    inline OIter set_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                OIter dest) {
+        return (_QMJ set_difference(first1, last1, first2, last2, dest, std::less<>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_symmetric_difference_merge(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                                 OIter dest, const Comp &cmp) {
+        if (first1 != last1 && first2 != last2) {
+            for (;;) {
+                if (cmp(*first1, *first2)) {
+                    *dest++ = *first1;
+                    if (++first1 == last1)
+                        break;
+                } else if (cmp(*first2, *first1)) {
+                    *dest++ = *first2;
+                    if (++first2 == last2)
+                        break;
+                } else {
+                    ++first1;
+                    ++first2;
+                    if (first1 == last1 || first2 == last2)
+                        break;
+                }
+            }
+        }
+        dest = std::copy(first2, last2, dest);
+        return (std::copy(first1, last1, dest));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter _set_symmetric_difference_imple(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                                 OIter dest, const Comp &cmp, std::input_iterator_tag,
+                                                 std::input_iterator_tag) {
+        return (_QMJ _set_symmetric_difference_merge(first1, last1, first2, last2, dest, cmp));
+    }
+
+    template<typename RIter1, typename RIter2, typename OIter, typename Comp>
+    inline OIter _set_symmetric_difference_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2,
+                                                 OIter dest, const Comp &cmp, std::random_access_iterator_tag,
+                                                 std::random_access_iterator_tag) {
+        if (!_QMJ _set_gallops(first1, last1, first2, last2))
+            return (_QMJ _set_symmetric_difference_merge(first1, last1, first2, last2, dest, cmp));
+        if (last1 - first1 < last2 - first2) {
+            for (; first1 != last1; ++first1) {
+                const RIter2 cut = _QMJ _gallop_lower(first2, last2, *first1, cmp);
+                dest = std::copy(first2, cut, dest);
+                first2 = cut;
+                if (first2 != last2 && !cmp(*first1, *first2))
+                    ++first2;
+                else
+                    *dest++ = *first1;
+            }
+            return (std::copy(first2, last2, dest));
+        }
+        for (; first2 != last2; ++first2) {
+            const RIter1 cut = _QMJ _gallop_lower(first1, last1, *first2, cmp);
+            dest = std::copy(first1, cut, dest);
+            first1 = cut;
+            if (first1 != last1 && !cmp(*first2, *first1))
+                ++first1;
+            else
+                *dest++ = *first2;
+        }
+        return (std::copy(first1, last1, dest));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter, typename Comp>
+    inline OIter set_symmetric_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                          OIter dest, const Comp &cmp) {
+        return (_QMJ _set_symmetric_difference_imple(first1, last1, first2, last2, dest, cmp,
+                                                     iter_cate_t<IIter1>(), iter_cate_t<IIter2>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename OIter>
+    inline OIter set_symmetric_difference(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                                          OIter dest) {
+        return (_QMJ set_symmetric_difference(first1, last1, first2, last2, dest, std::less<>()));
+    }
+
+    template<typename IIter1, typename IIter2, typename Comp>
+    inline bool _includes_merge(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, const Comp &cmp) {
+        if (first1 != last1 && first2 != last2) {
+            for (;;) {
+                if (cmp(*first2, *first1))
+                    return (false);
+                else if (cmp(*first1, *first2)) {
+                    if (++first1 == last1)
+                        break;
+                } else {
+                    ++first1;
+                    ++first2;
+                    if (first1 == last1 || first2 == last2)
+                        break;
+                }
+            }
+        }
+        return (first2 == last2);
+    }
+
+    template<typename IIter1, typename IIter2, typename Comp>
+    inline bool _includes_imple(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2, const Comp &cmp,
+                                std::input_iterator_tag, std::input_iterator_tag) {
+        return (_QMJ _includes_merge(first1, last1, first2, last2, cmp));
+    }
+
+    //a longer second range cannot be included, a much shorter one has each
+    //key galloped to
+    template<typename RIter1, typename RIter2, typename Comp>
+    inline bool _includes_imple(RIter1 first1, RIter1 last1, RIter2 first2, RIter2 last2, const Comp &cmp,
+                                std::random_access_iterator_tag, std::random_access_iterator_tag) {
+        if (last2 - first2 > last1 - first1)
+            return (false);
+        if (!_QMJ _set_gallops(first1, last1, first2, last2))
+            return (_QMJ _includes_merge(first1, last1, first2, last2, cmp));
+        for (; first2 != last2; ++first2, ++first1) {
+            first1 = _QMJ _gallop_lower(first1, last1, *first2, cmp);
+            if (first1 == last1 || cmp(*first2, *first1))
+                return (false);
+        }
+        return (true);
+    }
+
+    template<typename IIter1, typename IIter2, typename Comp>
+    inline bool includes(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2,
+                         const Comp &cmp) {
+        return (_QMJ _includes_imple(first1, last1, first2, last2, cmp,
+                                     iter_cate_t<IIter1>(), iter_cate_t<IIter2>()));
+    }
+
+    template<typename IIter1, typename IIter2>
+    inline bool includes(IIter1 first1, IIter1 last1, IIter2 first2, IIter2 last2) {
+        return (_QMJ includes(first1, last1, first2, last2, std::less<>()));
+    }
+
+    //splits [first,last) into [< pivot] [== pivot] [> pivot] and returns
+    //the middle range
+    template<typename RIter, typename T, typename Comp>
+    inline std::pair<RIter, RIter> _partition3(RIter first, RIter last, const T &pivot, const Comp &cmp) {
+        RIter lt = first;
+        while (first != last)
+            if (cmp(*first, pivot))
+                _QMJ iter_swap(lt++, first++);
+            else if (cmp(pivot, *first))
+                _QMJ iter_swap(first, --last);
+            else
+                ++first;
+        return (std::pair<RIter, RIter>(lt, last));
+    }
+
+    //median of medians: the pivot is the median of the medians of groups
+    //of five, found the same way, so at least 3/10 of the range falls on
+    //either side and the selection is linear in the worst case
+    template<typename RIter, typename Comp>
+    inline void _median_select(RIter first, RIter nth, RIter last, const Comp &cmp) {
+        typedef iter_dif_t<RIter> Dif;
+        while (size_t(last - first) > sort_threshold) {
+            const Dif len = last - first;
+            Dif medians = 0;
+            for (Dif group = 0; group + 5 <= len; group += 5) {
+                _insert_sort(first + group, first + (group + 5), cmp);
+                _QMJ iter_swap(first + medians++, first + (group + 2));
+            }
+            RIter mid = first + medians / 2;
+            _median_select(first, mid, first + medians, cmp);
+            const iter_val_t<RIter> pivot = *mid;
+            std::pair<RIter, RIter> equal = _partition3(first, last, pivot, cmp);
+            if (nth < equal.first)
+                last = equal.first;
+            else if (nth < equal.second)
+                return;
+            else
+                first = equal.second;
+        }
+        _insert_sort(first, last, cmp);
+    }
+
+    //a range above this first selects nth inside a sample, so that the
+    //pivot lands right next to it
+    constexpr size_t floyd_rivest_threshold = 600;
+
+    //Floyd-Rivest select. the sample of about n^(2/3) elements is placed
+    //around nth and selected recursively, its nth is the pivot, and the
+    //range holding nth after the partition is usually a sliver. every two
+    //partitions must halve the range, as in introselect, or the rest goes
+    //to _median_select, which keeps the worst case linear
+    template<typename RIter, typename Comp>
+    inline void _floyd_rivest_select(RIter first, RIter nth, RIter last, const Comp &cmp) {
+        typedef iter_dif_t<RIter> Dif;
+        const Dif k = nth - first;
+        Dif left = 0, right = last - first - 1;
+        Dif budget = right - left + 1;
+        int steps = 0;
+        while (right > left) {
+            if (size_t(right - left) < sort_threshold) {
+                _insert_sort(first + left, first + (right + 1), cmp);
+                return;
+            }
+            if (size_t(right - left) > floyd_rivest_threshold) {
+                const double n = double(right - left + 1);
+                const double i = double(k - left + 1);
+                const double z = std::log(n);
+                const double s = 0.5 * std::exp(2 * z / 3);
+                const double sd = 0.5 * std::sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1 : 1);
+                const Dif sample_left = std::max(left, Dif(double(k) - i * s / n + sd));
+                const Dif sample_right = std::min(right, Dif(double(k) + (n - i) * s / n + sd));
+                _floyd_rivest_select(first + sample_left, nth, first + (sample_right + 1), cmp);
+            }
+            const iter_val_t<RIter> pivot = first[k];
+            Dif i = left, j = right;
+            _QMJ iter_swap(first + left, first + k);
+            if (cmp(pivot, first[right]))
+                _QMJ iter_swap(first + right, first + left);
+            while (i < j) {
+                _QMJ iter_swap(first + i, first + j);
+                ++i;
+                --j;
+                while (cmp(first[i], pivot))
+                    ++i;
+                while (cmp(pivot, first[j]))
+                    --j;
+            }
+            if (!cmp(first[left], pivot) && !cmp(pivot, first[left]))
+                _QMJ iter_swap(first + left, first + j);
+            else
+                _QMJ iter_swap(first + ++j, first + right);
+            if (j == k)
+                return;
+            if (j < k)
+                left = j + 1;
+            else
+                right = j - 1;
+            if (++steps == 2) {
+                if (right - left + 1 > budget / 2) {
+                    _median_select(first + left, nth, first + (right + 1), cmp);
+                    return;
+                }
+                budget = right - left + 1;
+                steps = 0;
+            }
+        }
+    }
+
+    template<typename RIter, typename Comp>
+    inline void nth_element(RIter first, RIter nth, RIter last, const Comp &cmp) {
+        if (last - first > 1 && nth != last)
+            _floyd_rivest_select(first, nth, last, cmp);
+    }
+
+    template<typename RIter>
+    inline void nth_element(RIter first, RIter nth, RIter last) {
+        _QMJ nth_element(first, nth, last, std::less<>());
+    }
+
+    //while k is under this fraction of the range the top k are kept in a
+    //heap that most elements leave after one comparison; past it,
+    //nth_element cutting off the top k and sort finishing them wins, as
+    //Floyd-Rivest costs little more than one pass for any k
+    constexpr size_t partial_sort_heap_ratio = 8192;
+
+    template<typename RIter, typename Comp>
+    inline void _heap_select(RIter first, RIter middle, RIter last, const Comp &cmp) {
+        const iter_dif_t<RIter> len = middle - first;
+        _QMJ make_heap(first, middle, cmp);
+        for (RIter cur = middle; cur != last; ++cur)
+            if (cmp(*cur, *first)) {
+                iter_val_t<RIter> val = std::move(*cur);
+                *cur = std::move(*first);
+                _QMJ _heapify(first, iter_dif_t<RIter>(0), len, std::move(val), cmp);
+            }
+    }
+
+    template<typename RIter, typename Comp>
+    inline void partial_sort(RIter first, RIter middle, RIter last, const Comp &cmp) {
+        const iter_dif_t<RIter> len = middle - first;
+        if (!len)
+            return;
+        else if (len == 1) {
+            _QMJ iter_swap(first, _QMJ min_element(first, last, cmp));
+            return;
+        }
+        if (size_t(len) * partial_sort_heap_ratio < size_t(last - first)) {
+            _QMJ _heap_select(first, middle, last, cmp);
+            _QMJ sort_heap(first, middle, cmp);
+        } else {
+            _QMJ nth_element(first, middle - 1, last, cmp);
+            _QMJ sort(first, middle - 1, cmp);
+        }
+    }
+
+    template<typename RIter>
+    inline void partial_sort(RIter first, RIter middle, RIter last) {
+        _QMJ partial_sort(first, middle, last, std::less<>());
+    }
+
+    //the destination holds a heap of the smallest elements read so far, so
+    //only dest_last - dest_first of them are ever written
+    template<typename IIter, typename RIter, typename Comp>
+    inline RIter partial_sort_copy(IIter first, IIter last, RIter dest_first, RIter dest_last,
+                                   const Comp &cmp) {
+        RIter result = dest_first;
+        for (; first != last && result != dest_last; ++first, ++result)
+            *result = *first;
+        const iter_dif_t<RIter> len = result - dest_first;
+        if (!len)
+            return (result);
+        _QMJ make_heap(dest_first, result, cmp);
+        for (; first != last; ++first)
+            if (cmp(*first, *dest_first)) {
+                iter_val_t<RIter> val = *first;
+                _QMJ _heapify(dest_first, iter_dif_t<RIter>(0), len, std::move(val), cmp);
+            }
+        _QMJ sort_heap(dest_first, result, cmp);
+        return (result);
+    }
+
+    template<typename IIter, typename RIter>
+    inline RIter partial_sort_copy(IIter first, IIter last, RIter dest_first, RIter dest_last) {
+        return (_QMJ partial_sort_copy(first, last, dest_first, dest_last, std::less<>()));
+    }
+
+    //maps an arithmetic key onto an unsigned integer of the same width that
+    //orders the same way: signed integers get the sign bit flipped, floats
+    //get every bit flipped when negative and just the sign bit otherwise,
+    //so -0.0 sorts before 0.0 and NaNs go to the ends
+    template<typename type, typename = void>
+    struct radix_traits {
+    };
+
+    template<typename type>
+    struct radix_traits<type, enable_if_t<std::is_integral<type>::value && !is_same<type, bool>::value>> {
+        typedef typename std::make_unsigned<type>::type bits_type;
+
+        static bits_type to_bits(const type val) {
+            const bits_type sign = std::is_signed<type>::value ? bits_type(1) << (sizeof(type) * 8 - 1) : 0;
+            return (bits_type(bits_type(val) ^ sign));
+        }
+    };
+
+    template<typename type>
+    struct radix_traits<type, enable_if_t<std::is_floating_point<type>::value &&
+                                          (sizeof(type) == 4 || sizeof(type) == 8)>> {
+        typedef typename If<sizeof(type) == 4, std::uint32_t, std::uint64_t>::type bits_type;
+
+        static bits_type to_bits(const type val) {
+            bits_type bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            const bits_type sign = bits_type(1) << (sizeof(type) * 8 - 1);
+            return (bits & sign ? bits_type(~bits) : bits_type(bits | sign));
+        }
+    };
+
+    struct radix_identity {
+        template<typename type>
+        const type &operator()(const type &val) const { return (val); }
+    };
+
+    template<typename Iter, typename Key>
+    using radix_key_t = typename std::decay<decltype(std::declval<const Key &>()(*std::declval<Iter>()))>::type;
+
+    template<typename Iter, typename Key>
+    using radix_bits_t = typename radix_traits<radix_key_t<Iter, Key>>::bits_type;
+
+    template<typename Iter, typename Key>
+    inline radix_bits_t<Iter, Key> _radix_bits(const Key &key, const iter_val_t<Iter> &val) {
+        return (radix_traits<radix_key_t<Iter, Key>>::to_bits(key(val)));
+    }
+
+    template<typename Iter, typename Key>
+    struct _radix_less {
+        explicit _radix_less(const Key &key) : key(key) {}
+
+        bool operator()(const iter_val_t<Iter> &left, const iter_val_t<Iter> &right) const {
+            return (_radix_bits<Iter>(key, left) < _radix_bits<Iter>(key, right));
+        }
+
+        const Key &key;
+    };
+
+    //one counting pass: moves [first,last) to dest ordered by the byte at
+    //shift, offsets holds each byte's start and is consumed
+    template<typename Iter, typename OIter, typename Key>
+    inline void _radix_scatter(Iter first, Iter last, OIter dest, size_t *offsets, int shift, const Key &key) {
+        for (; first != last; ++first)
+            dest[offsets[(_radix_bits<Iter>(key, *first) >> shift) & 0xff]++] = std::move(*first);
+    }
+
+    template<typename type>
+    inline void _radix_put(type *dest, type &&val, true_type) {
+        ::new(static_cast<void *>(dest)) type(std::move(val));
+    }
+
+    template<typename Iter, typename type>
+    inline void _radix_put(Iter dest, type &&val, false_type) {
+        *dest = std::move(val);
+    }
+
+    //uninitialized room for n elements, so the scatter buffers ask nothing
+    //of the element type but a move; empty if the memory cannot be had.
+    //live marks that every slot holds an element to destroy
+    template<typename value_type, typename Alloc = _QMJ allocator<value_type>>
+    class _radix_raw_buffer {
+    public:
+        typedef Alloc alloc;
+
+        explicit _radix_raw_buffer(size_t n) : len(0), first(nullptr), live(false) {
+            try {
+                first = alloc::allocate(n);
+                len = n;
+            } catch (_BAD_ALLOC) {
+            }
+        }
+
+        _radix_raw_buffer(const _radix_raw_buffer &) = delete;
+
+        _radix_raw_buffer &operator=(const _radix_raw_buffer &) = delete;
+
+        ~_radix_raw_buffer() {
+            if (live)
+                alloc::destroy(first, first + len);
+            if (first)
+                alloc::deallocate(first, len);
+        }
+
+        size_t size() const { return (len); }
+
+        value_type *begin() { return (first); }
+
+        value_type *end() { return (first + len); }
+
+        size_t len;
+        value_type *first;
+        bool live;
+    };
+
+    //the first pass into the scatter buffers constructs their elements,
+    //later passes assign to them
+    template<bool construct, typename KIter, typename VIter, typename OKIter, typename OVIter, typename Key>
+    inline void _radix_scatter_by_key(KIter kfirst, KIter klast, VIter vfirst, OKIter kdest, OVIter vdest,
+                                      size_t *offsets, int shift, const Key &key) {
+        for (; kfirst != klast; ++kfirst, ++vfirst) {
+            const size_t pos = offsets[(_radix_bits<KIter>(key, *kfirst) >> shift) & 0xff]++;
+            _radix_put(kdest + pos, std::move(*kfirst), bool_type<construct>());
+            _radix_put(vdest + pos, std::move(*vfirst), bool_type<construct>());
+        }
+    }
+
+    //turns counts into start offsets, false when one byte value holds all
+    //n elements and the pass would not move anything
+    inline bool _radix_offsets(size_t *counts, size_t *offsets, size_t n) {
+        size_t sum = 0;
+        for (int i = 0; i != 256; ++i) {
+            if (counts[i] == n)
+                return (false);
+            offsets[i] = sum;
+            sum += counts[i];
+        }
+        return (true);
+    }
+
+    template<typename RIter, typename Key>
+    inline void _radix_histograms(RIter first, RIter last, size_t (*counts)[256], const Key &key) {
+        const int bytes = sizeof(radix_bits_t<RIter, Key>);
+        for (; first != last; ++first) {
+            const radix_bits_t<RIter, Key> bits = _radix_bits<RIter>(key, *first);
+            for (int i = 0; i != bytes; ++i)
+                ++counts[i][(bits >> (i * 8)) & 0xff];
+        }
+    }
+
+    //LSD radix sort on the key key(val) of every element: stable, one
+    //counting pass per key byte after a single histogram pass, bytes equal
+    //across the whole range are skipped. it needs a buffer of n elements
+    //and falls back to stable_sort when one cannot be had
+    template<typename RIter, typename Key>
+    inline void radix_sort(RIter first, RIter last, Key key) {
+        typedef iter_val_t<RIter> value_type;
+        const int bytes = sizeof(radix_bits_t<RIter, Key>);
+        const size_t n = size_t(last - first);
+        if (n <= sort_threshold) {
+            _insert_sort(first, last, _radix_less<RIter, Key>(key));
+            return;
+        }
+        temporary_buffer<value_type> buf(n);
+        if (buf.size() < n) {
+            _QMJ stable_sort(first, last, _radix_less<RIter, Key>(key));
+            return;
+        }
+        size_t counts[bytes][256] = {};
+        size_t offsets[256];
+        _radix_histograms(first, last, counts, key);
+        bool in_buf = false;
+        for (int i = 0; i != bytes; ++i) {
+            if (!_radix_offsets(counts[i], offsets, n))
+                continue;
+            if (in_buf)
+                _radix_scatter(buf.begin(), buf.end(), first, offsets, i * 8, key);
+            else
+                _radix_scatter(first, last, buf.begin(), offsets, i * 8, key);
+            in_buf = !in_buf;
+        }
+        if (in_buf)
+            for (value_type *cur = buf.begin(); cur != buf.end(); ++cur, ++first)
+                *first = std::move(*cur);
+    }
+
+    template<typename RIter>
+    inline void radix_sort(RIter first, RIter last) {
+        _QMJ radix_sort(first, last, radix_identity());
+    }
+
+    //sorts positions by key and applies the permutation with moves, for
+    //when the scatter buffers cannot be had or a move might throw midway
+    template<typename KIter, typename VIter, typename Key>
+    inline void _sort_by_key_permute(KIter kfirst, VIter vfirst, const size_t n, const Key &key) {
+        typedef iter_val_t<KIter> key_type;
+        typedef iter_val_t<VIter> value_type;
+        temporary_buffer<size_t> order(n);
+        if (order.size() < n) {
+            //not even the positions fit, insertion sort the pairs in place
+            for (size_t i = 1; i != n; ++i) {
+                size_t j = i;
+                for (; j && _radix_bits<KIter>(key, kfirst[i]) < _radix_bits<KIter>(key, kfirst[j - 1]); --j);
+                if (j == i)
+                    continue;
+                key_type k = std::move(kfirst[i]);
+                value_type v = std::move(vfirst[i]);
+                for (size_t cur = i; cur != j; --cur) {
+                    kfirst[cur] = std::move(kfirst[cur - 1]);
+                    vfirst[cur] = std::move(vfirst[cur - 1]);
+                }
+                kfirst[j] = std::move(k);
+                vfirst[j] = std::move(v);
+            }
+            return;
+        }
+        for (size_t i = 0; i != n; ++i)
+            order.begin()[i] = i;
+        _QMJ stable_sort(order.begin(), order.end(), [&](const size_t left, const size_t right) {
+            return (_radix_bits<KIter>(key, kfirst[left]) < _radix_bits<KIter>(key, kfirst[right]));
+        });
+        for (size_t i = 0; i != n; ++i) {
+            if (order.begin()[i] == n)
+                continue;
+            key_type k = std::move(kfirst[i]);
+            value_type v = std::move(vfirst[i]);
+            size_t cur = i;
+            for (size_t next; (next = order.begin()[cur]) != i; cur = next) {
+                kfirst[cur] = std::move(kfirst[next]);
+                vfirst[cur] = std::move(vfirst[next]);
+                order.begin()[cur] = n;
+            }
+            kfirst[cur] = std::move(k);
+            vfirst[cur] = std::move(v);
+            order.begin()[cur] = n;
+        }
+    }
+
+    //stable LSD radix sort of [kfirst,klast) on key(k) of every element,
+    //applying the same permutation to the values starting at vfirst. the
+    //scatter buffers are raw storage, so neither type needs a default
+    //constructor; a type whose move may throw is sorted through positions
+    template<typename KIter, typename VIter, typename Key>
+    inline void sort_by_key(KIter kfirst, KIter klast, VIter vfirst, Key key) {
+        typedef iter_val_t<KIter> key_type;
+        typedef iter_val_t<VIter> value_type;
+        const int bytes = sizeof(radix_bits_t<KIter, Key>);
+        const size_t n = size_t(klast - kfirst);
+        if (n < 2)
+            return;
+        if (!std::is_nothrow_move_constructible<key_type>::value ||
+            !std::is_nothrow_move_assignable<key_type>::value ||
+            !std::is_nothrow_move_constructible<value_type>::value ||
+            !std::is_nothrow_move_assignable<value_type>::value) {
+            _sort_by_key_permute(kfirst, vfirst, n, key);
+            return;
+        }
+        _radix_raw_buffer<key_type> kbuf(n);
+        _radix_raw_buffer<value_type> vbuf(n);
+        if (kbuf.size() < n || vbuf.size() < n) {
+            _sort_by_key_permute(kfirst, vfirst, n, key);
+            return;
+        }
+        size_t counts[bytes][256] = {};
+        size_t offsets[256];
+        _radix_histograms(kfirst, klast, counts, key);
+        bool in_buf = false;
+        for (int i = 0; i != bytes; ++i) {
+            if (!_radix_offsets(counts[i], offsets, n))
+                continue;
+            if (in_buf)
+                _radix_scatter_by_key<false>(kbuf.begin(), kbuf.end(), vbuf.begin(), kfirst, vfirst,
+                                             offsets, i * 8, key);
+            else if (kbuf.live)
+                _radix_scatter_by_key<false>(kfirst, klast, vfirst, kbuf.begin(), vbuf.begin(),
+                                             offsets, i * 8, key);
+            else {
+                _radix_scatter_by_key<true>(kfirst, klast, vfirst, kbuf.begin(), vbuf.begin(),
+                                            offsets, i * 8, key);
+                kbuf.live = vbuf.live = true;
+            }
+            in_buf = !in_buf;
+        }
+        if (in_buf)
+            for (size_t i = 0; i != n; ++i) {
+                kfirst[i] = std::move(kbuf.begin()[i]);
+                vfirst[i] = std::move(vbuf.begin()[i]);
+            }
+    }
+
+    template<typename KIter, typename VIter>
+    inline void sort_by_key(KIter kfirst, KIter klast, VIter vfirst) {
+        _QMJ sort_by_key(kfirst, klast, vfirst, radix_identity());
+    }
+
+    //one American flag pass per level: count the byte at shift, then
+    //swap every element straight into its bucket in place. a byte shared
+    //by the whole range is skipped without a pass
+    template<typename RIter, typename Key>
+    inline void _american_flag_imple(RIter first, RIter last, int shift, const Key &key) {
+        size_t counts[256];
+        size_t heads[256];
+        size_t tails[256];
+        for (;;) {
+            const size_t n = size_t(last - first);
+            if (n <= sort_threshold) {
+                _insert_sort(first, last, _radix_less<RIter, Key>(key));
+                return;
+            }
+            for (int i = 0; i != 256; ++i)
+                counts[i] = 0;
+            for (RIter cur = first; cur != last; ++cur)
+                ++counts[(_radix_bits<RIter>(key, *cur) >> shift) & 0xff];
+            if (_radix_offsets(counts, heads, n))
+                break;
+            if (shift == 0)
+                return;
+            shift -= 8;
+        }
+        for (int i = 0; i != 256; ++i)
+            tails[i] = heads[i] + counts[i];
+        for (int i = 0; i != 256; ++i)
+            while (heads[i] != tails[i]) {
+                iter_val_t<RIter> val = std::move(first[heads[i]]);
+                for (size_t b; (b = (_radix_bits<RIter>(key, val) >> shift) & 0xff) != size_t(i);)
+                    std::swap(val, first[heads[b]++]);
+                first[heads[i]++] = std::move(val);
+            }
+        if (shift == 0)
+            return;
+        for (int i = 0; i != 256; ++i)
+            if (counts[i] > 1)
+                _american_flag_imple(first + (tails[i] - counts[i]), first + tails[i], shift - 8, key);
+    }
+
+    //MSD radix sort in place (American flag sort): no buffer, not stable
+    template<typename RIter, typename Key>
+    inline void radix_sort_inplace(RIter first, RIter last, Key key) {
+        _american_flag_imple(first, last, int(sizeof(radix_bits_t<RIter, Key>) - 1) * 8, key);
+    }
+
+    template<typename RIter>
+    inline void radix_sort_inplace(RIter first, RIter last) {
+        _QMJ radix_sort_inplace(first, last, radix_identity());
     }
 }
 
@@ -263,7 +263,9 @@ namespace qmj {
             new(ptr)value_type();
         }
 
-        inline static pointer construct(pointer first, size_type n) {
+        //not an overload of construct: with value_type == size_type it would
+        //hijack construct(ptr, val)
+        inline static pointer construct_n(pointer first, size_type n) {
             for (; n != 0; --n, ++first)
                 new(first)value_type();
             return first;
@@ -394,7 +396,8 @@ namespace qmj {
         template<typename Iter>
         inline static pointer copy_construct_imple_nt_d_m(Iter first, Iter last, pointer dest, true_type) {
             const size_type distance = last - first;
-            memcopy(dest, &*first, sizeof(value_type) * distance);
+            if (distance)
+                memcpy(dest, &*first, sizeof(value_type) * distance);
             return (dest + distance);
         }
 
@@ -0,0 +1,311 @@
+#pragma once
+#ifndef _CONCURRENCY_QMJ_
+#define _CONCURRENCY_QMJ_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "allocator.h"
+
+namespace qmj {
+    class spin_lock {
+    public:
+        spin_lock() noexcept { flag.clear(); }
+
+        spin_lock(const spin_lock &) = delete;
+
+        spin_lock &operator=(const spin_lock &) = delete;
+
+        void lock() noexcept {
+            for (unsigned spin = 0; flag.test_and_set(std::memory_order_acquire); ++spin)
+                if (spin >= 64)
+                    std::this_thread::yield();
+        }
+
+        bool try_lock() noexcept { return (!flag.test_and_set(std::memory_order_acquire)); }
+
+        void unlock() noexcept { flag.clear(std::memory_order_release); }
+
+    private:
+        std::atomic_flag flag;
+    };
+
+    //readers share the lock by counting themselves in the low bits, a
+    //writer claims the top bit first so that no new reader gets in while it
+    //waits for the ones inside to drain
+    class shared_spin_lock {
+    public:
+        shared_spin_lock() noexcept : state(0) {}
+
+        shared_spin_lock(const shared_spin_lock &) = delete;
+
+        shared_spin_lock &operator=(const shared_spin_lock &) = delete;
+
+        void lock() noexcept {
+            unsigned spin = 0;
+            for (std::uint32_t s = state.load(std::memory_order_relaxed);;) {
+                if (!(s & writer)) {
+                    if (state.compare_exchange_weak(s, s | writer, std::memory_order_acquire,
+                                                    std::memory_order_relaxed))
+                        break;
+                } else {
+                    backoff(spin);
+                    s = state.load(std::memory_order_relaxed);
+                }
+            }
+            while (state.load(std::memory_order_acquire) != writer)
+                backoff(spin);
+        }
+
+        bool try_lock() noexcept {
+            std::uint32_t s = 0;
+            return (state.compare_exchange_strong(s, writer, std::memory_order_acquire,
+                                                  std::memory_order_relaxed));
+        }
+
+        //readers that bumped the count while the lock was held back out on
+        //their own, so only the writer bit is cleared here
+        void unlock() noexcept { state.fetch_sub(writer, std::memory_order_release); }
+
+        void lock_shared() noexcept {
+            for (unsigned spin = 0;; backoff(spin))
+                if (!(state.load(std::memory_order_relaxed) & writer)) {
+                    if (!(state.fetch_add(1, std::memory_order_acquire) & writer))
+                        return;
+                    state.fetch_sub(1, std::memory_order_relaxed);
+                }
+        }
+
+        void unlock_shared() noexcept { state.fetch_sub(1, std::memory_order_release); }
+
+    private:
+        static const std::uint32_t writer = std::uint32_t(1) << 31;
+
+        static void backoff(unsigned &spin) {
+            if (++spin >= 64)
+                std::this_thread::yield();
+        }
+
+        std::atomic<std::uint32_t> state;
+    };
+
+    template<typename Lock>
+    class shared_lock_guard {
+    public:
+        explicit shared_lock_guard(Lock &lock) : lock(lock) { lock.lock_shared(); }
+
+        shared_lock_guard(const shared_lock_guard &) = delete;
+
+        shared_lock_guard &operator=(const shared_lock_guard &) = delete;
+
+        ~shared_lock_guard() { lock.unlock_shared(); }
+
+    private:
+        Lock &lock;
+    };
+
+    //epoch based reclamation: a thread reads shared nodes only between
+    //enter() and leave(), and a retired node is freed once the global epoch
+    //has moved two steps past the epoch it was retired in, at which point no
+    //thread can still hold a pointer to it
+    class epoch_domain {
+    public:
+        typedef void (*deleter_type)(void *);
+
+        static epoch_domain &instance() {
+            static epoch_domain domain;
+            return (domain);
+        }
+
+        epoch_domain(const epoch_domain &) = delete;
+
+        epoch_domain &operator=(const epoch_domain &) = delete;
+
+        ~epoch_domain() {
+            free_list(orphans);
+            for (thread_record *rec = records.load(), *next; rec; rec = next) {
+                next = rec->next;
+                free_list(rec->limbo);
+                record_alloc::destroy(rec);
+                record_alloc::deallocate(rec);
+            }
+        }
+
+        void enter() {
+            thread_record *rec = local_record();
+            if (rec->nest++ == 0) {
+                rec->epoch.store(global_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+                rec->active.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        void leave() {
+            thread_record *rec = local_record();
+            if (--rec->nest == 0)
+                rec->active.store(false, std::memory_order_release);
+        }
+
+        void retire(void *ptr, deleter_type deleter) {
+            thread_record *rec = local_record();
+            retired_node *node = retired_alloc::allocate();
+            retired_alloc::construct(node, ptr, deleter, global_epoch.load(std::memory_order_acquire), rec->limbo);
+            rec->limbo = node;
+            if (++rec->limbo_count >= reclaim_threshold) {
+                try_advance();
+                reclaim(rec);
+            }
+        }
+
+    private:
+        enum {
+            reclaim_threshold = 64
+        };
+
+        struct retired_node {
+            retired_node(void *ptr, deleter_type deleter, std::uint64_t epoch, retired_node *next)
+                    : ptr(ptr), deleter(deleter), epoch(epoch), next(next) {}
+
+            void *ptr;
+            deleter_type deleter;
+            std::uint64_t epoch;
+            retired_node *next;
+        };
+
+        struct thread_record {
+            thread_record()
+                    : epoch(0), active(false), in_use(true), next(nullptr),
+                      nest(0), limbo(nullptr), limbo_count(0) {}
+
+            std::atomic<std::uint64_t> epoch;
+            std::atomic<bool> active;
+            std::atomic<bool> in_use;
+            thread_record *next;
+            size_t nest;
+            retired_node *limbo;
+            size_t limbo_count;
+        };
+
+        struct record_holder {
+            record_holder() : rec(instance().acquire_record()) {}
+
+            ~record_holder() { instance().release_record(rec); }
+
+            thread_record *rec;
+        };
+
+        typedef simple_allocator<retired_node> retired_alloc;
+        typedef simple_allocator<thread_record> record_alloc;
+
+        epoch_domain() : global_epoch(0), records(nullptr), orphans(nullptr) {}
+
+        static thread_record *local_record() {
+            static thread_local record_holder holder;
+            return (holder.rec);
+        }
+
+        thread_record *acquire_record() {
+            for (thread_record *rec = records.load(std::memory_order_acquire); rec; rec = rec->next) {
+                bool expected = false;
+                if (!rec->in_use.load(std::memory_order_relaxed) &&
+                    rec->in_use.compare_exchange_strong(expected, true))
+                    return (rec);
+            }
+            thread_record *rec = record_alloc::allocate();
+            record_alloc::construct(rec);
+            thread_record *head = records.load(std::memory_order_relaxed);
+            do {
+                rec->next = head;
+            } while (!records.compare_exchange_weak(head, rec, std::memory_order_release,
+                                                    std::memory_order_relaxed));
+            return (rec);
+        }
+
+        void release_record(thread_record *rec) {
+            if (rec->limbo) {
+                std::lock_guard<std::mutex> lock(orphan_mutex);
+                retired_node *tail = rec->limbo;
+                while (tail->next)
+                    tail = tail->next;
+                tail->next = orphans;
+                orphans = rec->limbo;
+                rec->limbo = nullptr;
+                rec->limbo_count = 0;
+            }
+            rec->nest = 0;
+            rec->active.store(false, std::memory_order_release);
+            rec->in_use.store(false, std::memory_order_release);
+        }
+
+        bool try_advance() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::uint64_t epoch = global_epoch.load(std::memory_order_acquire);
+            for (thread_record *rec = records.load(std::memory_order_acquire); rec; rec = rec->next)
+                if (rec->active.load(std::memory_order_acquire) &&
+                    rec->epoch.load(std::memory_order_acquire) != epoch)
+                    return (false);
+            return (global_epoch.compare_exchange_strong(epoch, epoch + 1));
+        }
+
+        //a thread's limbo list is newest first, so everything behind the
+        //first expired node has expired as well, orphans have no such order
+        static retired_node *split_expired(retired_node *&head, std::uint64_t epoch, size_t &kept) {
+            retired_node **link = &head;
+            kept = 0;
+            for (; *link && (*link)->epoch + 2 > epoch; link = &(*link)->next)
+                ++kept;
+            retired_node *expired = *link;
+            *link = nullptr;
+            return (expired);
+        }
+
+        static void free_list(retired_node *node) {
+            for (retired_node *next; node; node = next) {
+                next = node->next;
+                node->deleter(node->ptr);
+                retired_alloc::deallocate(node);
+            }
+        }
+
+        void reclaim(thread_record *rec) {
+            std::uint64_t epoch = global_epoch.load(std::memory_order_acquire);
+            free_list(split_expired(rec->limbo, epoch, rec->limbo_count));
+            if (orphan_mutex.try_lock()) {
+                retired_node *expired = nullptr;
+                for (retired_node **link = &orphans; *link;) {
+                    retired_node *node = *link;
+                    if (node->epoch + 2 <= epoch) {
+                        *link = node->next;
+                        node->next = expired;
+                        expired = node;
+                    } else
+                        link = &node->next;
+                }
+                orphan_mutex.unlock();
+                free_list(expired);
+            }
+        }
+
+    private:
+        std::atomic<std::uint64_t> global_epoch;
+        std::atomic<thread_record *> records;
+        retired_node *orphans;
+        std::mutex orphan_mutex;
+    };
+
+    //pins the calling thread's epoch for its lifetime, guards nest and
+    //must not be handed to another thread
+    class epoch_guard {
+    public:
+        epoch_guard() { epoch_domain::instance().enter(); }
+
+        epoch_guard(const epoch_guard &) { epoch_domain::instance().enter(); }
+
+        epoch_guard &operator=(const epoch_guard &) { return (*this); }
+
+        ~epoch_guard() { epoch_domain::instance().leave(); }
+    };
+}
+
+#endif //_CONCURRENCY_QMJ_
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef _CONCURRENT_MAP_QMJ_
+#define _CONCURRENT_MAP_QMJ_
+
+#include <mutex>
+#include <stdexcept>
+#include "map_qmj.h"
+#include "concurrent_skip_list.h"
+
+namespace qmj {
+    //find, lower_bound and upper_bound never block, insert and erase lock
+    //only the neighbours they relink; nodes are freed by whichever thread
+    //reclaims the epoch, so the default allocator is the thread safe one.
+    //insert_or_assign writes the mapped value in place under the element's
+    //own lock and at copies it out under the same lock, so the two may run
+    //together; reading through an iterator while another thread assigns
+    //that key is a race. there is no operator[], it could only hand out a
+    //reference that the next assignment races with
+    template<typename key_type_, typename data_type_, typename Compare = std::less<key_type_>,
+            typename Alloc = qmj::simple_allocator<std::pair<const key_type_, data_type_>>>
+    class concurrent_map
+            : public concurrent_skip_list<map_traits<key_type_, data_type_, Compare, Alloc, false>> {
+    public:
+        typedef key_type_ key_type;
+        typedef data_type_ data_type;
+        typedef data_type mapped_type;
+        typedef std::pair<const key_type, data_type> value_type;
+        typedef Compare key_compare;
+
+        typedef concurrent_skip_list<map_traits<key_type, data_type, Compare, Alloc, false>> base_type;
+        typedef concurrent_map<key_type, data_type, Compare, Alloc> self;
+
+        typedef typename base_type::pointer pointer;
+        typedef typename base_type::const_pointer const_pointer;
+        typedef typename base_type::reference reference;
+        typedef typename base_type::const_reference const_reference;
+        typedef typename base_type::iterator iterator;
+        typedef typename base_type::const_iterator const_iterator;
+        typedef typename base_type::size_type size_type;
+        typedef typename base_type::difference_type difference_type;
+
+        concurrent_map() : base_type() {}
+
+        explicit concurrent_map(const Compare &comp) : base_type(comp) {}
+
+        template<typename Iter>
+        concurrent_map(Iter first, Iter last) : base_type() {
+            base_type::insert(first, last);
+        }
+
+        concurrent_map(const std::initializer_list<value_type> &lst) : base_type() {
+            base_type::insert(lst.begin(), lst.end());
+        }
+
+        //erase marks an element under its lock, so an assignment that takes
+        //the lock either finds the element live or retries as an insert
+        template<typename M>
+        bool insert_or_assign(const key_type &k, M &&obj) {
+            epoch_guard guard;
+            link_type fresh = nullptr;
+            for (;;) {
+                link_type node = base_type::find_node(k);
+                if (!node) {
+                    if (!fresh)
+                        fresh = base_type::create_value_node(k, std::forward<M>(obj));
+                    if (!(node = base_type::link_node(fresh)))
+                        return (true);
+                }
+                std::lock_guard<spin_lock> lock(node->lock);
+                if (node->marked.load(std::memory_order_relaxed))
+                    continue;
+                if (!fresh) {
+                    node->value().second = std::forward<M>(obj);
+                    return (false);
+                }
+                try {
+                    node->value().second = std::move(fresh->value().second);
+                } catch (...) {
+                    base_type::destroy_node(fresh);
+                    throw;
+                }
+                base_type::destroy_node(fresh);
+                return (false);
+            }
+        }
+
+        //a copy, taken under the element's lock
+        mapped_type at(const key_type &k) const {
+            epoch_guard guard;
+            link_type node = base_type::find_node(k);
+            if (!node)
+                throw std::out_of_range("concurrent_map::at");
+            std::lock_guard<spin_lock> lock(node->lock);
+            return (node->value().second);
+        }
+
+    protected:
+        typedef typename base_type::link_type link_type;
+    };
+}
+
+#endif //_CONCURRENT_MAP_QMJ_
@@ -0,0 +1,457 @@
+#pragma once
+#ifndef _CONCURRENT_SKIP_LIST_
+#define _CONCURRENT_SKIP_LIST_
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include "allocator.h"
+#include "concurrency_qmj.h"
+
+namespace qmj {
+    template<typename value_type>
+    struct concurrent_skip_list_node {
+        typedef concurrent_skip_list_node<value_type> *link_type;
+
+        explicit concurrent_skip_list_node(int level)
+                : level(level), marked(false), fully_linked(false) {}
+
+        value_type &value() { return (*reinterpret_cast<value_type *>(&storage)); }
+
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+        int level;
+        std::atomic<bool> marked;
+        std::atomic<bool> fully_linked;
+        spin_lock lock;
+        //the node is over-allocated so that next holds level entries
+        std::atomic<link_type> next[1];
+    };
+
+    template<typename traits>
+    class concurrent_skip_list;
+
+    //iterators pin the current epoch, so the node they point to stays
+    //readable even if it is erased meanwhile, they must stay on one thread
+    template<typename value_type_>
+    class concurrent_skip_list_const_iterator {
+    public:
+        template<typename traits>
+        friend
+        class concurrent_skip_list;
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef value_type_ value_type;
+        typedef const value_type &reference;
+        typedef const value_type *pointer;
+        typedef ptrdiff_t difference_type;
+
+        typedef concurrent_skip_list_node<value_type> *link_type;
+        typedef concurrent_skip_list_const_iterator<value_type> self;
+
+        concurrent_skip_list_const_iterator(link_type node = nullptr) : node(node) {}
+
+        bool operator==(const self &x) const { return (node == x.node); }
+
+        bool operator!=(const self &x) const { return (!(operator==(x))); }
+
+        reference operator*() const { return (node->value()); }
+
+        pointer operator->() const { return (&(operator*())); }
+
+        self &operator++() {
+            node = skip_dead(node->next[0].load(std::memory_order_acquire));
+            return (*this);
+        }
+
+        self operator++(int) {
+            self tmp = *this;
+            operator++();
+            return (tmp);
+        }
+
+    protected:
+        static link_type skip_dead(link_type node) {
+            while (node && (node->marked.load(std::memory_order_acquire) ||
+                            !node->fully_linked.load(std::memory_order_acquire)))
+                node = node->next[0].load(std::memory_order_acquire);
+            return (node);
+        }
+
+    protected:
+        link_type node;
+        epoch_guard guard;
+    };
+
+    //lazy skip list: searches never lock or write, insert and erase lock
+    //only the predecessors of the node they change, unlinked nodes are
+    //handed to the epoch_domain instead of being freed in place
+    template<typename traits>
+    class concurrent_skip_list {
+    public:
+        typedef concurrent_skip_list<traits> self;
+        typedef typename traits::key_type key_type;
+        typedef typename traits::value_type value_type;
+        typedef typename traits::key_compare key_compare;
+        typedef typename traits::value_compare value_compare;
+        typedef typename traits::allocator_type allocator_type;
+        typedef key_compare Compare;
+        typedef size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type *pointer;
+        typedef const value_type *const_pointer;
+        typedef value_type &reference;
+        typedef const value_type &const_reference;
+
+        typedef concurrent_skip_list_node<value_type> node_type;
+        typedef node_type *link_type;
+        typedef typename allocator_type::template rebind<char>::other alloc;
+
+        typedef concurrent_skip_list_const_iterator<value_type> const_iterator;
+        typedef const_iterator iterator;
+        typedef std::pair<const_iterator, bool> pairib;
+
+        enum {
+            max_level = 32
+        };
+
+        concurrent_skip_list() : head(create_node(max_level)), comp(), node_count(0) {}
+
+        explicit concurrent_skip_list(const Compare &comp)
+                : head(create_node(max_level)), comp(comp), node_count(0) {}
+
+        concurrent_skip_list(const self &) = delete;
+
+        self &operator=(const self &) = delete;
+
+        //no other thread may use the list while it is destroyed
+        ~concurrent_skip_list() {
+            for (link_type cur = head->next[0].load(), next; cur; cur = next) {
+                next = cur->next[0].load();
+                destroy_node(cur);
+            }
+            free_node(head);
+        }
+
+        const_iterator begin() const {
+            return (const_iterator(const_iterator::skip_dead(head->next[0].load(std::memory_order_acquire))));
+        }
+
+        const_iterator end() const { return (const_iterator()); }
+
+        const_iterator cbegin() const { return (begin()); }
+
+        const_iterator cend() const { return (end()); }
+
+        //exact when no update is in flight
+        size_type size() const { return (node_count.load(std::memory_order_relaxed)); }
+
+        bool empty() const { return (!size()); }
+
+        size_type max_size() const { return size_type(-1); }
+
+        allocator_type get_allocator() const { return (allocator_type()); }
+
+        key_compare key_comp() const { return (comp); }
+
+        const_iterator find(const key_type &key) const {
+            epoch_guard guard;
+            return (const_iterator(find_node(key)));
+        }
+
+        bool contains(const key_type &key) const {
+            epoch_guard guard;
+            return (find_node(key) != nullptr);
+        }
+
+        size_type count(const key_type &key) const { return (contains(key) ? 1 : 0); }
+
+        const_iterator lower_bound(const key_type &key) const {
+            epoch_guard guard;
+            link_type pred = head;
+            link_type cur = nullptr;
+            for (int level = max_level - 1; level >= 0; --level) {
+                cur = pred->next[level].load(std::memory_order_acquire);
+                while (cur && comp(get_key(cur->value()), key)) {
+                    pred = cur;
+                    cur = pred->next[level].load(std::memory_order_acquire);
+                }
+            }
+            return (const_iterator(const_iterator::skip_dead(cur)));
+        }
+
+        const_iterator upper_bound(const key_type &key) const {
+            epoch_guard guard;
+            link_type pred = head;
+            link_type cur = nullptr;
+            for (int level = max_level - 1; level >= 0; --level) {
+                cur = pred->next[level].load(std::memory_order_acquire);
+                while (cur && !comp(key, get_key(cur->value()))) {
+                    pred = cur;
+                    cur = pred->next[level].load(std::memory_order_acquire);
+                }
+            }
+            return (const_iterator(const_iterator::skip_dead(cur)));
+        }
+
+        //two searches, so an insert or erase landing between them may be
+        //seen by one bound and not the other
+        std::pair<const_iterator, const_iterator> equal_range(const key_type &key) const {
+            return (std::pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key)));
+        }
+
+        pairib insert(const value_type &value) {
+            epoch_guard guard;
+            if (link_type node = find_node(get_key(value)))
+                return (pairib(const_iterator(node), false));
+            return (insert_node(create_value_node(value)));
+        }
+
+        pairib insert(value_type &&value) {
+            epoch_guard guard;
+            if (link_type node = find_node(get_key(value)))
+                return (pairib(const_iterator(node), false));
+            return (insert_node(create_value_node(std::move(value))));
+        }
+
+        template<typename Iter>
+        void insert(Iter first, Iter last) {
+            for (; first != last; ++first)
+                insert(*first);
+        }
+
+        template<typename... types>
+        pairib emplace(types &&... args) {
+            epoch_guard guard;
+            return (insert_node(create_value_node(std::forward<types>(args)...)));
+        }
+
+        size_type erase(const key_type &key) {
+            epoch_guard guard;
+            link_type preds[max_level];
+            link_type succs[max_level];
+            link_type victim = nullptr;
+            int top = 0;
+            for (bool is_marked = false;;) {
+                int found = find_imple(key, preds, succs);
+                if (!is_marked) {
+                    if (found == -1)
+                        return (0);
+                    victim = succs[found];
+                    if (!victim->fully_linked.load(std::memory_order_acquire) ||
+                        victim->level - 1 != found || victim->marked.load(std::memory_order_acquire))
+                        return (0);
+                    top = victim->level;
+                    victim->lock.lock();
+                    if (victim->marked.load(std::memory_order_relaxed)) {
+                        victim->lock.unlock();
+                        return (0);
+                    }
+                    victim->marked.store(true, std::memory_order_release);
+                    is_marked = true;
+                }
+                int highest_locked = -1;
+                bool valid = true;
+                link_type prev_pred = nullptr;
+                for (int level = 0; valid && level < top; ++level) {
+                    link_type pred = preds[level];
+                    if (pred != prev_pred) {
+                        pred->lock.lock();
+                        highest_locked = level;
+                        prev_pred = pred;
+                    }
+                    valid = !pred->marked.load(std::memory_order_acquire) &&
+                            pred->next[level].load(std::memory_order_acquire) == victim;
+                }
+                if (!valid) {
+                    unlock_preds(preds, highest_locked);
+                    continue;
+                }
+                for (int level = top - 1; level >= 0; --level)
+                    preds[level]->next[level].store(victim->next[level].load(std::memory_order_relaxed),
+                                                    std::memory_order_release);
+                victim->lock.unlock();
+                unlock_preds(preds, highest_locked);
+                node_count.fetch_sub(1, std::memory_order_relaxed);
+                epoch_domain::instance().retire(victim, &reclaim_node);
+                return (1);
+            }
+        }
+
+        //erases by the key pos holds, which is a no-op if another thread
+        //got there first; the result is pos's successor as seen before
+        const_iterator erase(const_iterator pos) {
+            const_iterator next = pos;
+            ++next;
+            erase(get_key(*pos));
+            return (next);
+        }
+
+        //safe against concurrent updates, each element is erased on its own
+        void clear() {
+            for (const_iterator iter = begin(); iter != end(); iter = begin())
+                erase(get_key(*iter));
+        }
+
+    protected:
+        const key_type &get_key(const value_type &val) const {
+            return (traits::keyOfValue(val));
+        }
+
+        static size_t node_bytes(int level) {
+            return (sizeof(node_type) + (level - 1) * sizeof(std::atomic<link_type>));
+        }
+
+        static link_type create_node(int level) {
+            link_type node = reinterpret_cast<link_type>(alloc::allocate(node_bytes(level)));
+            new(node) node_type(level);
+            for (int i = 0; i != level; ++i)
+                new(&node->next[i]) std::atomic<link_type>(nullptr);
+            return (node);
+        }
+
+        template<typename... types>
+        static link_type create_value_node(types &&... args) {
+            link_type node = create_node(random_level());
+            try {
+                new(&node->value()) value_type(std::forward<types>(args)...);
+            } catch (...) {
+                free_node(node);
+                throw;
+            }
+            return (node);
+        }
+
+        static void free_node(link_type node) {
+            size_t bytes = node_bytes(node->level);
+            node->~node_type();
+            alloc::deallocate(reinterpret_cast<char *>(node), bytes);
+        }
+
+        static void destroy_node(link_type node) {
+            node->value().~value_type();
+            free_node(node);
+        }
+
+        static void reclaim_node(void *ptr) { destroy_node(static_cast<link_type>(ptr)); }
+
+        //each level is kept with probability 1/2
+        static int random_level() {
+            static thread_local std::uint64_t state =
+                    std::uint64_t(reinterpret_cast<std::uintptr_t>(&state)) * 0x9E3779B97F4A7C15ull | 1;
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            std::uint64_t bits = (state * 0x2545F4914F6CDD1Dull) >> 32;
+            int level = 1;
+            for (; (bits & 1) && level != max_level; bits >>= 1)
+                ++level;
+            return (level);
+        }
+
+        link_type find_node(const key_type &key) const {
+            link_type pred = head;
+            for (int level = max_level - 1; level >= 0; --level) {
+                link_type cur = pred->next[level].load(std::memory_order_acquire);
+                while (cur && comp(get_key(cur->value()), key)) {
+                    pred = cur;
+                    cur = pred->next[level].load(std::memory_order_acquire);
+                }
+                if (cur && !comp(key, get_key(cur->value())))
+                    return (cur->fully_linked.load(std::memory_order_acquire) &&
+                            !cur->marked.load(std::memory_order_acquire) ? cur : nullptr);
+            }
+            return (nullptr);
+        }
+
+        int find_imple(const key_type &key, link_type *preds, link_type *succs) const {
+            int found = -1;
+            link_type pred = head;
+            for (int level = max_level - 1; level >= 0; --level) {
+                link_type cur = pred->next[level].load(std::memory_order_acquire);
+                while (cur && comp(get_key(cur->value()), key)) {
+                    pred = cur;
+                    cur = pred->next[level].load(std::memory_order_acquire);
+                }
+                if (found == -1 && cur && !comp(key, get_key(cur->value())))
+                    found = level;
+                preds[level] = pred;
+                succs[level] = cur;
+            }
+            return (found);
+        }
+
+        static void unlock_preds(link_type *preds, int highest_locked) {
+            link_type prev_pred = nullptr;
+            for (int level = 0; level <= highest_locked; ++level)
+                if (preds[level] != prev_pred) {
+                    prev_pred = preds[level];
+                    prev_pred->lock.unlock();
+                }
+        }
+
+        //node is not yet published, it is destroyed if the key exists
+        pairib insert_node(link_type node) {
+            if (link_type exist = link_node(node)) {
+                destroy_node(node);
+                return (pairib(const_iterator(exist), false));
+            }
+            return (pairib(const_iterator(node), true));
+        }
+
+        //publishes node and returns nullptr, or returns the live node that
+        //already holds its key and leaves node to the caller
+        link_type link_node(link_type node) {
+            const key_type &key = get_key(node->value());
+            const int top = node->level;
+            link_type preds[max_level];
+            link_type succs[max_level];
+            for (;;) {
+                int found = find_imple(key, preds, succs);
+                if (found != -1) {
+                    link_type exist = succs[found];
+                    if (!exist->marked.load(std::memory_order_acquire)) {
+                        while (!exist->fully_linked.load(std::memory_order_acquire))
+                            std::this_thread::yield();
+                        return (exist);
+                    }
+                    continue;
+                }
+                int highest_locked = -1;
+                bool valid = true;
+                link_type prev_pred = nullptr;
+                for (int level = 0; valid && level < top; ++level) {
+                    link_type pred = preds[level];
+                    link_type succ = succs[level];
+                    if (pred != prev_pred) {
+                        pred->lock.lock();
+                        highest_locked = level;
+                        prev_pred = pred;
+                    }
+                    valid = !pred->marked.load(std::memory_order_acquire) &&
+                            (!succ || !succ->marked.load(std::memory_order_acquire)) &&
+                            pred->next[level].load(std::memory_order_acquire) == succ;
+                }
+                if (!valid) {
+                    unlock_preds(preds, highest_locked);
+                    continue;
+                }
+                for (int level = 0; level != top; ++level)
+                    node->next[level].store(succs[level], std::memory_order_relaxed);
+                for (int level = 0; level != top; ++level)
+                    preds[level]->next[level].store(node, std::memory_order_release);
+                node->fully_linked.store(true, std::memory_order_release);
+                unlock_preds(preds, highest_locked);
+                node_count.fetch_add(1, std::memory_order_relaxed);
+                return (nullptr);
+            }
+        }
+
+    private:
+        link_type head;
+        Compare comp;
+        std::atomic<size_type> node_count;
+    };
+}
+
+#endif //_CONCURRENT_SKIP_LIST_
@@ -0,0 +1,222 @@
+#pragma once
+#ifndef _CONCURRENT_UNORDERED_MAP_QMJ_
+#define _CONCURRENT_UNORDERED_MAP_QMJ_
+
+#include <climits>
+#include <mutex>
+#include "concurrency_qmj.h"
+#include "execution_qmj.h"
+#include "unordered_map_qmj.h"
+
+namespace qmj {
+    //a power of two number of hashtables, each behind its own reader-writer
+    //lock. the shard comes from the top bits of the hash run through
+    //hash_int, while the table inside buckets by the raw hash; every bucket
+    //policy reads the raw bits it needs, the top ones under fastrange, so
+    //taking the shard from them directly would crowd each shard's keys
+    //into a slice of its buckets.
+    //no iterator outlives a lock: find copies the value out and the sweeps
+    //hand a shard's table to a callback while holding its lock. shards
+    //allocate nodes concurrently, so the default allocator is the thread
+    //safe one
+    template<typename key_type_, typename data_type_, typename HashFunction = qmj::hash<key_type_>,
+            typename EqualKey = std::equal_to<key_type_>,
+            typename Alloc = qmj::simple_allocator<std::pair<const key_type_, data_type_>>,
+            typename BucketPolicy = prime_bucket_policy>
+    class concurrent_unordered_map {
+    public:
+        typedef hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, false, BucketPolicy>> table_type;
+        typedef key_type_ key_type;
+        typedef data_type_ data_type;
+        typedef data_type mapped_type;
+        typedef typename table_type::value_type value_type;
+        typedef typename table_type::hasher hasher;
+        typedef typename table_type::key_equal key_equal;
+        typedef typename table_type::size_type size_type;
+        typedef typename table_type::difference_type difference_type;
+        typedef concurrent_unordered_map<key_type, data_type, HashFunction, EqualKey, Alloc, BucketPolicy> self;
+
+        explicit concurrent_unordered_map(const size_type shards = default_shard_count(),
+                                          const hasher &hf = hasher(), const key_equal &eql = key_equal())
+                : hash(hf), shard_bits(0), shard_list(nullptr) {
+            while ((size_type(1) << shard_bits) < shards && shard_bits + 1 < int(sizeof(size_t) * CHAR_BIT))
+                ++shard_bits;
+            const size_type n = shard_count();
+            shard_list = shard_alloc::allocate(n);
+            size_type built = 0;
+            try {
+                for (; built != n; ++built)
+                    shard_alloc::construct(shard_list + built, hf, eql);
+            } catch (...) {
+                release(built);
+                throw;
+            }
+        }
+
+        concurrent_unordered_map(const self &) = delete;
+
+        self &operator=(const self &) = delete;
+
+        ~concurrent_unordered_map() { release(shard_count()); }
+
+        size_type shard_count() const { return (size_type(1) << shard_bits); }
+
+        //exact only while no other thread writes
+        size_type size() const {
+            size_type n = 0;
+            for_each_shard([&](const table_type &table) { n += table.size(); });
+            return (n);
+        }
+
+        bool empty() const { return (size() == 0); }
+
+        bool find(const key_type &k, data_type &out) const {
+            const shard &s = shard_of(k);
+            shared_lock_guard<shared_spin_lock> guard(s.lock);
+            typename table_type::const_iterator iter = s.table.find(k);
+            if (iter == s.table.end())
+                return (false);
+            out = iter->second;
+            return (true);
+        }
+
+        size_type count(const key_type &k) const {
+            const shard &s = shard_of(k);
+            shared_lock_guard<shared_spin_lock> guard(s.lock);
+            return (s.table.count(k));
+        }
+
+        //returns true when k was inserted, false when an existing value
+        //was overwritten
+        template<typename M>
+        bool insert_or_assign(const key_type &k, M &&obj) {
+            return (insert_or_assign_imple(k, std::forward<M>(obj)));
+        }
+
+        template<typename M>
+        bool insert_or_assign(key_type &&k, M &&obj) {
+            return (insert_or_assign_imple(std::move(k), std::forward<M>(obj)));
+        }
+
+        size_type erase(const key_type &k) {
+            shard &s = shard_of(k);
+            std::lock_guard<shared_spin_lock> guard(s.lock);
+            return (s.table.erase(k));
+        }
+
+        //locks one shard at a time, so readers of the other shards carry on
+        template<typename Pred>
+        size_type erase_if(Pred pred) {
+            size_type erased = 0;
+            for_each_shard([&](table_type &table) {
+                for (typename table_type::iterator iter = table.begin(); iter != table.end();)
+                    if (pred(*iter)) {
+                        table.erase(iter++);
+                        ++erased;
+                    } else
+                        ++iter;
+            });
+            return (erased);
+        }
+
+        void clear() {
+            for_each_shard([](table_type &table) { table.clear(); });
+        }
+
+        //fn sees each shard's table in turn, under a shared lock for the
+        //const overload and an exclusive one otherwise
+        template<typename Fn>
+        void for_each_shard(Fn fn) const {
+            for_each_shard(seq, fn);
+        }
+
+        template<typename Fn>
+        void for_each_shard(Fn fn) {
+            for_each_shard(seq, fn);
+        }
+
+        //under par the shards are split between threads, so fn must be safe
+        //to call concurrently on different tables
+        template<typename ExPo, typename Fn>
+        enable_if_t<is_execution_policy<ExPo>::value, void>
+        for_each_shard(ExPo &&policy, Fn fn) const {
+            for_each_shard_imple(0, shard_count(), fork_depth(policy, shard_count(), 1), [&](const shard &s) {
+                shared_lock_guard<shared_spin_lock> guard(s.lock);
+                fn(static_cast<const table_type &>(s.table));
+            });
+        }
+
+        template<typename ExPo, typename Fn>
+        enable_if_t<is_execution_policy<ExPo>::value, void>
+        for_each_shard(ExPo &&policy, Fn fn) {
+            for_each_shard_imple(0, shard_count(), fork_depth(policy, shard_count(), 1), [&](const shard &s) {
+                std::lock_guard<shared_spin_lock> guard(s.lock);
+                fn(const_cast<table_type &>(s.table));
+            });
+        }
+
+        hasher hash_function() const { return (hash); }
+
+        static size_type default_shard_count() { return (4 * hardware_threads()); }
+
+    private:
+        //the padding keeps a shard's lock off the cache line holding the
+        //tail of its neighbour's table
+        struct shard {
+            shard(const hasher &hf, const key_equal &eql) : table(0, hf, eql) {}
+
+            mutable shared_spin_lock lock;
+            table_type table;
+            char pad[64];
+        };
+
+        typedef simple_allocator<shard> shard_alloc;
+
+        void release(const size_type built) {
+            for (size_type i = 0; i != built; ++i)
+                shard_alloc::destroy(shard_list + i);
+            shard_alloc::deallocate(shard_list);
+        }
+
+        size_type shard_index(const size_t h) const {
+            const int shift = int(sizeof(size_t) * CHAR_BIT) - shard_bits;
+            return (shard_bits ? hash_int(h) >> shift : 0);
+        }
+
+        shard &shard_of(const key_type &k) { return (shard_list[shard_index(hash(k))]); }
+
+        const shard &shard_of(const key_type &k) const { return (shard_list[shard_index(hash(k))]); }
+
+        template<typename K, typename M>
+        bool insert_or_assign_imple(K &&k, M &&obj) {
+            shard &s = shard_of(k);
+            std::lock_guard<shared_spin_lock> guard(s.lock);
+            typename table_type::iterator iter = s.table.find(k);
+            if (iter != s.table.end()) {
+                iter->second = std::forward<M>(obj);
+                return (false);
+            }
+            s.table.insert(value_type(std::forward<K>(k), std::forward<M>(obj)));
+            return (true);
+        }
+
+        template<typename Fn>
+        void for_each_shard_imple(const size_type first, const size_type last, const int depth, const Fn &fn) const {
+            if (depth <= 0 || last - first < 2) {
+                for (size_type i = first; i != last; ++i)
+                    fn(shard_list[i]);
+                return;
+            }
+            const size_type mid = first + (last - first) / 2;
+            fork_join([&] { for_each_shard_imple(first, mid, depth - 1, fn); },
+                      [&] { for_each_shard_imple(mid, last, depth - 1, fn); });
+        }
+
+    private:
+        hasher hash;
+        int shard_bits;
+        shard *shard_list;
+    };
+}
+
+#endif //_CONCURRENT_UNORDERED_MAP_QMJ_
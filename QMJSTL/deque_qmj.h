@@ -862,7 +862,7 @@ namespace qmj {
                     first = new_map;
                     deallocate_and_update_map(new_map, len);
                 }
-                last = alloc::construct(last, n - old_size);
+                last = alloc::construct_n(last, n - old_size);
             }
         }
 
@@ -0,0 +1,239 @@
+#pragma once
+#ifndef _EXECUTION_QMJ_
+#define _EXECUTION_QMJ_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "type_traits_qmj.h"
+
+namespace qmj {
+    struct sequenced_policy {
+    };
+
+    struct parallel_policy {
+    };
+
+    constexpr sequenced_policy seq{};
+    constexpr parallel_policy par{};
+
+    template<typename type>
+    struct is_execution_policy : false_type {
+    };
+
+    template<>
+    struct is_execution_policy<sequenced_policy> : true_type {
+    };
+
+    template<>
+    struct is_execution_policy<parallel_policy> : true_type {
+    };
+
+    template<typename type>
+    struct is_execution_policy<const type> : is_execution_policy<type> {
+    };
+
+    template<typename type>
+    struct is_execution_policy<type &> : is_execution_policy<type> {
+    };
+
+    inline size_t hardware_threads() {
+        size_t n = std::thread::hardware_concurrency();
+        return (n ? n : 1);
+    }
+
+    inline std::atomic<size_t> &_parallel_threads_setting() {
+        static std::atomic<size_t> n(0);
+        return (n);
+    }
+
+    //the threads a parallel algorithm plans for, hardware_threads() unless
+    //set_parallel_threads picked another count; 0 restores the default
+    inline size_t parallel_threads() {
+        const size_t n = _parallel_threads_setting().load(std::memory_order_relaxed);
+        return (n ? n : hardware_threads());
+    }
+
+    inline void set_parallel_threads(const size_t n) {
+        _parallel_threads_setting().store(n, std::memory_order_relaxed);
+    }
+
+    //number of times a task tree may still split in two before every
+    //thread has work
+    inline int fork_depth() {
+        int depth = 0;
+        for (size_t n = parallel_threads(); n > 1; n >>= 1)
+            ++depth;
+        return (depth + 1);
+    }
+
+    //how many times a job of the given size may fork before its pieces
+    //drop below grain, a sequenced job never forks
+    inline int fork_depth(const sequenced_policy &, size_t, size_t) { return (0); }
+
+    inline int fork_depth(const parallel_policy &, size_t work, size_t grain) {
+        int depth = 0;
+        for (int limit = fork_depth(); depth != limit && work >= 2 * grain; work >>= 1)
+            ++depth;
+        return (depth);
+    }
+
+    struct fork_task {
+        fork_task(void (*run)(void *), void *fn) : run(run), fn(fn), done(false) {}
+
+        void (*run)(void *);
+        void *fn;
+        std::exception_ptr error;
+        std::atomic<bool> done;
+    };
+
+    //the workers fork_join hands its first branch to, one fewer than
+    //parallel_threads() since the forking thread runs the second. they
+    //start on first use, share one deque of pending tasks and stay until
+    //the program ends; a count lowered later only stops new submissions
+    class fork_pool {
+    public:
+        static fork_pool &instance() {
+            static fork_pool pool;
+            return (pool);
+        }
+
+        fork_pool(const fork_pool &) = delete;
+
+        fork_pool &operator=(const fork_pool &) = delete;
+
+        ~fork_pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            wake.notify_all();
+            for (std::thread &worker : workers)
+                worker.join();
+        }
+
+        //false when there is no worker to take the task, the caller then
+        //runs it itself
+        bool submit(fork_task *task) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!start_workers())
+                return (false);
+            tasks.push_back(task);
+            lock.unlock();
+            wake.notify_one();
+            return (true);
+        }
+
+        //the task is run here if no worker has taken it yet, otherwise the
+        //queued tasks of other forks are run until a worker finishes it
+        void wait(fork_task *task) {
+            if (reclaim(task)) {
+                execute(task);
+                return;
+            }
+            while (!task->done.load(std::memory_order_acquire))
+                if (fork_task *other = pop())
+                    execute(other);
+                else
+                    std::this_thread::yield();
+        }
+
+    private:
+        fork_pool() : stop(false) {}
+
+        //called with mutex held
+        bool start_workers() {
+            const size_t want = parallel_threads() - 1;
+            if (!want)
+                return (false);
+            try {
+                while (workers.size() < want)
+                    workers.emplace_back([this] { work(); });
+            } catch (const std::system_error &) {
+            }
+            return (!workers.empty());
+        }
+
+        bool reclaim(fork_task *task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto iter = tasks.rbegin(); iter != tasks.rend(); ++iter)
+                if (*iter == task) {
+                    tasks.erase(std::next(iter).base());
+                    return (true);
+                }
+            return (false);
+        }
+
+        fork_task *pop() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty())
+                return (nullptr);
+            fork_task *task = tasks.front();
+            tasks.pop_front();
+            return (task);
+        }
+
+        void work() {
+            for (;;) {
+                fork_task *task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this] { return (stop || !tasks.empty()); });
+                    if (tasks.empty())
+                        return;
+                    task = tasks.front();
+                    tasks.pop_front();
+                }
+                execute(task);
+            }
+        }
+
+        static void execute(fork_task *task) {
+            try {
+                task->run(task->fn);
+            } catch (...) {
+                task->error = std::current_exception();
+            }
+            task->done.store(true, std::memory_order_release);
+        }
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<fork_task *> tasks;
+        std::vector<std::thread> workers;
+        bool stop;
+    };
+
+    //queues fn1 for the fork_pool and runs fn2 on this thread, then waits
+    //for both, the first exception thrown by either is rethrown; fn1 runs
+    //here after fn2 when no worker took it
+    template<typename Fn1, typename Fn2>
+    inline void fork_join(Fn1 &&fn1, Fn2 &&fn2) {
+        typedef typename std::remove_reference<Fn1>::type fn1_type;
+        fork_task task([](void *fn) { (*static_cast<fn1_type *>(fn))(); },
+                       const_cast<void *>(static_cast<const void *>(std::addressof(fn1))));
+        fork_pool &pool = fork_pool::instance();
+        if (!pool.submit(&task)) {
+            fn1();
+            fn2();
+            return;
+        }
+        try {
+            fn2();
+        } catch (...) {
+            pool.wait(&task);
+            throw;
+        }
+        pool.wait(&task);
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+}
+
+#endif //_EXECUTION_QMJ_
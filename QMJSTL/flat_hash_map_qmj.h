@@ -0,0 +1,103 @@
+#pragma once
+#ifndef _FLAT_HASH_MAP_QMJ_
+#define _FLAT_HASH_MAP_QMJ_
+
+#include "flat_hash_table.h"
+#include "unordered_map_qmj.h"
+
+namespace qmj {
+    //an unordered_map stored in place, a rehash or an erase invalidates
+    //iterators and references to its elements
+    template<typename key_type_, typename data_type_, typename HashFunction = qmj::hash<key_type_>,
+            typename EqualKey = std::equal_to<key_type_>,
+            typename Alloc = qmj::allocator<std::pair<const key_type_, data_type_>>>
+    class flat_hash_map
+            : public flat_hash_table<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, false>> {
+    public:
+        typedef flat_hash_table<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, false>> base_type;
+        typedef data_type_ data_type;
+        typedef data_type mapped_type;
+        typedef typename base_type::key_type key_type;
+        typedef typename base_type::value_type value_type;
+        typedef typename base_type::hasher hasher;
+        typedef typename base_type::key_equal key_equal;
+        typedef typename base_type::size_type size_type;
+
+        typedef flat_hash_map<key_type, data_type, HashFunction, EqualKey, Alloc> self;
+        typedef typename base_type::difference_type difference_type;
+        typedef typename base_type::pointer pointer;
+        typedef typename base_type::const_pointer const_pointer;
+        typedef typename base_type::reference reference;
+        typedef typename base_type::const_reference const_reference;
+        typedef typename base_type::iterator iterator;
+        typedef typename base_type::const_iterator const_iterator;
+
+        flat_hash_map() : base_type() {}
+
+        explicit flat_hash_map(size_type n) : base_type(n) {}
+
+        flat_hash_map(size_type n, const hasher &hf) : base_type(n, hf) {}
+
+        flat_hash_map(const size_type n, const hasher &hf, const key_equal &eql)
+                : base_type(n, hf, eql) {}
+
+        template<typename IIter>
+        flat_hash_map(IIter first, IIter last) : base_type() {
+            base_type::insert(first, last);
+        }
+
+        template<typename IIter>
+        flat_hash_map(IIter first, IIter last, size_type n) : base_type(n) {
+            base_type::insert(first, last);
+        }
+
+        template<typename IIter>
+        flat_hash_map(IIter first, IIter last, size_type n, const hasher &hf)
+                : base_type(n, hf) {
+            base_type::insert(first, last);
+        }
+
+        template<typename IIter>
+        flat_hash_map(IIter first, IIter last, const size_type n, const hasher &hf, const key_equal &eql)
+                : base_type(n, hf, eql) {
+            base_type::insert(first, last);
+        }
+
+        flat_hash_map(const std::initializer_list<value_type> &lst)
+                : flat_hash_map(lst.begin(), lst.end()) {}
+
+        flat_hash_map(const self &x) : base_type(x) {}
+
+        flat_hash_map(self &&x) : base_type(std::move(x)) {}
+
+        self &operator=(const self &x) {
+            base_type::operator=(x);
+            return (*this);
+        }
+
+        self &operator=(self &&x) {
+            base_type::operator=(std::move(x));
+            return (*this);
+        }
+
+        self &operator=(const std::initializer_list<value_type> &lst) {
+            base_type::clear();
+            base_type::insert(lst.begin(), lst.end());
+            return (*this);
+        }
+
+        data_type &operator[](const key_type &k) {
+            return (*((base_type::insert({k, data_type()})).first)).second;
+        }
+
+        void swap(self &x) noexcept { base_type::swap(x); }
+    };
+
+    template<typename key_type, typename data_type, typename HashFunction, typename EqualKey, typename Alloc>
+    void swap(flat_hash_map<key_type, data_type, HashFunction, EqualKey, Alloc> &left,
+              flat_hash_map<key_type, data_type, HashFunction, EqualKey, Alloc> &right) noexcept {
+        left.swap(right);
+    }
+}
+
+#endif //_FLAT_HASH_MAP_QMJ_
@@ -0,0 +1,701 @@
+#pragma once
+#ifndef _FLAT_HASH_TABLE_
+#define _FLAT_HASH_TABLE_
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+#include "allocator.h"
+#include "hashfunction.h"
+#include "type_traits_qmj.h"
+
+#if !defined _QMJ_FLAT_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define _QMJ_FLAT_SSE2 1
+#include <emmintrin.h>
+#else
+#define _QMJ_FLAT_SSE2 0
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace qmj {
+    //one control byte per slot: empty, deleted, the sentinel that ends
+    //iteration, or the low 7 bits of the hash of the element in the slot
+    typedef signed char flat_ctrl_type;
+    constexpr flat_ctrl_type flat_ctrl_empty = -128;
+    constexpr flat_ctrl_type flat_ctrl_deleted = -2;
+    constexpr flat_ctrl_type flat_ctrl_sentinel = -1;
+
+    inline int _flat_ctz(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return (__builtin_ctzll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, x);
+        return ((int) index);
+#else
+        int n = 0;
+        for (; !(x & 1); x >>= 1)
+            ++n;
+        return (n);
+#endif
+    }
+
+    inline int _flat_clz(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return (__builtin_clzll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, x);
+        return (63 - (int) index);
+#else
+        int n = 0;
+        for (; !(x & (std::uint64_t(1) << 63)); x <<= 1)
+            ++n;
+        return (n);
+#endif
+    }
+
+#if _QMJ_FLAT_SSE2
+
+    //a group is the run of control bytes probed at once, a match sets one
+    //bit per byte, shift converts a bit index to a byte index
+    struct flat_group {
+        enum {
+            width = 16,
+            shift = 0
+        };
+        typedef std::uint64_t mask_type;
+
+        explicit flat_group(const flat_ctrl_type *pos)
+                : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos))) {}
+
+        mask_type match(flat_ctrl_type h2) const {
+            return ((unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+        }
+
+        mask_type match_empty() const { return (match(flat_ctrl_empty)); }
+
+        mask_type match_empty_or_deleted() const {
+            return ((unsigned) _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(flat_ctrl_sentinel), ctrl)));
+        }
+
+        mask_type match_full_or_sentinel() const { return (~match_empty_or_deleted() & 0xffff); }
+
+        __m128i ctrl;
+    };
+
+#else
+
+    //eight control bytes in a word, the high bit of each byte is its match
+    //bit; match() may report a byte right after a real match, which the
+    //caller's key comparison filters out
+    struct flat_group {
+        enum {
+            width = 8,
+            shift = 3
+        };
+        typedef std::uint64_t mask_type;
+
+        static constexpr std::uint64_t lsbs = 0x0101010101010101ull;
+        static constexpr std::uint64_t msbs = 0x8080808080808080ull;
+
+        explicit flat_group(const flat_ctrl_type *pos) { memcpy(&ctrl, pos, sizeof(ctrl)); }
+
+        mask_type match(flat_ctrl_type h2) const {
+            std::uint64_t x = ctrl ^ (lsbs * (unsigned char) h2);
+            return ((x - lsbs) & ~x & msbs);
+        }
+
+        mask_type match_empty() const { return ((ctrl & (~ctrl << 6)) & msbs); }
+
+        mask_type match_empty_or_deleted() const { return ((ctrl & (~ctrl << 7)) & msbs); }
+
+        mask_type match_full_or_sentinel() const { return (~match_empty_or_deleted() & msbs); }
+
+        std::uint64_t ctrl;
+    };
+
+#endif
+
+    inline size_t _flat_lowest(flat_group::mask_type mask) {
+        return (_flat_ctz(mask) >> flat_group::shift);
+    }
+
+    //unmatched bytes at the high end of a group, mask must not be zero
+    inline size_t _flat_leading(flat_group::mask_type mask) {
+        return ((_flat_clz(mask) - (64 - (flat_group::width << flat_group::shift))) >> flat_group::shift);
+    }
+
+    template<typename traits>
+    class flat_hash_table;
+
+    template<typename traits>
+    class flat_hash_const_iterator {
+    public:
+        friend class flat_hash_table<traits>;
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename traits::value_type value_type;
+        typedef const value_type &reference;
+        typedef const value_type *pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef size_t size_type;
+        typedef flat_hash_const_iterator<traits> self;
+
+        flat_hash_const_iterator(const flat_ctrl_type *ctrl = nullptr, value_type *slot = nullptr)
+                : ctrl(ctrl), slot(slot) {}
+
+        flat_hash_const_iterator(const self &x) : ctrl(x.ctrl), slot(x.slot) {}
+
+        self &operator=(const self &x) {
+            ctrl = x.ctrl;
+            slot = x.slot;
+            return (*this);
+        }
+
+        bool operator==(const self &it) const { return (ctrl == it.ctrl); }
+
+        bool operator!=(const self &it) const { return (!(operator==(it))); }
+
+        reference operator*() const { return (*slot); }
+
+        pointer operator->() const { return (&(operator*())); }
+
+        self &operator++() {
+            ++ctrl;
+            ++slot;
+            skip_empty_or_deleted();
+            return (*this);
+        }
+
+        self operator++(int) {
+            self tmp = *this;
+            ++*this;
+            return (tmp);
+        }
+
+    protected:
+        //a whole group of free slots is skipped at a time, the sentinel
+        //after the last slot stops the scan
+        void skip_empty_or_deleted() {
+            while (*ctrl < flat_ctrl_sentinel) {
+                flat_group::mask_type mask = flat_group(ctrl).match_full_or_sentinel();
+                size_type n = mask ? _flat_lowest(mask) : size_type(flat_group::width);
+                ctrl += n;
+                slot += n;
+            }
+        }
+
+    protected:
+        const flat_ctrl_type *ctrl;
+        value_type *slot;
+    };
+
+    template<typename traits>
+    class flat_hash_iterator : public flat_hash_const_iterator<traits> {
+    public:
+        typedef flat_hash_const_iterator<traits> base_type;
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename traits::value_type value_type;
+        typedef value_type &reference;
+        typedef value_type *pointer;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef size_t size_type;
+        typedef flat_hash_iterator<traits> self;
+
+        flat_hash_iterator(const flat_ctrl_type *ctrl = nullptr, value_type *slot = nullptr)
+                : base_type(ctrl, slot) {}
+
+        flat_hash_iterator(const self &x) : base_type(x.ctrl, x.slot) {}
+
+        self &operator=(const self &x) {
+            this->ctrl = x.ctrl;
+            this->slot = x.slot;
+            return (*this);
+        }
+
+        bool operator==(const self &it) const { return (this->ctrl == it.ctrl); }
+
+        bool operator!=(const self &it) const { return (!(operator==(it))); }
+
+        reference operator*() const { return (*this->slot); }
+
+        pointer operator->() const { return (&(operator*())); }
+
+        self &operator++() {
+            base_type::operator++();
+            return (*this);
+        }
+
+        self operator++(int) {
+            self tmp = *this;
+            ++*this;
+            return (tmp);
+        }
+    };
+
+    //open addressing in the style of a swiss table: the elements live in one
+    //slot array, a parallel array of control bytes is probed a group at a
+    //time and the key is compared only where the 7 hash bits in the control
+    //byte match; takes the same traits as hashtable, keys are unique
+    template<typename traits>
+    class flat_hash_table {
+    public:
+        friend class flat_hash_const_iterator<traits>;
+
+        friend class flat_hash_iterator<traits>;
+
+        typedef typename traits::allocator_type allocator_type;
+        typedef typename traits::HashFunction hasher;
+        typedef typename traits::EqualKey key_equal;
+        typedef typename traits::key_type key_type;
+        typedef typename traits::value_type value_type;
+        typedef value_type *pointer;
+        typedef const value_type *const_pointer;
+        typedef value_type &reference;
+        typedef const value_type &const_reference;
+        typedef size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef typename allocator_type::template rebind<value_type>::other slot_alloc;
+        typedef typename allocator_type::template rebind<flat_ctrl_type>::other ctrl_alloc;
+        typedef flat_hash_const_iterator<traits> const_iterator;
+        typedef typename If<is_same<key_type, value_type>::value, const_iterator,
+                flat_hash_iterator<traits>>::type iterator;
+
+        typedef flat_hash_table<traits> self;
+        typedef std::pair<iterator, bool> PairIB;
+        typedef std::pair<iterator, iterator> PairII;
+        typedef std::pair<const_iterator, const_iterator> PairCC;
+
+        static_assert(!traits::is_multi, "flat_hash_table holds unique keys only");
+
+        flat_hash_table() : flat_hash_table(0) {}
+
+        explicit flat_hash_table(size_type n) : flat_hash_table(n, hasher(), key_equal()) {}
+
+        flat_hash_table(size_type n, const hasher &hash) : flat_hash_table(n, hash, key_equal()) {}
+
+        flat_hash_table(const hasher &hash, const key_equal &equals) : flat_hash_table(0, hash, equals) {}
+
+        flat_hash_table(size_type n, const hasher &hash, const key_equal &equals)
+                : ctrl(empty_group()), slots(nullptr), capacity(0), num_elements(0),
+                  growth_left(0), hash(hash), equals(equals) {
+            reserve(n);
+        }
+
+        flat_hash_table(const self &x) : flat_hash_table(x.size(), x.hash, x.equals) {
+            for (const_iterator first = x.cbegin(), last = x.cend(); first != last; ++first)
+                insert(*first);
+        }
+
+        flat_hash_table(self &&x)
+                : ctrl(x.ctrl), slots(x.slots), capacity(x.capacity), num_elements(x.num_elements),
+                  growth_left(x.growth_left), hash(std::move(x.hash)), equals(std::move(x.equals)) {
+            x.ctrl = empty_group();
+            x.slots = nullptr;
+            x.capacity = x.num_elements = x.growth_left = 0;
+        }
+
+        self &operator=(self x) {
+            swap(x);
+            return (*this);
+        }
+
+        ~flat_hash_table() { destroy_table(); }
+
+        void swap(self &x) noexcept {
+            std::swap(ctrl, x.ctrl);
+            std::swap(slots, x.slots);
+            std::swap(capacity, x.capacity);
+            std::swap(num_elements, x.num_elements);
+            std::swap(growth_left, x.growth_left);
+            std::swap(hash, x.hash);
+            std::swap(equals, x.equals);
+        }
+
+        iterator begin() {
+            iterator iter(ctrl, slots);
+            iter.skip_empty_or_deleted();
+            return (iter);
+        }
+
+        iterator end() { return (iterator(ctrl + capacity, slots + capacity)); }
+
+        const_iterator begin() const { return (cbegin()); }
+
+        const_iterator end() const { return (cend()); }
+
+        const_iterator cbegin() const {
+            const_iterator iter(ctrl, slots);
+            iter.skip_empty_or_deleted();
+            return (iter);
+        }
+
+        const_iterator cend() const { return (const_iterator(ctrl + capacity, slots + capacity)); }
+
+        size_type size() const { return (num_elements); }
+
+        bool empty() const { return (!size()); }
+
+        size_type max_size() const { return (slot_alloc::max_size()); }
+
+        size_type bucket_count() const { return (capacity); }
+
+        float load_factor() const noexcept {
+            return (capacity ? (float) size() / (float) capacity : 0.0f);
+        }
+
+        float max_load_factor() const noexcept { return (0.875f); }
+
+        const_iterator find(const key_type &k) const {
+            size_type i = find_index(k, hash_of(k));
+            return (i == npos ? cend() : const_iterator(ctrl + i, slots + i));
+        }
+
+        iterator find(const key_type &k) {
+            size_type i = find_index(k, hash_of(k));
+            return (i == npos ? end() : iterator_at(i));
+        }
+
+        size_type count(const key_type &k) const {
+            return (find_index(k, hash_of(k)) == npos ? 0 : 1);
+        }
+
+        PairII equal_range(const key_type &k) {
+            iterator first = find(k);
+            iterator last = first;
+            return (PairII(first, first == end() ? last : ++last));
+        }
+
+        PairCC equal_range(const key_type &k) const {
+            const_iterator first = find(k);
+            const_iterator last = first;
+            return (PairCC(first, first == cend() ? last : ++last));
+        }
+
+        PairIB insert(const value_type &val) {
+            std::pair<size_type, bool> pos = find_or_prepare_insert(get_key(val));
+            if (pos.second)
+                construct_at(pos.first, val);
+            return (PairIB(iterator_at(pos.first), pos.second));
+        }
+
+        PairIB insert(value_type &&val) {
+            std::pair<size_type, bool> pos = find_or_prepare_insert(get_key(val));
+            if (pos.second)
+                construct_at(pos.first, std::move(val));
+            return (PairIB(iterator_at(pos.first), pos.second));
+        }
+
+        iterator insert(const_iterator, const value_type &val) { return (insert(val).first); }
+
+        iterator insert(const_iterator, value_type &&val) { return (insert(std::move(val)).first); }
+
+        template<typename IIter>
+        void insert(IIter first, IIter last) {
+            for (; first != last; ++first)
+                insert(*first);
+        }
+
+        void insert(const std::initializer_list<value_type> &lst) {
+            insert(lst.begin(), lst.end());
+        }
+
+        template<typename... types>
+        PairIB emplace(types &&... args) {
+            return (insert(value_type(std::forward<types>(args)...)));
+        }
+
+        template<typename... types>
+        iterator emplace_hint(const_iterator, types &&... args) {
+            return (emplace(std::forward<types>(args)...).first);
+        }
+
+        void erase(const_iterator x) { erase_at(x.ctrl - ctrl); }
+
+        size_type erase(const key_type &k) {
+            size_type i = find_index(k, hash_of(k));
+            if (i == npos)
+                return (0);
+            erase_at(i);
+            return (1);
+        }
+
+        void erase(const_iterator first, const_iterator last) {
+            for (; first != last;)
+                erase(first++);
+        }
+
+        void clear() {
+            for (size_type i = 0; i != capacity; ++i)
+                if (is_full(ctrl[i]))
+                    slot_alloc::destroy(slots + i);
+            if (capacity) {
+                reset_ctrl();
+                growth_left = capacity_to_growth(capacity);
+            }
+            num_elements = 0;
+        }
+
+        //n is the number of elements the table must hold without growing,
+        //rehash can also shrink the table down to what size() needs
+        void rehash(size_type n) {
+            if (n < num_elements)
+                n = num_elements;
+            if (!n) {
+                destroy_table();
+                ctrl = empty_group();
+                slots = nullptr;
+                capacity = growth_left = 0;
+            } else if (growth_to_capacity(n) != capacity)
+                resize(growth_to_capacity(n));
+        }
+
+        void reserve(size_type n) {
+            if (n > num_elements + growth_left)
+                resize(growth_to_capacity(n));
+        }
+
+        allocator_type get_allocator() const { return (allocator_type()); }
+
+        hasher hash_function() const { return (hash); }
+
+        key_equal key_eq() const { return (equals); }
+
+    protected:
+        static constexpr size_type npos = size_type(-1);
+
+        static bool is_full(flat_ctrl_type c) { return (c >= 0); }
+
+        //the table starts out on a shared group holding only a sentinel, so
+        //lookups in an empty table need no special case
+        static flat_ctrl_type *empty_group() {
+            alignas(16) static flat_ctrl_type group[16] = {
+                    flat_ctrl_sentinel, flat_ctrl_empty, flat_ctrl_empty, flat_ctrl_empty,
+                    flat_ctrl_empty, flat_ctrl_empty, flat_ctrl_empty, flat_ctrl_empty,
+                    flat_ctrl_empty, flat_ctrl_empty, flat_ctrl_empty, flat_ctrl_empty,
+                    flat_ctrl_empty, flat_ctrl_empty, flat_ctrl_empty, flat_ctrl_empty};
+            return (group);
+        }
+
+        //capacities are 2^k - 1 so that a probe wraps with a mask, at least
+        //1/8 of the slots stays free, rounded up, so that every probe meets
+        //an empty slot and the load never passes max_load_factor()
+        static size_type capacity_to_growth(size_type cap) {
+            return (cap - (cap + 7) / 8);
+        }
+
+        static size_type growth_to_capacity(size_type n) {
+            size_type cap = flat_group::width - 1;
+            while (capacity_to_growth(cap) < n)
+                cap = cap * 2 + 1;
+            return (cap);
+        }
+
+        const key_type &get_key(const value_type &val) const {
+            return (traits::ExtractKey(val));
+        }
+
+        //spreads the hash over every bit, the top bits pick the first
+        //group and the low 7 go to the control byte
+        size_t hash_of(const key_type &k) const { return (hash_mix(hash(k))); }
+
+        static size_t h1(size_t h) { return (h >> 7); }
+
+        static flat_ctrl_type h2(size_t h) { return ((flat_ctrl_type) (h & 0x7f)); }
+
+        iterator iterator_at(size_type i) { return (iterator(ctrl + i, slots + i)); }
+
+        //the first width - 1 control bytes are mirrored after the sentinel
+        //so that a group loaded near the end reads the start of the table
+        void set_ctrl(size_type i, flat_ctrl_type c) {
+            ctrl[i] = c;
+            ctrl[((i - (flat_group::width - 1)) & capacity) + (flat_group::width - 1)] = c;
+        }
+
+        void reset_ctrl() {
+            memset(ctrl, flat_ctrl_empty, capacity + flat_group::width);
+            ctrl[capacity] = flat_ctrl_sentinel;
+        }
+
+        //groups are probed at triangular offsets, which visits every group
+        //of a power of two sized table
+        size_type find_index(const key_type &k, size_t h) const {
+            size_type offset = h1(h) & capacity;
+            for (size_type step = 0;; step += flat_group::width) {
+                flat_group g(ctrl + offset);
+                for (flat_group::mask_type mask = g.match(h2(h)); mask; mask &= mask - 1) {
+                    size_type i = (offset + _flat_lowest(mask)) & capacity;
+                    if (equals(get_key(slots[i]), k))
+                        return (i);
+                }
+                if (g.match_empty())
+                    return (npos);
+                offset = (offset + step + flat_group::width) & capacity;
+            }
+        }
+
+        size_type find_first_non_full(size_t h) const {
+            size_type offset = h1(h) & capacity;
+            for (size_type step = 0;; step += flat_group::width) {
+                flat_group::mask_type mask = flat_group(ctrl + offset).match_empty_or_deleted();
+                if (mask)
+                    return ((offset + _flat_lowest(mask)) & capacity);
+                offset = (offset + step + flat_group::width) & capacity;
+            }
+        }
+
+        //the index of k, or of a claimed slot the caller must construct
+        std::pair<size_type, bool> find_or_prepare_insert(const key_type &k) {
+            size_t h = hash_of(k);
+            size_type i = find_index(k, h);
+            if (i != npos)
+                return (std::pair<size_type, bool>(i, false));
+            i = find_first_non_full(h);
+            if (!growth_left && ctrl[i] != flat_ctrl_deleted) {
+                grow();
+                i = find_first_non_full(h);
+            }
+            if (ctrl[i] == flat_ctrl_empty)
+                --growth_left;
+            set_ctrl(i, h2(h));
+            ++num_elements;
+            return (std::pair<size_type, bool>(i, true));
+        }
+
+        template<typename value_type>
+        void construct_at(size_type i, value_type &&val) {
+            try {
+                slot_alloc::construct(slots + i, std::forward<value_type>(val));
+            } catch (...) {
+                set_ctrl(i, flat_ctrl_deleted);
+                --num_elements;
+                throw;
+            }
+        }
+
+        //a slot goes back to empty only if no group wide window around it
+        //was ever full, otherwise a probe may have passed it and it must
+        //stay a tombstone
+        void erase_at(size_type i) {
+            slot_alloc::destroy(slots + i);
+            --num_elements;
+            size_type before = (i - flat_group::width) & capacity;
+            flat_group::mask_type empty_after = flat_group(ctrl + i).match_empty();
+            flat_group::mask_type empty_before = flat_group(ctrl + before).match_empty();
+            bool never_full = empty_before && empty_after &&
+                              _flat_lowest(empty_after) + _flat_leading(empty_before) < size_type(flat_group::width);
+            set_ctrl(i, never_full ? flat_ctrl_empty : flat_ctrl_deleted);
+            if (never_full)
+                ++growth_left;
+        }
+
+        //a table mostly full of tombstones is rebuilt at the same size
+        void grow() {
+            if (capacity > flat_group::width && num_elements * 32 <= capacity * 25)
+                resize(capacity);
+            else
+                resize(capacity ? capacity * 2 + 1 : flat_group::width - 1);
+        }
+
+        void resize(size_type new_capacity) {
+            flat_ctrl_type *old_ctrl = ctrl;
+            value_type *old_slots = slots;
+            size_type old_capacity = capacity;
+            ctrl = ctrl_alloc::allocate(new_capacity + flat_group::width);
+            try {
+                slots = slot_alloc::allocate(new_capacity);
+            } catch (...) {
+                ctrl_alloc::deallocate(ctrl, new_capacity + flat_group::width);
+                ctrl = old_ctrl;
+                throw;
+            }
+            capacity = new_capacity;
+            reset_ctrl();
+            for (size_type i = 0; i != old_capacity; ++i) {
+                if (is_full(old_ctrl[i])) {
+                    size_t h = hash_of(get_key(old_slots[i]));
+                    size_type j = find_first_non_full(h);
+                    set_ctrl(j, h2(h));
+                    slot_alloc::construct(slots + j, std::move(old_slots[i]));
+                    slot_alloc::destroy(old_slots + i);
+                }
+            }
+            growth_left = capacity_to_growth(capacity) - num_elements;
+            if (old_capacity) {
+                ctrl_alloc::deallocate(old_ctrl, old_capacity + flat_group::width);
+                slot_alloc::deallocate(old_slots, old_capacity);
+            }
+        }
+
+        void destroy_table() {
+            if (capacity) {
+                for (size_type i = 0; i != capacity; ++i)
+                    if (is_full(ctrl[i]))
+                        slot_alloc::destroy(slots + i);
+                ctrl_alloc::deallocate(ctrl, capacity + flat_group::width);
+                slot_alloc::deallocate(slots, capacity);
+            }
+            num_elements = 0;
+        }
+
+    private:
+        flat_ctrl_type *ctrl;
+        value_type *slots;
+        size_type capacity;
+        size_type num_elements;
+        size_type growth_left;
+        hasher hash;
+        key_equal equals;
+    };
+
+    template<typename traits>
+    inline void swap(flat_hash_table<traits> &left, flat_hash_table<traits> &right) noexcept {
+        left.swap(right);
+    }
+
+    template<typename traits>
+    inline bool _flat_element_equal(const flat_hash_table<traits> &left,
+                                    const flat_hash_table<traits> &right, true_type) {
+        for (auto first = left.cbegin(), last = left.cend(); first != last; ++first)
+            if (!right.count(traits::ExtractKey(*first)))
+                return (false);
+        return (true);
+    }
+
+    template<typename traits>
+    inline bool _flat_element_equal(const flat_hash_table<traits> &left,
+                                    const flat_hash_table<traits> &right, false_type) {
+        auto last2 = right.cend();
+        for (auto first = left.cbegin(), last = left.cend(); first != last; ++first) {
+            auto ret = right.find(traits::ExtractKey(*first));
+            if (ret == last2 || (!(traits::ExtractData(*ret) == traits::ExtractData(*first))))
+                return (false);
+        }
+        return (true);
+    }
+
+    template<typename traits>
+    inline bool operator==(const flat_hash_table<traits> &left, const flat_hash_table<traits> &right) {
+        return (left.size() == right.size() &&
+                _flat_element_equal(left, right,
+                                    is_same<typename traits::key_type, typename traits::value_type>()));
+    }
+
+    template<typename traits>
+    inline bool operator!=(const flat_hash_table<traits> &left, const flat_hash_table<traits> &right) {
+        return (!(left == right));
+    }
+}
+
+#endif //_FLAT_HASH_TABLE_
@@ -2,26 +2,64 @@
 #ifndef _HASH_TABLE_
 #define _HASH_TABLE_
 
+#include <cmath>
+#include <cstdint>
 #include <utility>
 #include "algorithm_qmj.h"
 #include "hashfunction.h"
+#include "node_handle_qmj.h"
 #include "type_traits_qmj.h"
 #include "vector_qmj.h"
 
 
 namespace qmj {
-    template<typename value_type>
-    struct hashtable_node {
+    template<bool cache_hash>
+    struct hashtable_hash_code {
+    };
+
+    template<>
+    struct hashtable_hash_code<true> {
+        size_t hash_code;
+    };
+
+    //with cache_hash a node keeps the hash code of its key, so rehashing
+    //and iteration never call the hasher and lookups compare the codes
+    //before calling equals
+    template<typename value_type, bool cache_hash = false>
+    struct hashtable_node : hashtable_hash_code<cache_hash> {
     public:
-        typedef hashtable_node<value_type> *link_type;
+        typedef hashtable_node<value_type, cache_hash> *link_type;
 
-        hashtable_node(link_type next = nullptr) : value(), next(next) {}
+        hashtable_node(link_type next = nullptr) : value(), next(next), prev(nullptr) {}
 
         hashtable_node(const value_type &value, link_type next = nullptr)
-                : value(value), next(next) {}
+                : value(value), next(next), prev(nullptr) {}
 
         value_type value;
         link_type next;
+        link_type prev;
+    };
+
+    //traits choose with an enum cache_hash, by default the codes are kept
+    //for keys that are not pod, whose hash is likely to be expensive
+    template<typename traits, typename = void>
+    struct hashtable_cache_hash : bool_type<!is_pod<typename traits::key_type>::value> {
+    };
+
+    template<typename traits>
+    struct hashtable_cache_hash<traits, void_t<decltype(traits::cache_hash)>>
+            : bool_type<traits::cache_hash> {
+    };
+
+    //heterogeneous lookup needs both the hasher and key_equal to opt in
+    template<typename Hash, typename Equal>
+    struct hashtable_transparent
+            : bool_type<is_transparent<Hash>::value && is_transparent<Equal>::value> {
+    };
+
+    template<typename traits>
+    struct hashtable_node_of {
+        typedef hashtable_node<typename traits::value_type, hashtable_cache_hash<traits>::value> type;
     };
 
     template<typename traits>
@@ -41,7 +79,7 @@ namespace qmj {
         typedef size_t size_type;
         typedef hashtable_const_iterator<traits> self;
         typedef const hashtable<traits> *hashtable_link;
-        typedef hashtable_node<value_type> *link_type;
+        typedef typename hashtable_node_of<traits>::type *link_type;
 
         hashtable_const_iterator(link_type cur = nullptr, hashtable_link ht = nullptr)
                 : cur(cur), ht(ht) {}
@@ -63,13 +101,7 @@ namespace qmj {
         pointer operator->() const { return (&(operator*())); }
 
         self &operator++() {
-            const link_type old = cur;
             cur = cur->next;
-            if (cur == nullptr) {
-                size_type index = ht->get_bucket_num(ht->get_key(old->value));
-                for (size_t n = ht->buckets.size(); !cur && ++index != n;)
-                    cur = ht->buckets[index];
-            }
             return (*this);
         }
 
@@ -98,7 +130,7 @@ namespace qmj {
         typedef size_t size_type;
         typedef hashtable_iterator<traits> self;
         typedef const hashtable<traits> *hashtable_link;
-        typedef hashtable_node<value_type> *link_type;
+        typedef typename hashtable_node_of<traits>::type *link_type;
 
         hashtable_iterator(const link_type cur = nullptr, const hashtable_link ht = nullptr)
                 : base_type(cur, ht) {}
@@ -108,6 +140,7 @@ namespace qmj {
         self &operator=(const self &x) {
             this->cur = x.cur;
             this->ht = x.ht;
+            return (*this);
         }
 
         bool operator==(const self &it) const { return (this->cur == it.cur); }
@@ -119,13 +152,7 @@ namespace qmj {
         pointer operator->() const { return (&(operator*())); }
 
         self &operator++() {
-            const link_type old = this->cur;
             this->cur = this->cur->next;
-            if (!this->cur) {
-                size_type index = this->ht->get_bucket_num(this->ht->get_key(old->value));
-                for (size_t n = this->ht->buckets.size(); !(this->cur) && ++index != n;)
-                    this->cur = this->ht->buckets[index];
-            }
             return (*this);
         }
 
@@ -149,11 +176,22 @@ namespace qmj {
 
         typedef size_t size_type;
         typedef hashtable_const_local_iterator<traits> self;
-        typedef hashtable_node<value_type> *link_type;
+        typedef typename hashtable_node_of<traits>::type *link_type;
+
+        hashtable_const_local_iterator(link_type cur = nullptr, link_type last = nullptr)
+                : cur(cur), last(last), ht(nullptr), bucket(0), old_idx(0) {}
 
-        hashtable_const_local_iterator(link_type cur = nullptr) : cur(cur) {}
+        hashtable_const_local_iterator(const self &x)
+                : cur(x.cur), last(x.last), ht(x.ht), bucket(x.bucket), old_idx(x.old_idx) {}
 
-        hashtable_const_local_iterator(const self &x) : cur(x.cur) {}
+        self &operator=(const self &x) {
+            cur = x.cur;
+            last = x.last;
+            ht = x.ht;
+            bucket = x.bucket;
+            old_idx = x.old_idx;
+            return (*this);
+        }
 
         bool operator==(const self &it) const { return (cur == it.cur); }
 
@@ -163,8 +201,12 @@ namespace qmj {
 
         pointer operator->() const { return (&(operator*())); }
 
+        //the nodes of a bucket are a run of the table's list ending at last
         self &operator++() {
-            cur = cur->next;
+            if (ht)
+                ht->local_next(*this);
+            else
+                cur = (cur == last ? nullptr : cur->next);
             return (*this);
         }
 
@@ -175,7 +217,16 @@ namespace qmj {
         }
 
     protected:
+        //set while the table migrates, see hashtable::local_next
+        hashtable_const_local_iterator(link_type cur, link_type last, const hashtable<traits> *ht,
+                                       size_type bucket, size_type old_idx)
+                : cur(cur), last(last), ht(ht), bucket(bucket), old_idx(old_idx) {}
+
         link_type cur;
+        link_type last;
+        const hashtable<traits> *ht;
+        size_type bucket;
+        size_type old_idx;
     };
 
     template<typename traits>
@@ -192,12 +243,18 @@ namespace qmj {
         typedef size_t size_type;
         typedef hashtable_const_local_iterator<traits> base_type;
         typedef hashtable_local_iterator<traits> self;
-        typedef hashtable_node<value_type> *link_type;
+        typedef typename hashtable_node_of<traits>::type *link_type;
 
-        hashtable_local_iterator(link_type cur = nullptr) : base_type(cur) {}
+        hashtable_local_iterator(link_type cur = nullptr, link_type last = nullptr)
+                : base_type(cur, last) {}
 
         hashtable_local_iterator(const self &x) : base_type(x) {}
 
+        self &operator=(const self &x) {
+            base_type::operator=(x);
+            return (*this);
+        }
+
         bool operator==(const self &it) const { return (this->cur == it.cur); }
 
         bool operator!=(const self &it) const { return (!(operator==(it))); }
@@ -207,7 +264,7 @@ namespace qmj {
         pointer operator->() const { return (&(operator*())); }
 
         self &operator++() {
-            this->cur = this->cur->next;
+            base_type::operator++();
             return (*this);
         }
 
@@ -234,6 +291,58 @@ namespace qmj {
         return pos == last ? *(last - 1) : *pos;
     }
 
+    //a bucket policy picks the bucket counts of a hashtable and maps a hash
+    //code onto one of them; traits select one with a bucket_policy typedef
+    struct prime_bucket_policy {
+        static size_t bucket_count(size_t n) { return (next_prime(n)); }
+
+        static size_t index(size_t h, size_t n) { return (h % n); }
+    };
+
+    //power of two counts, the mixed hash is masked instead of divided
+    struct power2_bucket_policy {
+        static size_t bucket_count(size_t n) {
+            size_t count = 8;
+            while (count < n)
+                count <<= 1;
+            return (count);
+        }
+
+        static size_t index(size_t h, size_t n) { return (hash_mix(h) & (n - 1)); }
+    };
+
+    //lemire's multiply-shift, the high word of h * n maps the full hash
+    //onto [0, n) with no division, so any count works and the table may
+    //grow by half steps between powers of two. it ranks buckets by the top
+    //bits of h, which qmj::hash already avalanches; an identity hasher
+    //wants power2_bucket_policy's mix instead
+    struct fastrange_bucket_policy {
+        static size_t bucket_count(size_t n) {
+            size_t count = 8;
+            while (count < n)
+                count <<= 1;
+            return (count / 4 * 3 >= n ? count / 4 * 3 : count);
+        }
+
+        static size_t index(size_t h, size_t n) {
+            if (sizeof(size_t) == 4)
+                return ((size_t) (((std::uint64_t) h * n) >> 32));
+            std::uint64_t lo = h, hi = n;
+            _hash_mum(lo, hi);
+            return ((size_t) hi);
+        }
+    };
+
+    template<typename traits, typename = void>
+    struct hashtable_bucket_policy {
+        typedef prime_bucket_policy type;
+    };
+
+    template<typename traits>
+    struct hashtable_bucket_policy<traits, void_t<typename traits::bucket_policy>> {
+        typedef typename traits::bucket_policy type;
+    };
+
     template<typename traits>
     class hashtable {
     public:
@@ -241,6 +350,8 @@ namespace qmj {
 
         friend class hashtable_iterator<traits>;
 
+        friend class hashtable_const_local_iterator<traits>;
+
         typedef typename traits::allocator_type allocator_type;
         //typedef typename traits::HashFunction hashfunction;
         typedef typename traits::HashFunction hasher;
@@ -248,6 +359,7 @@ namespace qmj {
         typedef typename traits::EqualKey key_equal;
         typedef typename traits::key_type key_type;
         typedef typename traits::value_type value_type;
+        typedef typename hashtable_bucket_policy<traits>::type bucket_policy;
         typedef value_type *pointer;
         typedef const value_type *const_pointer;
         typedef value_type &reference;
@@ -255,7 +367,8 @@ namespace qmj {
         typedef size_t size_type;
         typedef std::ptrdiff_t difference_type;
 
-        typedef typename allocator_type::template rebind<hashtable_node<value_type>>::other alloc;
+        typedef typename hashtable_node_of<traits>::type node_type;
+        typedef typename allocator_type::template rebind<node_type>::other alloc;
         typedef hashtable_const_iterator<traits> const_iterator;
         typedef hashtable_const_local_iterator<traits> const_local_iterator;
         typedef typename If<is_same<key_type, value_type>::value, const_iterator,
@@ -263,84 +376,126 @@ namespace qmj {
         typedef typename If<is_same<key_type, value_type>::value, const_local_iterator,
                 hashtable_local_iterator<traits>>::type local_iterator;
         enum {
-            is_multi = traits::is_multi
+            is_multi = traits::is_multi,
+            cache_hash = hashtable_cache_hash<traits>::value
         };
 
-        typedef hashtable_node<value_type> *link_type;
+        typedef typename hashtable_node_of<traits>::type *link_type;
         typedef hashtable<traits> self;
-        typedef qmj::vector<link_type> container;
+        //all nodes form one doubly linked list starting at head, and the
+        //nodes of a bucket are a run of it from first to last; iteration
+        //walks the list, lookups walk the run of one bucket
+        struct bucket_type {
+            link_type first;
+            link_type last;
+        };
+        typedef qmj::vector<bucket_type, typename allocator_type::template rebind<bucket_type>::other> container;
 
         typedef std::pair<iterator, bool> PairIB;
         typedef std::pair<local_iterator, local_iterator> PairII;
         typedef std::pair<const_local_iterator, const_local_iterator> PairCC;
         typedef std::pair<link_type, link_type> PairLL;
+        typedef node_handle<node_type, key_type, value_type, allocator_type> node_handle_type;
+        typedef node_insert_return<iterator, node_handle_type> insert_return_type;
 
-        hashtable() : hash(), equals(), num_elements(0) { init_buckets(0); }
+        template<typename>
+        friend
+        class hashtable;
 
-        explicit hashtable(size_t n) : hash(), equals(), num_elements(0) {
+        hashtable()
+                : hash(), equals(), head(nullptr), num_elements(0), rehash_idx(0), incremental(false),
+                  max_load(1.0f) {
+            init_buckets(0);
+        }
+
+        explicit hashtable(size_t n) : hash(), equals(), head(nullptr), num_elements(0),
+                  rehash_idx(0), incremental(false), max_load(1.0f) {
             init_buckets(n);
         }
 
         hashtable(size_t n, const hasher &hash)
-                : hash(hash), equals(), num_elements(0) {
+                : hash(hash), equals(), head(nullptr), num_elements(0),
+                  rehash_idx(0), incremental(false), max_load(1.0f) {
             init_buckets(n);
         }
 
         hashtable(const hasher &hash, const equalkey &equals)
-                : hash(hash), equals(equals), num_elements(0) {
+                : hash(hash), equals(equals), head(nullptr), num_elements(0),
+                  rehash_idx(0), incremental(false), max_load(1.0f) {
             init_buckets(0);
         }
 
         hashtable(const size_t n, const hasher &hash, const equalkey &equals)
-                : hash(hash), equals(equals), num_elements(0) {
+                : hash(hash), equals(equals), head(nullptr), num_elements(0),
+                  rehash_idx(0), incremental(false), max_load(1.0f) {
             init_buckets(n);
         }
 
         hashtable(const self &x)
-                : buckets(x.buckets.size(), nullptr), hash(x.hash),
-                  equals(x.equals), num_elements(x.num_elements) {
-            for (size_t i = 0; i != buckets.size(); ++i)
-                for (link_type cur = x.buckets[i]; cur; cur = cur->next)
-                    buckets[i] = create_node(cur->value, buckets[i]);
+                : hash(x.hash), equals(x.equals), buckets(x.bucket_count(), bucket_type()),
+                  head(nullptr), num_elements(0), rehash_idx(0),
+                  incremental(x.incremental), max_load(x.max_load) {
+            update_grow_limit();
+            copy_nodes(x);
         }
 
         hashtable(self &&x)
-                : num_elements(x.num_elements), hash(std::move(x.hash)),
-                  equals(std::move(x.equals)), buckets(std::move(x.buckets)) {}
+                : hash(std::move(x.hash)), equals(std::move(x.equals)), buckets(std::move(x.buckets)),
+                  head(x.head), num_elements(x.num_elements),
+                  rehash_buckets(std::move(x.rehash_buckets)), rehash_idx(x.rehash_idx),
+                  incremental(x.incremental), max_load(x.max_load), grow_limit(x.grow_limit) {
+            x.head = nullptr;
+            x.num_elements = 0;
+            x.rehash_idx = 0;
+        }
 
         self &operator=(self x) {
-            hash = x.hash;
-            equals = x.equals;
-            num_elements = x.num_elements;
-            buckets.swap(x.buckets);
+            swap(x);
             return (*this);
         }
 
         ~hashtable() { clear(); }
 
         void swap(self &x) noexcept {
-            swap(hash, x.hash);
-            swap(equals, x.equals);
+            std::swap(hash, x.hash);
+            std::swap(equals, x.equals);
             std::swap(num_elements, x.num_elements);
+            std::swap(head, x.head);
             buckets.swap(x.buckets);
+            rehash_buckets.swap(x.rehash_buckets);
+            std::swap(rehash_idx, x.rehash_idx);
+            std::swap(incremental, x.incremental);
+            std::swap(max_load, x.max_load);
+            std::swap(grow_limit, x.grow_limit);
         }
 
-        iterator begin() {
-            if (empty())
-                return (end());
-            size_t i = 0;
-            for (const size_t len = buckets.size(); i != len && (!buckets[i]);)
-                ++i;
-            return (iterator(buckets[i], this));
+        //in incremental mode growing allocates the larger bucket array but
+        //moves only rehash_batch old buckets into it per insertion, instead
+        //of relinking every node at once. a lookup goes to the new table if
+        //the key's old bucket was moved already, else to the old one
+        void incremental_rehash(const bool on) {
+            if (!on)
+                finish_rehash();
+            incremental = on;
         }
 
+        bool incremental_rehash() const noexcept { return (incremental); }
+
+        bool rehashing() const noexcept { return (!rehash_buckets.empty()); }
+
+        iterator begin() { return (iterator(head, this)); }
+
+        //the bucket interface numbers the buckets of the new table. the
+        //mutable begin finishes a pending incremental rehash, the const
+        //queries read both tables like find instead
         local_iterator begin(size_type index) {
-            return (local_iterator(buckets[index]));
+            finish_rehash();
+            return (local_iterator(buckets[index].first, buckets[index].last));
         }
 
         iterator end() { return (iterator(nullptr, this)); }
 
-        local_iterator end(size_type index) { return (iterator(nullptr)); }
+        local_iterator end(size_type index) { return (local_iterator()); }
 
         const_iterator begin() const { return (cbegin()); }
 
@@ -350,24 +505,22 @@ namespace qmj {
 
         const_local_iterator end(size_type index) const { return (cend(index)); }
 
-        const_iterator cbegin() const {
-            if (empty())
-                return (cend());
-            size_t i = 0;
-            for (const size_t len = buckets.size(); i != len && (!buckets[i]);)
-                ++i;
-            return (const_iterator(buckets[i], this));
-        }
+        const_iterator cbegin() const { return (const_iterator(head, this)); }
 
         const_local_iterator cbegin(size_type index) const {
-            return (const_local_iterator(buckets[index]));
+            if (!rehashing())
+                return (const_local_iterator(buckets[index].first, buckets[index].last));
+            const_local_iterator iter(rehash_buckets[index].first, rehash_buckets[index].last,
+                                      this, index, buckets.size());
+            if (!iter.cur)
+                local_next(iter);
+            return (iter);
         }
 
         const_iterator cend() const { return (const_iterator(nullptr, this)); }
 
-        const_local_iterator cend(size_type index) const {
-            return (const_local_iterator(nullptr));
-        }
+        //every bucket run ends on a null node
+        const_local_iterator cend(size_type) const { return (const_local_iterator()); }
 
         size_type size() const { return (num_elements); }
 
@@ -377,44 +530,36 @@ namespace qmj {
             return ((float) size() / (float) bucket_count());
         }
 
+        float max_load_factor() const noexcept { return (max_load); }
+
+        //the table grows once size() would exceed bucket_count() * z; a
+        //lower z trades memory for shorter chains. raising the bound never
+        //shrinks the table, rehash(0) or shrink_to_fit() does. z is clamped
+        //to [min_max_load, max_max_load], NaN to the minimum, so the bucket
+        //counts derived from it stay finite
+        void max_load_factor(const float z) {
+            max_load = z > min_max_load ? (z < max_max_load ? z : max_max_load) : min_max_load;
+            update_grow_limit();
+            if (num_elements > grow_limit)
+                rehash(bucket_count());
+        }
+
         size_type erase(const key_type &k) {
-            size_t n = get_bucket_num(k);
-            link_type cur = buckets[n];
+            const size_t h = hash(k);
+            bucket_type &b = bucket_of(h);
             size_type count = 0;
-            for (link_type tmp = cur; cur && equals(get_key(cur->value), k); tmp = cur) {
-                --num_elements;
-                cur = cur->next;
+            for (link_type tar = find_imple(k, h), next; tar && node_equals(tar, k, h); tar = next) {
+                next = bucket_next(tar, b);
+                unlink_node(b, tar);
+                destroy_and_free_node(tar);
                 ++count;
-                destroy_and_free_node(tmp);
-            }
-            buckets[n] = cur;
-            if (cur) {
-                for (link_type next = cur->next; next; next = cur->next) {
-                    if (equals(get_key(next->value), k)) {
-                        ++count;
-                        --num_elements;
-                        cur->next = next->next;
-                        destroy_and_free_node(next);
-                    } else {
-                        cur = next;
-                    }
-                }
             }
             return (count);
         }
 
         void erase(const_iterator x) {
-            size_t n = get_bucket_num(get_key(*x));
-            link_type cur = buckets[n];
             link_type tar = x.cur;
-            if (cur == tar)
-                buckets[n] = x.cur->next;
-            else {
-                for (; cur->next != tar;)
-                    cur = cur->next;
-                cur->next = tar->next;
-            }
-            --num_elements;
+            unlink_node(tar);
             destroy_and_free_node(tar);
         }
 
@@ -424,28 +569,43 @@ namespace qmj {
         }
 
         void clear() {
-            const size_t len = buckets.size();
-            for (size_t i = 0; i != len; ++i) {
-                for (link_type cur = buckets[i], next; cur; cur = next) {
-                    next = cur->next;
-                    destroy_and_free_node(cur);
-                }
+            for (link_type cur = head, next; cur; cur = next) {
+                next = cur->next;
+                destroy_and_free_node(cur);
+            }
+            if (rehashing()) {
+                buckets.swap(rehash_buckets);
+                container().swap(rehash_buckets);
+                rehash_idx = 0;
             }
-            memset(&buckets[0], 0, len);
+            if (const size_t len = buckets.size())
+                memset(&buckets[0], 0, len * sizeof(bucket_type));
+            head = nullptr;
             num_elements = 0;
         }
 
-        size_type bucket(const key_type &k) const { return (get_bucket_num(k)); }
+        size_type bucket(const key_type &k) const {
+            return (get_bucket_num(k));
+        }
+
+        size_type count(const key_type &k) const { return (count_imple(k)); }
 
-        size_type count(const key_type &k) const {
-            size_type counter = 0;
-            size_t n = get_bucket_num(k);
-            for (link_type cur = buckets[n]; cur; cur = cur->next)
-                if (equals(get_key(cur->value), k))
-                    ++counter;
+        //with a transparent hasher and key_equal, find, count and
+        //equal_range take any key type the two accept
+        template<typename K, typename H = hasher, enable_if_t<hashtable_transparent<H, key_equal>::value, int> = 0>
+        size_type count(const K &k) const { return (count_imple(k)); }
 
-            return (counter);
-        }
+        template<typename K, typename H = hasher, enable_if_t<hashtable_transparent<H, key_equal>::value, int> = 0>
+        const_iterator find(const K &k) const { return (const_iterator(find_imple(k), this)); }
+
+        template<typename K, typename H = hasher, enable_if_t<hashtable_transparent<H, key_equal>::value, int> = 0>
+        iterator find(const K &k) { return (iterator(find_imple(k), this)); }
+
+        template<typename K, typename H = hasher, enable_if_t<hashtable_transparent<H, key_equal>::value, int> = 0>
+        PairII equal_range(const K &key) { return (equal_range_local<PairII>(key)); }
+
+        template<typename K, typename H = hasher, enable_if_t<hashtable_transparent<H, key_equal>::value, int> = 0>
+        PairCC equal_range(const K &key) const { return (equal_range_local<PairCC>(key)); }
 
         const_iterator find(const key_type &k) const {
             return (const_iterator(find_imple(k), this));
@@ -453,10 +613,59 @@ namespace qmj {
 
         iterator find(const key_type &k) { return (iterator(find_imple(k), this)); }
 
-        size_type bucket_count() const { return (buckets.size()); }
+        //keys in [first,last) are looked up batch_width at a time: the whole
+        //group is hashed and its buckets prefetched, then the first node of
+        //each bucket, so the misses of different keys overlap before any
+        //chain is walked. one iterator per key is written to dest
+        template<typename FIter, typename OIter>
+        OIter find_batch(FIter first, FIter last, OIter dest) const {
+            return (find_batch_imple<const_iterator>(first, last, dest));
+        }
+
+        template<typename FIter, typename OIter>
+        OIter find_batch(FIter first, FIter last, OIter dest) {
+            return (find_batch_imple<iterator>(first, last, dest));
+        }
+
+        //inserts the values in [first,last) like insert(first, last), with
+        //the table grown once per group and the same hash and prefetch
+        //stages as find_batch ahead of linking. the group holds iterators
+        //and reads each element twice, to hash it and to link it, so an
+        //element of another type is converted to value_type each time
+        template<typename FIter>
+        void insert_batch(FIter first, FIter last) {
+            FIter vals[batch_width];
+            size_t codes[batch_width];
+            while (first != last) {
+                size_type n = 0;
+                for (; n != batch_width && first != last; ++n, ++first)
+                    vals[n] = first;
+                resize(num_elements + n);
+                if (rehashing())
+                    rehash_step(rehash_batch * (n - 1));
+                for (size_type i = 0; i != n; ++i) {
+                    codes[i] = hash(get_key(*vals[i]));
+                    _QMJ_PREFETCH(&bucket_of(codes[i]));
+                }
+                for (size_type i = 0; i != n; ++i)
+                    if (link_type cur = bucket_of(codes[i]).first)
+                        _QMJ_PREFETCH(cur);
+                for (size_type i = 0; i != n; ++i)
+                    insert_hashed(*vals[i], codes[i]);
+            }
+        }
+
+        size_type bucket_count() const {
+            return (rehashing() ? rehash_buckets.size() : buckets.size());
+        }
 
         size_type bucket_size(const size_type n) const {
-            return (elements_in_bucket(n));
+            if (!rehashing())
+                return (elements_in_bucket(n));
+            size_type counter = 0;
+            for (const_local_iterator iter = cbegin(n); iter.cur; ++iter)
+                ++counter;
+            return (counter);
         }
 
         size_type max_size() const { return (prime_list[num_primes - 1]); }
@@ -551,20 +760,89 @@ namespace qmj {
             insert(lst.begin(), lst.end());
         }
 
-        void rehash(const size_type new_n) { resize(new_n); }
+        //extract unlinks a node and hands it over with its value in place,
+        //insert(node_handle_type &&) links such a node without allocating
+        node_handle_type extract(const_iterator x) {
+            link_type tar = x.cur;
+            unlink_node(tar);
+            return (node_handle_type(tar));
+        }
 
-        void reserve(const size_type new_n) { resize(new_n); }
+        node_handle_type extract(const key_type &k) {
+            link_type tar = find_imple(k);
+            if (!tar)
+                return (node_handle_type());
+            unlink_node(tar);
+            return (node_handle_type(tar));
+        }
 
-        PairII equal_range(const key_type &key) {
-            PairLL ret = equal_range_imple(key);
-            return (PairII(local_iterator(ret.first), local_iterator(ret.second)));
+        template<bool multi = is_multi, enable_if_t<!multi, int> = 0>
+        insert_return_type insert(node_handle_type &&nh) {
+            if (nh.empty())
+                return {end(), false, node_handle_type()};
+            const size_t h = hash(get_key(nh.node->value));
+            link_type cur = find_imple(get_key(nh.node->value), h);
+            if (cur)
+                return {iterator(cur, this), false, std::move(nh)};
+            resize(num_elements + 1);
+            set_hash_code(nh.node, h);
+            return {link_node(nh.release()), true, node_handle_type()};
         }
 
-        PairCC equal_range(const key_type &key) const {
-            PairLL ret = equal_range_imple(key);
-            return (PairCC(const_local_iterator(ret.first), const_local_iterator(ret.second)));
+        template<bool multi = is_multi, enable_if_t<multi, int> = 0>
+        iterator insert(node_handle_type &&nh) {
+            if (nh.empty())
+                return (end());
+            resize(num_elements + 1);
+            set_hash_code(nh.node, hash(get_key(nh.node->value)));
+            return (link_node(nh.release()));
+        }
+
+        //moves every node of source whose key is not in *this yet, or every
+        //node if *this allows equal keys; the nodes are relinked, not copied.
+        //the hash codes are recomputed since source may hash differently
+        template<typename traits2>
+        void merge(hashtable<traits2> &source) {
+            static_assert(is_same<alloc, typename hashtable<traits2>::alloc>::value,
+                          "merge needs the same node and allocator type");
+            if ((void *) this == (void *) &source)
+                return;
+            for (link_type cur = source.head, next; cur; cur = next) {
+                next = cur->next;
+                const size_t h = hash(get_key(cur->value));
+                if (is_multi || !find_imple(get_key(cur->value), h)) {
+                    source.unlink_node(cur);
+                    resize(num_elements + 1);
+                    set_hash_code(cur, h);
+                    link_node(cur);
+                }
+            }
+        }
+
+        template<typename traits2>
+        void merge(hashtable<traits2> &&source) { merge(source); }
+
+        //at least new_n buckets and enough for size() under the max load
+        //factor, so unlike growth on insertion this can shrink the table.
+        //it is carried out at once, also in incremental mode
+        void rehash(const size_type new_n) {
+            finish_rehash();
+            const size_type need = buckets_for(num_elements);
+            const size_type n = bucket_policy::bucket_count(new_n > need ? new_n : need);
+            if (n != buckets.size())
+                rehash_imple(n);
         }
 
+        void reserve(const size_type new_n) { rehash(buckets_for(new_n)); }
+
+        //erase and clear keep the buckets, a table that spiked and drained
+        //gives the memory back through this
+        void shrink_to_fit() { rehash(0); }
+
+        PairII equal_range(const key_type &key) { return (equal_range_local<PairII>(key)); }
+
+        PairCC equal_range(const key_type &key) const { return (equal_range_local<PairCC>(key)); }
+
         allocator_type get_allocator() const { return (allocator_type()); }
 
         hasher hash_fuction() const { return (hash); }
@@ -572,33 +850,138 @@ namespace qmj {
         equalkey key_eq() const { return (equals); }
 
     private:
-        void splice_afer(link_type first1, link_type first2) const {
-            link_type tar = first2->next;
-            first2->next = tar->next;
-            tar->next = first1->next;
-            first1->next = tar;
+        template<typename K>
+        size_type count_imple(const K &k) const {
+            size_type counter = 0;
+            const size_t h = hash(k);
+            for (link_type cur = find_imple(k, h); cur && node_equals(cur, k, h); cur = cur->next)
+                ++counter;
+            return (counter);
+        }
+
+        template<typename Pair, typename K>
+        Pair equal_range_local(const K &key) const {
+            typedef typename Pair::first_type local_iter;
+            link_type last;
+            PairLL ret = equal_range_imple(key, last);
+            return (Pair(local_iter(ret.first, last), local_iter(ret.second, last)));
         }
 
-        PairLL equal_range_imple(const key_type &key) const {
-            link_type first = find_imple(key);
+        //equal keys are kept adjacent, so the range is a run of the list
+        template<typename K>
+        PairLL equal_range_imple(const K &key, link_type &last) const {
+            const size_t h = hash(key);
+            const bucket_type &b = bucket_of(h);
+            last = b.last;
+            link_type first = find_imple(key, h);
             if (!first)
                 return (PairLL(nullptr, nullptr));
             link_type cur = first;
-            link_type next = cur->next;
-            for (; next && equals(key, get_key(next->value)); next = cur->next)
-                cur = next;
-            if (next) {
-                link_type before = next;
-                for (next = before->next; next; next = before->next) {
-                    if (equals(key, get_key(next->value))) {
-                        splice_afer(cur, before);
-                        cur = cur->next;
-                    } else {
-                        before = next;
-                    }
+            for (; cur->next && node_equals(cur->next, key, h);)
+                cur = cur->next;
+            return (PairLL(first, bucket_next(cur, b)));
+        }
+
+        //same bucket count and hash codes, so appending x's list in order
+        //keeps every bucket a run; during a rehash of x that holds only
+        //for the nodes x has moved, so the others are linked one by one
+        void copy_nodes(const self &x) {
+            link_type tail = nullptr;
+            for (link_type cur = x.head; cur; cur = cur->next) {
+                link_type node = create_node(cur->value);
+                set_hash_code(node, x.node_hash(cur));
+                if (x.rehashing()) {
+                    link_node(node);
+                    continue;
                 }
+                bucket_type &b = buckets[node_bucket_num(node)];
+                if (!b.first)
+                    b.first = node;
+                b.last = node;
+                node->prev = tail;
+                (tail ? tail->next : head) = node;
+                tail = node;
+                ++num_elements;
             }
-            return (PairLL(first, cur->next));
+        }
+
+        //the bucket that holds the nodes whose hash code is h
+        bucket_type &bucket_of(const size_t h) {
+            const size_type n = bucket_policy::index(h, buckets.size());
+            if (n < rehash_idx)
+                return (rehash_buckets[bucket_policy::index(h, rehash_buckets.size())]);
+            return (buckets[n]);
+        }
+
+        const bucket_type &bucket_of(const size_t h) const {
+            return (const_cast<self *>(this)->bucket_of(h));
+        }
+
+        link_type bucket_next(link_type cur, const bucket_type &b) const {
+            return (cur == b.last ? nullptr : cur->next);
+        }
+
+        void list_insert_before(link_type pos, link_type tar) {
+            tar->next = pos;
+            tar->prev = pos ? pos->prev : nullptr;
+            (tar->prev ? tar->prev->next : head) = tar;
+            if (pos)
+                pos->prev = tar;
+        }
+
+        void list_insert_after(link_type pos, link_type tar) {
+            tar->prev = pos;
+            tar->next = pos->next;
+            if (tar->next)
+                tar->next->prev = tar;
+            pos->next = tar;
+        }
+
+        void list_erase(link_type tar) {
+            (tar->prev ? tar->prev->next : head) = tar->next;
+            if (tar->next)
+                tar->next->prev = tar->prev;
+        }
+
+        void unlink_node(bucket_type &b, link_type tar) {
+            if (b.first == tar)
+                b.first = (b.last == tar ? b.last = nullptr : tar->next);
+            else if (b.last == tar)
+                b.last = tar->prev;
+            list_erase(tar);
+            --num_elements;
+        }
+
+        void unlink_node(link_type tar) { unlink_node(bucket_of(node_hash(tar)), tar); }
+
+        //an empty bucket opens its run at the front of the list
+        void link_front(bucket_type &b, link_type tar) {
+            list_insert_before(b.first ? b.first : head, tar);
+            if (!b.first)
+                b.last = tar;
+            b.first = tar;
+            ++num_elements;
+        }
+
+        void link_after(bucket_type &b, link_type pos, link_type tar) {
+            list_insert_after(pos, tar);
+            if (b.last == pos)
+                b.last = tar;
+            ++num_elements;
+        }
+
+        //tar goes next to a node with an equal key if there is one, so equal
+        //keys stay adjacent, else to the front of its bucket
+        iterator link_node(link_type tar) { return (link_node(tar, node_hash(tar))); }
+
+        iterator link_node(link_type tar, const size_t h) {
+            bucket_type &b = bucket_of(h);
+            link_type pos = is_multi ? find_imple(get_key(tar->value), h) : nullptr;
+            if (pos)
+                link_after(b, pos, tar);
+            else
+                link_front(b, tar);
+            return (iterator(tar, this));
         }
 
         template<typename...types>
@@ -614,30 +997,74 @@ namespace qmj {
         }
 
         void init_buckets(const size_type n) {
-            const size_type n_buckets = next_prime(n);
-            buckets.resize(n_buckets, nullptr);
+            const size_type n_buckets = bucket_policy::bucket_count(n);
+            buckets.resize(n_buckets, bucket_type());
+            update_grow_limit();
+        }
+
+        void update_grow_limit() {
+            grow_limit = (size_type) ((double) bucket_count() * max_load);
+        }
+
+        //the fewest buckets that hold n elements under the max load factor
+        size_type buckets_for(const size_type n) const {
+            return ((size_type) std::ceil((double) n / max_load));
         }
 
         size_t get_bucket_num(const key_type &key, const size_t n) const {
-            return hash(key) % n;
+            return (bucket_policy::index(hash(key), n));
         }
 
         size_type get_bucket_num(const key_type &key) const {
-            return get_bucket_num(key, buckets.size());
+            return get_bucket_num(key, bucket_count());
+        }
+
+        size_t node_hash(link_type node) const {
+            return (node_hash(node, bool_type<cache_hash>()));
+        }
+
+        size_t node_hash(link_type node, true_type) const { return (node->hash_code); }
+
+        size_t node_hash(link_type node, false_type) const { return (hash(get_key(node->value))); }
+
+        size_type node_bucket_num(link_type node, const size_t n) const {
+            return (bucket_policy::index(node_hash(node), n));
+        }
+
+        size_type node_bucket_num(link_type node) const {
+            return (node_bucket_num(node, buckets.size()));
+        }
+
+        void set_hash_code(link_type node, const size_t h) {
+            set_hash_code(node, h, bool_type<cache_hash>());
+        }
+
+        void set_hash_code(link_type node, const size_t h, true_type) { node->hash_code = h; }
+
+        void set_hash_code(link_type, const size_t, false_type) {}
+
+        //h is hash(k), a cached code that differs rules the node out cheaply
+        template<typename K>
+        bool node_equals(link_type node, const K &k, const size_t h) const {
+            return ((!cache_hash || node_hash(node) == h) && equals(k, get_key(node->value)));
         }
 
         size_type elements_in_bucket(const size_type n) const {
             size_type counter = 0;
-            for (link_type cur = buckets[n]; cur; cur = cur->next)
+            for (link_type cur = buckets[n].first; cur; cur = bucket_next(cur, buckets[n]))
                 ++counter;
             return (counter);
         }
 
-        link_type find_imple(const key_type &k) const {
-            size_t n = get_bucket_num(k);
-            link_type cur = buckets[n];
-            for (; cur && (!equals(k, get_key(cur->value)));)
-                cur = cur->next;
+        template<typename K>
+        link_type find_imple(const K &k) const { return (find_imple(k, hash(k))); }
+
+        template<typename K>
+        link_type find_imple(const K &k, const size_t h) const {
+            const bucket_type &b = bucket_of(h);
+            link_type cur = b.first;
+            for (; cur && (!node_equals(cur, k, h));)
+                cur = bucket_next(cur, b);
             return (cur);
         }
 
@@ -645,6 +1072,52 @@ namespace qmj {
             return (traits::ExtractKey(val));
         }
 
+        template<typename Iter, typename FIter, typename OIter>
+        OIter find_batch_imple(FIter first, FIter last, OIter dest) const {
+            //iterators, not pointers to *first, which may be a temporary
+            FIter keys[batch_width];
+            size_t codes[batch_width];
+            const bucket_type *heads[batch_width];
+            link_type cur[batch_width];
+            while (first != last) {
+                size_type n = 0;
+                for (; n != batch_width && first != last; ++n, ++first) {
+                    keys[n] = first;
+                    codes[n] = hash(*first);
+                    heads[n] = &bucket_of(codes[n]);
+                    _QMJ_PREFETCH(heads[n]);
+                }
+                for (size_type i = 0; i != n; ++i)
+                    if ((cur[i] = heads[i]->first))
+                        _QMJ_PREFETCH(cur[i]);
+                for (size_type i = 0; i != n; ++i, ++dest) {
+                    link_type node = cur[i];
+                    while (node && !node_equals(node, *keys[i], codes[i]))
+                        node = bucket_next(node, *heads[i]);
+                    *dest = Iter(node, this);
+                }
+            }
+            return (dest);
+        }
+
+        //links a copy of val whose key hashes to h; the caller has already
+        //grown the table
+        template<bool multi = is_multi>
+        enable_if_t<!multi, void> insert_hashed(const value_type &val, const size_t h) {
+            if (find_imple(get_key(val), h))
+                return;
+            link_type node = create_node(val);
+            set_hash_code(node, h);
+            link_front(bucket_of(h), node);
+        }
+
+        template<bool multi = is_multi>
+        enable_if_t<multi, void> insert_hashed(const value_type &val, const size_t h) {
+            link_type node = create_node(val);
+            set_hash_code(node, h);
+            link_node(node, h);
+        }
+
         iterator make_iter(const_iterator &citer) const {
             return (iterator(citer.cur, citer.ht));
         }
@@ -653,52 +1126,41 @@ namespace qmj {
         PairIB insert_unique_noresize(types &&... args) {
             link_type node = create_node(std::forward<types>(args)...);
             const value_type &val = node->value;
-            size_type n = get_bucket_num(get_key(val));
-            link_type first = buckets[n];
-
-            for (link_type cur = first; cur; cur = cur->next) {
-                if (equals(get_key(cur->value), get_key(val))) {
-                    destroy_and_free_node(node);
-                    return (PairIB(iterator(cur, this), false));
-                }
+            const size_t h = hash(get_key(val));
+            link_type cur = find_imple(get_key(val), h);
+            if (cur) {
+                destroy_and_free_node(node);
+                return (PairIB(iterator(cur, this), false));
             }
-            node->next = first;
-            buckets[n] = node;
-            ++num_elements;
+            set_hash_code(node, h);
+            link_front(bucket_of(h), node);
             return (PairIB(iterator(node, this), true));
         }
 
         template<typename value_type>
         PairIB insert_unique_noresize(value_type &&val) {
-            size_type n = get_bucket_num(get_key(val));
-            link_type first = buckets[n];
-            for (link_type cur = first; cur; cur = cur->next)
-                if (equals(get_key(cur->value), get_key(val)))
-                    return (PairIB(iterator(cur, this), false));
-            link_type node = create_node(std::forward<value_type>(val), first);
-            buckets[n] = node;
-            ++num_elements;
+            const size_t h = hash(get_key(val));
+            link_type cur = find_imple(get_key(val), h);
+            if (cur)
+                return (PairIB(iterator(cur, this), false));
+            link_type node = create_node(std::forward<value_type>(val));
+            set_hash_code(node, h);
+            link_front(bucket_of(h), node);
             return (PairIB(iterator(node, this), true));
         }
 
         template<typename...types>
         iterator insert_equal_noresize(types &&...args) {
             link_type node = create_node(std::forward<types>(args)...);
-            const value_type &val = node->value;
-            const size_type n = get_bucket_num(get_key(val));
-            node->next = buckets[n];
-            buckets[n] = node;
-            ++num_elements;
-            return iterator(node, this);
+            set_hash_code(node, hash(get_key(node->value)));
+            return (link_node(node));
         }
 
         template<typename value_type>
         iterator insert_equal_noresize(value_type &&val) {
-            const size_type n = get_bucket_num(get_key(val));
-            link_type tmp = create_node(std::forward<value_type>(val), buckets[n]);
-            buckets[n] = tmp;
-            ++num_elements;
-            return iterator(tmp, this);
+            link_type tmp = create_node(std::forward<value_type>(val));
+            set_hash_code(tmp, hash(get_key(tmp->value)));
+            return (link_node(tmp));
         }
 
         template<bool multi = is_multi, typename... types>
@@ -725,31 +1187,117 @@ namespace qmj {
             return (insert_equal_noresize(std::forward<value_type>(val)));
         }
 
+        //called before every insertion, it also moves the next batch of a
+        //pending incremental rehash
         void resize(const size_type new_n) {
+            if (rehashing())
+                rehash_step(rehash_batch);
+            if (new_n > grow_limit) {
+                const size_type n = bucket_policy::bucket_count(buckets_for(new_n));
+                if (n > bucket_count()) {
+                    if (incremental) {
+                        finish_rehash();
+                        container(n, bucket_type()).swap(rehash_buckets);
+                        update_grow_limit();
+                        rehash_step(rehash_batch);
+                    } else
+                        rehash_imple(n);
+                }
+            }
+        }
+
+        //moves the nodes of the next batch old buckets to the new table; a
+        //run of equal keys lands in one bucket and stays a run
+        void rehash_step(size_type batch) {
             const size_type old_n = buckets.size();
-            if (new_n > old_n) {
-                const size_type n = next_prime(new_n);
-                if (n > old_n) {
-                    container tmp(n, nullptr);
-                    size_type new_bucket_num;
-                    for (size_type i = 0; i != old_n; ++i) {
-                        for (link_type first = buckets[i]; first; first = buckets[i]) {
-                            new_bucket_num = get_bucket_num(get_key(first->value), n);
-                            buckets[i] = first->next;
-                            first->next = tmp[new_bucket_num];
-                            tmp[new_bucket_num] = first;
-                        }
-                    }
-                    buckets.swap(tmp);
+            const size_type n = rehash_buckets.size();
+            for (; batch && rehash_idx != old_n; --batch, ++rehash_idx) {
+                bucket_type &b = buckets[rehash_idx];
+                for (link_type cur = b.first, next; cur; cur = next) {
+                    next = bucket_next(cur, b);
+                    unlink_node(b, cur);
+                    link_front(rehash_buckets[node_bucket_num(cur, n)], cur);
                 }
             }
+            if (rehash_idx == old_n) {
+                buckets.swap(rehash_buckets);
+                container().swap(rehash_buckets);
+                rehash_idx = 0;
+            }
+        }
+
+        void finish_rehash() {
+            if (rehashing())
+                rehash_step(buckets.size());
+        }
+
+        //a bucket of the new table during a migration is its moved run in
+        //rehash_buckets followed by the nodes of the unmoved old buckets that
+        //map onto it; old_idx is buckets.size() while in the moved run, else
+        //the old bucket holding cur. walking the unmoved part is linear in
+        //the old table, the price of not moving nodes in a const query
+        void local_next(const_local_iterator &iter) const {
+            const size_type old_n = buckets.size();
+            const size_type n = rehash_buckets.size();
+            size_type j = iter.old_idx;
+            link_type cur = (iter.cur == iter.last ? nullptr : iter.cur->next);
+            if (j == old_n) {
+                if (cur) {
+                    iter.cur = cur;
+                    return;
+                }
+                j = rehash_idx;
+                cur = buckets[j].first;
+            }
+            for (;;) {
+                for (; cur; cur = bucket_next(cur, buckets[j]))
+                    if (node_bucket_num(cur, n) == iter.bucket) {
+                        iter.cur = cur;
+                        iter.last = buckets[j].last;
+                        iter.old_idx = j;
+                        return;
+                    }
+                if (++j == old_n)
+                    break;
+                cur = buckets[j].first;
+            }
+            iter.cur = nullptr;
+        }
+
+        //one pass relinks the list into the new buckets; a run of equal
+        //keys lands in one bucket and stays a run
+        void rehash_imple(const size_type n) {
+            container tmp(n, bucket_type());
+            link_type cur = head;
+            head = nullptr;
+            buckets.swap(tmp);
+            update_grow_limit();
+            for (link_type next; cur; cur = next) {
+                next = cur->next;
+                bucket_type &b = buckets[node_bucket_num(cur, n)];
+                list_insert_before(b.first ? b.first : head, cur);
+                if (!b.first)
+                    b.last = cur;
+                b.first = cur;
+            }
         }
 
     private:
         hasher hash;
         key_equal equals;
         container buckets;
+        link_type head;
         size_type num_elements;
+        container rehash_buckets;
+        size_type rehash_idx;
+        bool incremental;
+        float max_load;
+        size_type grow_limit;
+
+        static const size_type rehash_batch = 8;
+        static const size_type batch_width = 16;
+        static constexpr float min_max_load = 1.0f / 32;
+        static constexpr float max_max_load = 1024.0f;
     };
 
     template<typename traits>
@@ -2,29 +2,136 @@
 #ifndef _HASHFUNCTION_
 #define _HASHFUNCTION_
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
 namespace qmj {
     template<typename key>
     struct hash {
     };
 
+    //spreads every input bit over the whole word, for tables that index
+    //with only some of the bits of a hash code
+    inline size_t hash_mix(size_t h) {
+        h *= (size_t) 0x9E3779B97F4A7C15ull;
+        return (h ^ (h >> (sizeof(size_t) * 4)));
+    }
+
+    //murmur3's 64 bit finalizer, every input bit flips about half of the
+    //output bits, so patterned keys stay apart under a mask
+    inline size_t hash_int(std::uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return ((size_t) (k ^ (k >> 32 >> (sizeof(size_t) * 8 - 32))));
+    }
+
+    inline void _hash_mum(std::uint64_t &a, std::uint64_t &b) {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 r = (unsigned __int128) a * b;
+        a = (std::uint64_t) r;
+        b = (std::uint64_t) (r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        a = _umul128(a, b, &b);
+#else
+        std::uint64_t ha = a >> 32, hb = b >> 32, la = (std::uint32_t) a, lb = (std::uint32_t) b;
+        std::uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        std::uint64_t t = rl + (rm0 << 32), c = t < rl;
+        std::uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        a = lo;
+        b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+    }
+
+    inline std::uint64_t _hash_mix(std::uint64_t a, std::uint64_t b) {
+        _hash_mum(a, b);
+        return (a ^ b);
+    }
+
+    inline std::uint64_t _hash_read8(const unsigned char *p) {
+        std::uint64_t v;
+        memcpy(&v, p, 8);
+        return (v);
+    }
+
+    inline std::uint64_t _hash_read4(const unsigned char *p) {
+        std::uint32_t v;
+        memcpy(&v, p, 4);
+        return (v);
+    }
+
+    //wyhash: reads 16 or 48 bytes per step with unaligned word loads and
+    //folds them through 64x64->128 bit multiplies; short keys take at most
+    //four overlapping reads and no loop
+    inline size_t hash_bytes(const void *key, size_t len, std::uint64_t seed = 0) {
+        const std::uint64_t s0 = 0xa0761d6478bd642full, s1 = 0xe7037ed1a0b428dbull;
+        const std::uint64_t s2 = 0x8ebc6af09c88c6dbull, s3 = 0x589965cc75374cc3ull;
+        const unsigned char *p = static_cast<const unsigned char *>(key);
+        std::uint64_t a, b;
+        seed ^= _hash_mix(seed ^ s0, s1);
+        if (len <= 16) {
+            if (len >= 4) {
+                size_t mid = (len >> 3) << 2;
+                a = (_hash_read4(p) << 32) | _hash_read4(p + mid);
+                b = (_hash_read4(p + len - 4) << 32) | _hash_read4(p + len - 4 - mid);
+            } else if (len > 0) {
+                a = ((std::uint64_t) p[0] << 16) | ((std::uint64_t) p[len >> 1] << 8) | p[len - 1];
+                b = 0;
+            } else
+                a = b = 0;
+        } else {
+            size_t i = len;
+            if (i > 48) {
+                std::uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = _hash_mix(_hash_read8(p) ^ s1, _hash_read8(p + 8) ^ seed);
+                    see1 = _hash_mix(_hash_read8(p + 16) ^ s2, _hash_read8(p + 24) ^ see1);
+                    see2 = _hash_mix(_hash_read8(p + 32) ^ s3, _hash_read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            for (; i > 16; i -= 16, p += 16)
+                seed = _hash_mix(_hash_read8(p) ^ s1, _hash_read8(p + 8) ^ seed);
+            a = _hash_read8(p + i - 16);
+            b = _hash_read8(p + i - 8);
+        }
+        a ^= s1;
+        b ^= seed;
+        _hash_mum(a, b);
+        std::uint64_t h = _hash_mix(a ^ s0 ^ len, b ^ s1);
+        return ((size_t) (h ^ (h >> 32 >> (sizeof(size_t) * 8 - 32))));
+    }
+
+    //transparent: a const char * or string_view hashes like the std::string
+    //with the same characters, so it can be looked up without a copy
     template<>
     struct hash<std::string> {
-        size_t operator()(const std::string &str) const {
-            size_t h = 0;
-            for (auto iter = str.cbegin(); iter != str.cend(); ++iter)
-                h = (h << 2) + *iter;
-            return h;
-        }
+        typedef void is_transparent;
+
+        size_t operator()(const std::string &str) const { return (hash_bytes(str.data(), str.size())); }
+
+        size_t operator()(const char *s) const { return (hash_bytes(s, strlen(s))); }
+
+#if __cplusplus >= 201703L
+        size_t operator()(std::string_view str) const { return (hash_bytes(str.data(), str.size())); }
+#endif
     };
 
-    inline size_t hash_string(const char *s) {
-        size_t h = 0;
-        for (; *s; ++s)
-            h = (h << 2) + *s;
-        return (h);
-    }
+    inline size_t hash_string(const char *s) { return (hash_bytes(s, strlen(s))); }
 
     template<>
     struct hash<char *> {
@@ -36,49 +143,90 @@ namespace qmj {
         size_t operator()(const char *s) const { return hash_string(s); }
     };
 
+    template<typename type>
+    struct hash<type *> {
+        size_t operator()(type *p) const { return (hash_int((std::uint64_t) (std::uintptr_t) p)); }
+    };
+
+    template<>
+    struct hash<bool> {
+        size_t operator()(bool x) const { return (hash_int(x)); }
+    };
+
     template<>
     struct hash<char> {
-        size_t operator()(char x) const { return x; }
+        size_t operator()(char x) const { return (hash_int((unsigned char) x)); }
     };
 
     template<>
     struct hash<signed char> {
-        size_t operator()(signed char x) const { return x; }
+        size_t operator()(signed char x) const { return (hash_int((unsigned char) x)); }
     };
 
     template<>
     struct hash<unsigned char> {
-        size_t operator()(unsigned char x) const { return x; }
+        size_t operator()(unsigned char x) const { return (hash_int(x)); }
     };
 
     template<>
     struct hash<short> {
-        size_t operator()(short x) const { return x; }
+        size_t operator()(short x) const { return (hash_int((std::uint64_t) (long long) x)); }
     };
 
     template<>
     struct hash<unsigned short> {
-        size_t operator()(unsigned short x) const { return x; }
+        size_t operator()(unsigned short x) const { return (hash_int(x)); }
     };
 
     template<>
     struct hash<int> {
-        size_t operator()(int x) const { return x; }
+        size_t operator()(int x) const { return (hash_int((std::uint64_t) (long long) x)); }
     };
 
     template<>
     struct hash<unsigned int> {
-        size_t operator()(unsigned int x) const { return x; }
+        size_t operator()(unsigned int x) const { return (hash_int(x)); }
     };
 
     template<>
     struct hash<long> {
-        size_t operator()(long x) const { return x; }
+        size_t operator()(long x) const { return (hash_int((std::uint64_t) (long long) x)); }
     };
 
     template<>
     struct hash<unsigned long> {
-        size_t operator()(unsigned long x) const { return x; }
+        size_t operator()(unsigned long x) const { return (hash_int(x)); }
+    };
+
+    template<>
+    struct hash<long long> {
+        size_t operator()(long long x) const { return (hash_int((std::uint64_t) x)); }
+    };
+
+    template<>
+    struct hash<unsigned long long> {
+        size_t operator()(unsigned long long x) const { return (hash_int(x)); }
+    };
+
+    //+0.0 and -0.0 compare equal and must hash alike
+    template<>
+    struct hash<float> {
+        size_t operator()(float x) const {
+            std::uint32_t bits = 0;
+            if (x != 0.0f)
+                memcpy(&bits, &x, sizeof(bits));
+            return (hash_int(bits));
+        }
+    };
+
+    template<>
+    struct hash<double> {
+        size_t operator()(double x) const {
+            std::uint64_t bits = 0;
+            if (x != 0.0)
+                memcpy(&bits, &x, sizeof(bits));
+            return (hash_int(bits));
+        }
     };
 }
 
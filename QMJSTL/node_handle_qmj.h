@@ -0,0 +1,111 @@
+#pragma once
+#ifndef _NODE_HANDLE_QMJ_
+#define _NODE_HANDLE_QMJ_
+
+#include <utility>
+#include "allocator.h"
+#include "type_traits_qmj.h"
+
+namespace qmj {
+    //owns a node unlinked from a container by extract(), insert() links it
+    //into another container with the same node type without allocating or
+    //copying the value; an unused node is destroyed with the handle
+    template<typename node_type, typename key_type_, typename value_type_, typename allocator_type_>
+    class node_handle {
+    public:
+        template<typename>
+        friend
+        class rb_tree;
+
+        template<typename>
+        friend
+        class hashtable;
+
+        typedef key_type_ key_type;
+        typedef value_type_ value_type;
+        typedef allocator_type_ allocator_type;
+        typedef node_type *link_type;
+        typedef node_handle<node_type, key_type, value_type, allocator_type> self;
+        typedef typename allocator_type::template rebind<node_type>::other alloc;
+
+        node_handle() noexcept : node(nullptr) {}
+
+        node_handle(self &&x) noexcept : node(x.node) { x.node = nullptr; }
+
+        node_handle(const self &) = delete;
+
+        self &operator=(self &&x) noexcept {
+            if (this != &x) {
+                reset();
+                node = x.node;
+                x.node = nullptr;
+            }
+            return (*this);
+        }
+
+        self &operator=(const self &) = delete;
+
+        ~node_handle() { reset(); }
+
+        bool empty() const noexcept { return (!node); }
+
+        explicit operator bool() const noexcept { return (node != nullptr); }
+
+        allocator_type get_allocator() const { return (allocator_type()); }
+
+        value_type &value() const { return (node->value); }
+
+        //unlike through an iterator, the key may be changed here
+        key_type &key() const {
+            return (key_of(node->value, is_same<key_type, value_type>()));
+        }
+
+        template<typename type = value_type>
+        typename type::second_type &mapped() const { return (node->value.second); }
+
+        void swap(self &x) noexcept { std::swap(node, x.node); }
+
+    protected:
+        explicit node_handle(link_type node) noexcept : node(node) {}
+
+        link_type release() noexcept {
+            link_type tmp = node;
+            node = nullptr;
+            return (tmp);
+        }
+
+        void reset() {
+            if (node) {
+                alloc::destroy(node);
+                alloc::deallocate(node);
+                node = nullptr;
+            }
+        }
+
+        static key_type &key_of(value_type &value, true_type) { return (value); }
+
+        static key_type &key_of(value_type &value, false_type) {
+            return (const_cast<key_type &>(value.first));
+        }
+
+    protected:
+        link_type node;
+    };
+
+    template<typename node_type, typename key_type, typename value_type, typename allocator_type>
+    inline void swap(node_handle<node_type, key_type, value_type, allocator_type> &left,
+                     node_handle<node_type, key_type, value_type, allocator_type> &right) noexcept {
+        left.swap(right);
+    }
+
+    //what insert(node_handle &&) returns for a container with unique keys,
+    //node keeps the handle when an equal key was already present
+    template<typename Iter, typename NodeHandle>
+    struct node_insert_return {
+        Iter position;
+        bool inserted;
+        NodeHandle node;
+    };
+}
+
+#endif //_NODE_HANDLE_QMJ_
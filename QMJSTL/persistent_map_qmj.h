@@ -0,0 +1,79 @@
+#pragma once
+#ifndef _PERSISTENT_MAP_QMJ_
+#define _PERSISTENT_MAP_QMJ_
+
+#include "map_qmj.h"
+#include "persistent_tree.h"
+
+namespace qmj {
+    //nodes are released by whichever snapshot drops them last, possibly on
+    //another thread, so the default allocator is the thread safe malloc one
+    template<typename key_type_, typename data_type_, typename Compare = std::less<key_type_>,
+            typename Alloc = qmj::simple_allocator<std::pair<const key_type_, data_type_>>>
+    class persistent_map : public persistent_tree<map_traits<key_type_, data_type_, Compare, Alloc, false>> {
+    public:
+        typedef key_type_ key_type;
+        typedef data_type_ data_type;
+        typedef data_type mapped_type;
+        typedef std::pair<const key_type, data_type> value_type;
+        typedef Compare key_compare;
+
+        typedef persistent_tree<map_traits<key_type, data_type, Compare, Alloc, false>> base_type;
+        typedef persistent_map<key_type, data_type, Compare, Alloc> self;
+
+        typedef typename base_type::pointer pointer;
+        typedef typename base_type::const_pointer const_pointer;
+        typedef typename base_type::reference reference;
+        typedef typename base_type::const_reference const_reference;
+        typedef typename base_type::iterator iterator;
+        typedef typename base_type::const_iterator const_iterator;
+        typedef typename base_type::size_type size_type;
+        typedef typename base_type::difference_type difference_type;
+
+        persistent_map() : base_type() {}
+
+        explicit persistent_map(const Compare &comp) : base_type(comp) {}
+
+        template<typename Iter>
+        persistent_map(Iter first, Iter last) : base_type() {
+            base_type::insert(first, last);
+        }
+
+        persistent_map(const std::initializer_list<value_type> &lst) : base_type() {
+            base_type::insert(lst);
+        }
+
+        persistent_map(const self &x) : base_type(x) {}
+
+        persistent_map(self &&x) : base_type(std::move(x)) {}
+
+        self &operator=(const self &x) {
+            base_type::operator=(x);
+            return (*this);
+        }
+
+        self &operator=(self &&x) {
+            base_type::operator=(std::move(x));
+            return (*this);
+        }
+
+        self snapshot() const { return (self(*this)); }
+
+        using base_type::insert_or_assign;
+
+        template<typename type>
+        bool insert_or_assign(const key_type &k, type &&data) {
+            return (base_type::insert_or_assign(value_type(k, std::forward<type>(data))));
+        }
+
+        void swap(self &x) noexcept { base_type::swap(x); }
+    };
+
+    template<typename key_type, typename data_type, typename Compare, typename Alloc>
+    inline void swap(persistent_map<key_type, data_type, Compare, Alloc> &left,
+                     persistent_map<key_type, data_type, Compare, Alloc> &right) noexcept {
+        left.swap(right);
+    }
+}
+
+#endif //_PERSISTENT_MAP_QMJ_
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef _PERSISTENT_SET_QMJ_
+#define _PERSISTENT_SET_QMJ_
+
+#include "set_qmj.h"
+#include "persistent_tree.h"
+
+namespace qmj {
+    template<typename key_type_, typename Compare = std::less<key_type_>,
+            typename Alloc = qmj::simple_allocator<key_type_>>
+    class persistent_set : public persistent_tree<set_traits<key_type_, Compare, Alloc, false>> {
+    public:
+        typedef key_type_ key_type;
+        typedef key_type value_type;
+        typedef Compare key_compare;
+        typedef Compare value_compare;
+
+        typedef persistent_tree<set_traits<key_type, Compare, Alloc, false>> base_type;
+        typedef persistent_set<key_type, Compare, Alloc> self;
+
+        typedef typename base_type::const_pointer pointer;
+        typedef typename base_type::const_pointer const_pointer;
+        typedef typename base_type::const_reference reference;
+        typedef typename base_type::const_reference const_reference;
+        typedef typename base_type::iterator iterator;
+        typedef typename base_type::const_iterator const_iterator;
+        typedef typename base_type::size_type size_type;
+        typedef typename base_type::difference_type difference_type;
+
+        persistent_set() : base_type() {}
+
+        explicit persistent_set(const Compare &comp) : base_type(comp) {}
+
+        template<typename Iter>
+        persistent_set(Iter first, Iter last) : base_type() {
+            base_type::insert(first, last);
+        }
+
+        persistent_set(const std::initializer_list<key_type> &lst) : base_type() {
+            base_type::insert(lst);
+        }
+
+        persistent_set(const self &x) : base_type(x) {}
+
+        persistent_set(self &&x) : base_type(std::move(x)) {}
+
+        self &operator=(const self &x) {
+            base_type::operator=(x);
+            return (*this);
+        }
+
+        self &operator=(self &&x) {
+            base_type::operator=(std::move(x));
+            return (*this);
+        }
+
+        self snapshot() const { return (self(*this)); }
+
+        void swap(self &x) noexcept { base_type::swap(x); }
+    };
+
+    template<typename key_type, typename Compare, typename Alloc>
+    inline void swap(persistent_set<key_type, Compare, Alloc> &left,
+                     persistent_set<key_type, Compare, Alloc> &right) noexcept {
+        left.swap(right);
+    }
+}
+
+#endif //_PERSISTENT_SET_QMJ_
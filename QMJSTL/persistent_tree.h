@@ -0,0 +1,449 @@
+#pragma once
+#ifndef _PERSISTENT_TREE_
+#define _PERSISTENT_TREE_
+
+#include <atomic>
+#include <initializer_list>
+#include "allocator.h"
+#include "type_traits_qmj.h"
+
+namespace qmj {
+    //nodes are immutable once linked and shared between all the trees that
+    //reach them, refs counts the parents and roots holding the node
+    template<typename value_type>
+    struct persistent_tree_node {
+        typedef persistent_tree_node<value_type> *link_type;
+
+        template<typename type>
+        persistent_tree_node(type &&value, link_type left, link_type right, int height)
+                : value(std::forward<type>(value)), left(left), right(right),
+                  height(height), refs(1) {}
+
+        value_type value;
+        link_type left;
+        link_type right;
+        int height;
+        std::atomic<size_t> refs;
+    };
+
+    template<typename traits>
+    class persistent_tree;
+
+    template<typename value_type_>
+    class persistent_tree_const_iterator {
+    public:
+        template<typename traits>
+        friend
+        class persistent_tree;
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef value_type_ value_type;
+        typedef const value_type &reference;
+        typedef const value_type *pointer;
+        typedef ptrdiff_t difference_type;
+
+        typedef persistent_tree_node<value_type> *link_type;
+        typedef persistent_tree_const_iterator<value_type> self;
+
+        //the height of an avl tree never exceeds 1.45 * log2(n + 2)
+        enum {
+            max_height = 96
+        };
+
+        persistent_tree_const_iterator() : depth(0) {}
+
+        persistent_tree_const_iterator(const self &x) : depth(x.depth) {
+            for (int i = 0; i != depth; ++i)
+                path[i] = x.path[i];
+        }
+
+        self &operator=(const self &x) {
+            depth = x.depth;
+            for (int i = 0; i != depth; ++i)
+                path[i] = x.path[i];
+            return (*this);
+        }
+
+        bool operator==(const self &x) const {
+            return (depth == 0 ? x.depth == 0 : x.depth != 0 && get_node() == x.get_node());
+        }
+
+        bool operator!=(const self &x) const { return (!(operator==(x))); }
+
+        reference operator*() const { return (get_node()->value); }
+
+        pointer operator->() const { return (&(operator*())); }
+
+        self &operator++() {
+            link_type cur = path[--depth];
+            push_left(cur->right);
+            return (*this);
+        }
+
+        self operator++(int) {
+            self tmp = *this;
+            operator++();
+            return (tmp);
+        }
+
+    protected:
+        link_type get_node() const { return (path[depth - 1]); }
+
+        void push(link_type node) { path[depth++] = node; }
+
+        void push_left(link_type node) {
+            for (; node; node = node->left)
+                push(node);
+        }
+
+    protected:
+        link_type path[max_height];
+        int depth;
+    };
+
+    //an avl tree updated by path copying: a copy of the tree is O(1) and
+    //every insert or erase copies only the nodes on the root-to-key path
+    template<typename traits>
+    class persistent_tree {
+    public:
+        typedef persistent_tree<traits> self;
+        typedef typename traits::key_type key_type;
+        typedef typename traits::value_type value_type;
+        typedef typename traits::key_compare key_compare;
+        typedef typename traits::value_compare value_compare;
+        typedef typename traits::allocator_type allocator_type;
+        typedef key_compare Compare;
+        typedef size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        typedef value_type *pointer;
+        typedef const value_type *const_pointer;
+        typedef value_type &reference;
+        typedef const value_type &const_reference;
+
+        typedef persistent_tree_node<value_type> node_type;
+        typedef node_type *link_type;
+        typedef typename allocator_type::template rebind<node_type>::other alloc;
+
+        typedef persistent_tree_const_iterator<value_type> const_iterator;
+        typedef const_iterator iterator;
+        typedef std::pair<const_iterator, bool> pairib;
+        typedef std::pair<const_iterator, const_iterator> paircc;
+
+        persistent_tree() : root(nullptr), node_count(0), comp() {}
+
+        explicit persistent_tree(const Compare &comp)
+                : root(nullptr), node_count(0), comp(comp) {}
+
+        persistent_tree(const self &x)
+                : root(acquire(x.root)), node_count(x.node_count), comp(x.comp) {}
+
+        persistent_tree(self &&x)
+                : root(x.root), node_count(x.node_count), comp(x.comp) {
+            x.root = nullptr;
+            x.node_count = 0;
+        }
+
+        self &operator=(self x) {
+            swap(x);
+            return (*this);
+        }
+
+        ~persistent_tree() { release(root); }
+
+        //O(1), the returned tree shares every node with *this
+        self snapshot() const { return (self(*this)); }
+
+        const_iterator begin() const {
+            const_iterator iter;
+            iter.push_left(root);
+            return (iter);
+        }
+
+        const_iterator end() const { return (const_iterator()); }
+
+        const_iterator cbegin() const { return (begin()); }
+
+        const_iterator cend() const { return (end()); }
+
+        size_type size() const { return (node_count); }
+
+        bool empty() const { return (!node_count); }
+
+        size_type max_size() const { return size_type(-1); }
+
+        allocator_type get_allocator() const { return (allocator_type()); }
+
+        key_compare key_comp() const { return (comp); }
+
+        void clear() {
+            release(root);
+            root = nullptr;
+            node_count = 0;
+        }
+
+        void swap(self &x) noexcept {
+            std::swap(root, x.root);
+            std::swap(node_count, x.node_count);
+            std::swap(comp, x.comp);
+        }
+
+        const_iterator find(const key_type &key) const {
+            const_iterator iter = lower_bound(key);
+            if (iter != end() && comp(key, get_key(*iter)))
+                return (end());
+            return (iter);
+        }
+
+        size_type count(const key_type &key) const { return (find_node(key) ? 1 : 0); }
+
+        const_iterator lower_bound(const key_type &key) const {
+            const_iterator iter;
+            for (link_type cur = root; cur;) {
+                if (comp(get_key(cur->value), key))
+                    cur = cur->right;
+                else {
+                    iter.push(cur);
+                    cur = cur->left;
+                }
+            }
+            return (iter);
+        }
+
+        const_iterator upper_bound(const key_type &key) const {
+            const_iterator iter;
+            for (link_type cur = root; cur;) {
+                if (comp(key, get_key(cur->value))) {
+                    iter.push(cur);
+                    cur = cur->left;
+                } else
+                    cur = cur->right;
+            }
+            return (iter);
+        }
+
+        paircc equal_range(const key_type &key) const {
+            return {lower_bound(key), upper_bound(key)};
+        }
+
+        bool insert(const value_type &value) { return (insert_imple(value, false)); }
+
+        bool insert(value_type &&value) { return (insert_imple(std::move(value), false)); }
+
+        template<typename Iter>
+        void insert(Iter first, Iter last) {
+            for (; first != last; ++first)
+                insert(*first);
+        }
+
+        void insert(const std::initializer_list<value_type> &lst) {
+            insert(lst.begin(), lst.end());
+        }
+
+        //replaces the element with an equal key, returns true if none existed
+        template<typename value_type>
+        bool insert_or_assign(value_type &&value) {
+            return (insert_imple(std::forward<value_type>(value), true));
+        }
+
+        size_type erase(const key_type &key) {
+            if (!find_node(key))
+                return (0);
+            link_type new_root = erase_imple(root, key);
+            release(root);
+            root = new_root;
+            --node_count;
+            return (1);
+        }
+
+    protected:
+        const key_type &get_key(const value_type &val) const {
+            return (traits::keyOfValue(val));
+        }
+
+        static int height(link_type node) { return (node ? node->height : 0); }
+
+        static link_type acquire(link_type node) {
+            if (node)
+                node->refs.fetch_add(1, std::memory_order_relaxed);
+            return (node);
+        }
+
+        static void release(link_type node) {
+            while (node && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                link_type right = node->right;
+                release(node->left);
+                alloc::destroy(node);
+                alloc::deallocate(node);
+                node = right;
+            }
+        }
+
+        //takes over the references held in left and right, and releases
+        //them if it throws
+        template<typename type>
+        static link_type create_node(type &&value, link_type left, link_type right) {
+            link_type node = nullptr;
+            int h = height(left) > height(right) ? height(left) : height(right);
+            try {
+                node = alloc::allocate();
+                alloc::construct(node, std::forward<type>(value), left, right, h + 1);
+            } catch (...) {
+                if (node)
+                    alloc::deallocate(node);
+                release(left);
+                release(right);
+                throw;
+            }
+            return (node);
+        }
+
+        //takes over left and right like create_node. the new subtrees are
+        //built one at a time into locals, so a throw never strands a
+        //reference acquired for an argument list that was not finished;
+        //the light side goes to the first create_node, which releases it
+        //on a throw, so the catch only drops the heavy side
+        static link_type balance(const value_type &value, link_type left, link_type right) {
+            int hl = height(left);
+            int hr = height(right);
+            if (hl > hr + 1) {
+                link_type ret;
+                try {
+                    if (height(left->left) >= height(left->right)) {
+                        link_type lower = create_node(value, acquire(left->right), right);
+                        ret = create_node(left->value, acquire(left->left), lower);
+                    } else {
+                        link_type lr = left->right;
+                        link_type lower_right = create_node(value, acquire(lr->right), right);
+                        link_type lower_left;
+                        try {
+                            lower_left = create_node(left->value, acquire(left->left), acquire(lr->left));
+                        } catch (...) {
+                            release(lower_right);
+                            throw;
+                        }
+                        ret = create_node(lr->value, lower_left, lower_right);
+                    }
+                } catch (...) {
+                    release(left);
+                    throw;
+                }
+                release(left);
+                return (ret);
+            } else if (hr > hl + 1) {
+                link_type ret;
+                try {
+                    if (height(right->right) >= height(right->left)) {
+                        link_type lower = create_node(value, left, acquire(right->left));
+                        ret = create_node(right->value, lower, acquire(right->right));
+                    } else {
+                        link_type rl = right->left;
+                        link_type lower_left = create_node(value, left, acquire(rl->left));
+                        link_type lower_right;
+                        try {
+                            lower_right = create_node(right->value, acquire(rl->right), acquire(right->right));
+                        } catch (...) {
+                            release(lower_left);
+                            throw;
+                        }
+                        ret = create_node(rl->value, lower_left, lower_right);
+                    }
+                } catch (...) {
+                    release(right);
+                    throw;
+                }
+                release(right);
+                return (ret);
+            }
+            return (create_node(value, left, right));
+        }
+
+        link_type find_node(const key_type &key) const {
+            for (link_type cur = root; cur;) {
+                if (comp(key, get_key(cur->value)))
+                    cur = cur->left;
+                else if (comp(get_key(cur->value), key))
+                    cur = cur->right;
+                else
+                    return (cur);
+            }
+            return (nullptr);
+        }
+
+        template<typename value_type>
+        bool insert_imple(value_type &&value, bool assign) {
+            bool exist = find_node(get_key(value)) != nullptr;
+            if (exist && !assign)
+                return (false);
+            link_type new_root = insert_path(root, std::forward<value_type>(value));
+            release(root);
+            root = new_root;
+            if (!exist)
+                ++node_count;
+            return (!exist);
+        }
+
+        //the copied child is finished before the other child's reference
+        //is taken, so a throw from below leaves nothing to release here
+        template<typename value_type>
+        link_type insert_path(link_type node, value_type &&value) {
+            if (!node)
+                return (create_node(std::forward<value_type>(value), nullptr, nullptr));
+            if (comp(get_key(value), get_key(node->value))) {
+                link_type left = insert_path(node->left, std::forward<value_type>(value));
+                return (balance(node->value, left, acquire(node->right)));
+            } else if (comp(get_key(node->value), get_key(value))) {
+                link_type right = insert_path(node->right, std::forward<value_type>(value));
+                return (balance(node->value, acquire(node->left), right));
+            }
+            return (create_node(std::forward<value_type>(value), acquire(node->left), acquire(node->right)));
+        }
+
+        link_type erase_imple(link_type node, const key_type &key) {
+            if (comp(key, get_key(node->value))) {
+                link_type left = erase_imple(node->left, key);
+                return (balance(node->value, left, acquire(node->right)));
+            } else if (comp(get_key(node->value), key)) {
+                link_type right = erase_imple(node->right, key);
+                return (balance(node->value, acquire(node->left), right));
+            } else if (!node->left)
+                return (acquire(node->right));
+            else if (!node->right)
+                return (acquire(node->left));
+            link_type succ = node->right;
+            while (succ->left)
+                succ = succ->left;
+            link_type right = erase_min(node->right);
+            return (balance(succ->value, acquire(node->left), right));
+        }
+
+        static link_type erase_min(link_type node) {
+            if (!node->left)
+                return (acquire(node->right));
+            link_type left = erase_min(node->left);
+            return (balance(node->value, left, acquire(node->right)));
+        }
+
+    private:
+        link_type root;
+        size_type node_count;
+        Compare comp;
+    };
+
+    template<typename traits>
+    inline void swap(persistent_tree<traits> &left, persistent_tree<traits> &right) noexcept {
+        left.swap(right);
+    }
+
+    template<typename traits>
+    inline bool operator==(const persistent_tree<traits> &left, const persistent_tree<traits> &right) {
+        return (left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin()));
+    }
+
+    template<typename traits>
+    inline bool operator!=(const persistent_tree<traits> &left, const persistent_tree<traits> &right) {
+        return (!(left == right));
+    }
+}
+
+#endif //_PERSISTENT_TREE_
@@ -3,7 +3,9 @@
 #define _RB_TREE_
 
 #include "allocator.h"
+#include "execution_qmj.h"
 #include "iterator_qmj.h"
+#include "node_handle_qmj.h"
 
 namespace qmj {
     typedef bool rbt_color_type;
@@ -85,7 +87,7 @@ namespace qmj {
 
         rb_tree_const_iterator(const self &x) : node(x.node) {}
 
-        bool operator==(const self &x) const { return node = x.node; }
+        bool operator==(const self &x) const { return node == x.node; }
 
         bool operator!=(const self &x) const { return (!(operator==(x))); }
 
@@ -238,6 +240,12 @@ namespace qmj {
         typedef std::pair<iterator, bool> pairib;
         typedef std::pair<iterator, iterator> pairii;
         typedef std::pair<const_iterator, const_iterator> paircc;
+        typedef node_handle<node_type, key_type, value_type, allocator_type> node_handle_type;
+        typedef node_insert_return<iterator, node_handle_type> insert_return_type;
+
+        template<typename>
+        friend
+        class rb_tree;
 
         rb_tree()
                 : nil(create_nil()), root(nil), comp(), node_count(0) {}
@@ -317,7 +325,7 @@ namespace qmj {
         bool empty() const { return (!(node_count)); }
 
         size_type count(const key_type &val) const {
-            paircc range = qual_range(val);
+            paircc range = equal_range(val);
             return (qmj::distance(range.first, range.second));
         }
 
@@ -328,15 +336,11 @@ namespace qmj {
         size_type max_size() const { return size_type(-1); }
 
         iterator erase(const_iterator x) {
-            const_iterator temp = x;
             const_iterator succ = x;
             ++succ;
-
-            if (x == begin())
-                nil->right = succ.get_node();
-            if (x == --end())
-                nil->left = (--temp).get_node();
-            rbt_delete(x.get_node());
+            link_type tar = x.get_node();
+            rbt_detach(x);
+            destroy_and_free_node(tar);
             return make_iter(succ);
         }
 
@@ -386,6 +390,78 @@ namespace qmj {
             return make_iter(find_imple(key));
         }
 
+        //with a transparent comparator, such as std::less<>, the lookups
+        //take any key type it compares against key_type
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        size_type count(const K &key) const {
+            paircc range = equal_range(key);
+            return (qmj::distance(range.first, range.second));
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        const_iterator lower_bound(const K &key) const {
+            return lower_bound_imple(key);
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        iterator lower_bound(const K &key) {
+            return make_iter(lower_bound_imple(key));
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        const_iterator upper_bound(const K &key) const {
+            return upper_bound_imple(key);
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        iterator upper_bound(const K &key) {
+            return make_iter(upper_bound_imple(key));
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        paircc equal_range(const K &key) const {
+            return {lower_bound(key), upper_bound(key)};
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        pairii equal_range(const K &key) {
+            return {lower_bound(key), upper_bound(key)};
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        const_iterator find(const K &key) const {
+            return find_imple(key);
+        }
+
+        template<typename K, typename C = key_compare, enable_if_t<is_transparent<C>::value, int> = 0>
+        iterator find(const K &key) {
+            return make_iter(find_imple(key));
+        }
+
+        //keys in [first,last) are searched batch_width at a time with the descents
+        //interleaved, so the cache misses of different keys overlap
+        template<typename FIter, typename OIter>
+        OIter find_batch(FIter first, FIter last, OIter dest) const {
+            return find_batch_imple<const_iterator>(first, last, dest);
+        }
+
+        template<typename FIter, typename OIter>
+        OIter find_batch(FIter first, FIter last, OIter dest) {
+            return find_batch_imple<iterator>(first, last, dest);
+        }
+
+        //keys in [first,last) must be sorted by key_comp(), every search resumes
+        //from the path of the previous one instead of the root
+        template<typename FIter, typename OIter>
+        OIter find_batch_sorted(FIter first, FIter last, OIter dest) const {
+            return find_batch_sorted_imple<const_iterator>(first, last, dest);
+        }
+
+        template<typename FIter, typename OIter>
+        OIter find_batch_sorted(FIter first, FIter last, OIter dest) {
+            return find_batch_sorted_imple<iterator>(first, last, dest);
+        }
+
         template<bool multi = is_multi>
         enable_if_t<multi, iterator> insert(const value_type &val) {
             return insert_equal_imple(get_root(), val);
@@ -550,6 +626,147 @@ namespace qmj {
             return insert_imple(par, tar);
         }
 
+        //extract unlinks a node and hands it over with its value in place,
+        //insert(node_handle_type &&) links such a node without allocating
+        node_handle_type extract(const_iterator pos) {
+            link_type tar = pos.get_node();
+            rbt_detach(pos);
+            return (node_handle_type(tar));
+        }
+
+        node_handle_type extract(const key_type &key) {
+            const_iterator pos = find_imple(key);
+            if (pos == cend())
+                return (node_handle_type());
+            return (extract(pos));
+        }
+
+        template<bool multi = is_multi>
+        enable_if_t<!multi, insert_return_type> insert(node_handle_type &&nh) {
+            if (nh.empty())
+                return {end(), false, node_handle_type()};
+            bool exist;
+            link_type par = insert_pos(get_key(nh.node->value), exist);
+            if (exist)
+                return {iterator(par), false, std::move(nh)};
+            return {link_node(par, nh.release()), true, node_handle_type()};
+        }
+
+        template<bool multi = is_multi>
+        enable_if_t<multi, iterator> insert(node_handle_type &&nh) {
+            if (nh.empty())
+                return (end());
+            bool exist;
+            link_type par = insert_pos(get_key(nh.node->value), exist);
+            return (link_node(par, nh.release()));
+        }
+
+        //moves every node of source whose key is not in *this yet, or every
+        //node if *this allows equal keys; the nodes are relinked, not copied
+        template<typename traits2>
+        void merge(rb_tree<traits2> &source) {
+            static_assert(is_same<alloc, typename rb_tree<traits2>::alloc>::value,
+                          "merge needs the same node and allocator type");
+            if ((void *) this == (void *) &source)
+                return;
+            bool exist;
+            for (const_iterator first = source.cbegin(), last = source.cend(); first != last;) {
+                const_iterator pos = first++;
+                link_type tar = pos.get_node();
+                link_type par = insert_pos(get_key(tar->value), exist);
+                if (!exist) {
+                    source.rbt_detach(pos);
+                    link_node(par, tar);
+                }
+            }
+        }
+
+        template<typename traits2>
+        void merge(rb_tree<traits2> &&source) { merge(source); }
+
+        //appends the elements of right, which must all be ordered after the
+        //elements of *this, and leaves right empty; nodes are moved, not copied,
+        //and every node of the smaller tree is visited once to rehome it
+        void join(self &right) {
+            if (right.empty())
+                return;
+            size_type n = right.node_count;
+            link_type r = adopt_nodes(right);
+            int h;
+            link_type t = join2_imple(get_root(), black_height(get_root()), r, black_height(r), h);
+            node_count += n;
+            reset_root(t);
+        }
+
+        //the same as join(right) with value placed between the two trees
+        void join(const value_type &value, self &right) {
+            link_type k = create_insert_node(nil, value);
+            size_type n = right.node_count;
+            link_type r = adopt_nodes(right);
+            int h;
+            link_type t = join_imple(get_root(), black_height(get_root()), k, r, black_height(r), h);
+            node_count += n + 1;
+            reset_root(t);
+        }
+
+        //moves the elements not less than key into right, whose old contents
+        //are cleared; the cut is O(log n), the moved nodes are visited once
+        void split(const key_type &key, self &right) {
+            right.clear();
+            link_type l, r;
+            int lh, rh;
+            split_imple(get_root(), black_height(get_root()), key, false, l, lh, r, rh);
+            size_type n = 0;
+            if (r != nil)
+                n = rbt_relink(r, nil, right.nil);
+            else
+                r = right.nil;
+            reset_root(l);
+            node_count -= n;
+            right.node_count = n;
+            right.reset_root(r);
+        }
+
+        //the set operations below take every node of other and leave it empty,
+        //a node of *this is kept whenever both trees hold an equal key; they
+        //split and join subtrees, which costs O(m log(n / m + 1)) comparisons
+        //for trees of sizes m <= n
+        template<bool multi = is_multi>
+        enable_if_t<!multi> union_with(self &other) {
+            set_operation(rbt_union, other, 0);
+        }
+
+        template<bool multi = is_multi>
+        enable_if_t<!multi> intersect_with(self &other) {
+            set_operation(rbt_intersect, other, 0);
+        }
+
+        template<bool multi = is_multi>
+        enable_if_t<!multi> difference_with(self &other) {
+            set_operation(rbt_difference, other, 0);
+        }
+
+        //with qmj::par the two halves of every level run in parallel until
+        //each hardware thread has its share, comp must be safe to call
+        //concurrently
+        template<typename policy, bool multi = is_multi>
+        enable_if_t<!multi && is_execution_policy<policy>::value>
+        union_with(policy &&exec, self &other) {
+            set_operation(rbt_union, other, fork_depth(exec, node_count + other.node_count, fork_grain));
+        }
+
+        template<typename policy, bool multi = is_multi>
+        enable_if_t<!multi && is_execution_policy<policy>::value>
+        intersect_with(policy &&exec, self &other) {
+            set_operation(rbt_intersect, other, fork_depth(exec, node_count + other.node_count, fork_grain));
+        }
+
+        template<typename policy, bool multi = is_multi>
+        enable_if_t<!multi && is_execution_policy<policy>::value>
+        difference_with(policy &&exec, self &other) {
+            set_operation(rbt_difference, other, fork_depth(exec, node_count + other.node_count, fork_grain));
+        }
+
     protected:
         /*
         void print(link_type rt, int counter_hight = 0) {
@@ -593,7 +810,19 @@ namespace qmj {
             alloc::deallocate(node);
         }
 
-        void rbt_delete(link_type tar);
+        void rbt_unlink(link_type tar);
+
+        void rbt_detach(const_iterator x) {
+            const_iterator temp = x;
+            const_iterator succ = x;
+            ++succ;
+
+            if (x == begin())
+                nil->right = succ.get_node();
+            if (x == --end())
+                nil->left = (--temp).get_node();
+            rbt_unlink(x.get_node());
+        }
 
         link_type get_root() const { return (root); }
 
@@ -611,9 +840,15 @@ namespace qmj {
 
         static link_type maximum(link_type rt) { return node_type::maximum(rt); }
 
-        void rbt_left_rotate(link_type x);
+        void rbt_left_rotate(link_type x) { rbt_left_rotate(x, root); }
+
+        void rbt_right_rotate(link_type x) { rbt_right_rotate(x, root); }
+
+        void rbt_left_rotate(link_type x, link_type &rt) const;
+
+        void rbt_right_rotate(link_type x, link_type &rt) const;
 
-        void rbt_right_rotate(link_type x);
+        void rbt_insert_rebalance(link_type tar, link_type &rt) const;
 
         void rbt_destroy(link_type x);
 
@@ -621,11 +856,98 @@ namespace qmj {
 
         iterator rbt_insert_fixup(link_type tar);
 
-        const_iterator lower_bound_imple(const key_type &key) const;
+        template<typename K>
+        const_iterator lower_bound_imple(const K &key) const;
 
-        const_iterator upper_bound_imple(const key_type &key) const;
+        template<typename K>
+        const_iterator upper_bound_imple(const K &key) const;
 
-        const_iterator find_imple(const key_type &key) const;
+        template<typename K>
+        const_iterator find_imple(const K &key) const;
+
+        enum {
+            batch_width = 8,
+            max_height = 2 * sizeof(size_type) * 8
+        };
+
+        template<typename Iter, typename FIter, typename OIter>
+        OIter find_batch_imple(FIter first, FIter last, OIter dest) const {
+            //iterators, not pointers to *first: a proxy's key or a key of
+            //another type under a transparent comparator is a temporary
+            FIter keys[batch_width];
+            link_type cur[batch_width];
+            link_type result[batch_width];
+            while (first != last) {
+                size_type n = 0;
+                for (; n != batch_width && first != last; ++n, ++first) {
+                    keys[n] = first;
+                    cur[n] = get_root();
+                    result[n] = nil;
+                }
+                for (size_type active = n; active;) {
+                    active = 0;
+                    for (size_type i = 0; i != n; ++i) {
+                        link_type node = cur[i];
+                        if (node == nil)
+                            continue;
+                        if (comp(*keys[i], get_key(node->value)))
+                            node = node->left;
+                        else if (comp(get_key(node->value), *keys[i]))
+                            node = node->right;
+                        else {
+                            result[i] = node;
+                            node = nil;
+                        }
+                        cur[i] = node;
+                        if (node != nil) {
+                            _QMJ_PREFETCH(node);
+                            ++active;
+                        }
+                    }
+                }
+                for (size_type i = 0; i != n; ++i, ++dest)
+                    *dest = Iter(result[i]);
+            }
+            return (dest);
+        }
+
+        template<typename Iter, typename FIter, typename OIter>
+        OIter find_batch_sorted_imple(FIter first, FIter last, OIter dest) const {
+            link_type path[max_height];
+            link_type bound[max_height];
+            size_type depth = 0;
+            for (; first != last; ++first, ++dest) {
+                const key_type &key = *first;
+                while (depth && bound[depth - 1] != nil &&
+                       !comp(key, get_key(bound[depth - 1]->value)))
+                    --depth;
+                link_type cur = get_root();
+                link_type hi = nil;
+                if (depth) {
+                    --depth;
+                    cur = path[depth];
+                    hi = bound[depth];
+                }
+                link_type result = nil;
+                while (cur != nil) {
+                    path[depth] = cur;
+                    bound[depth++] = hi;
+                    _QMJ_PREFETCH(cur->left);
+                    _QMJ_PREFETCH(cur->right);
+                    if (comp(key, get_key(cur->value))) {
+                        hi = cur;
+                        cur = cur->left;
+                    } else if (comp(get_key(cur->value), key))
+                        cur = cur->right;
+                    else {
+                        result = cur;
+                        break;
+                    }
+                }
+                *dest = Iter(result);
+            }
+            return (dest);
+        }
 
         link_type copy_assign(link_type par, const link_type cur, const link_type nl) {
             link_type my = create_node(cur->color, par);
@@ -705,6 +1027,33 @@ namespace qmj {
             return {insert_imple(par, tar), true};
         }
 
+        //the parent a node with this key would be linked under, or the node
+        //holding the key when the tree is unique and exist is set
+        link_type insert_pos(const key_type &key, bool &exist) const {
+            link_type cur = get_root();
+            link_type par = nil;
+            exist = false;
+            while (cur != nil) {
+                par = cur;
+                if (comp(key, get_key(cur->value)))
+                    cur = cur->left;
+                else if (is_multi || comp(get_key(cur->value), key))
+                    cur = cur->right;
+                else {
+                    exist = true;
+                    break;
+                }
+            }
+            return (par);
+        }
+
+        iterator link_node(link_type par, link_type tar) {
+            tar->color = rbt_red;
+            tar->p = par;
+            tar->left = tar->right = nil;
+            return (insert_imple(par, tar));
+        }
+
         iterator insert_imple(link_type par, link_type tar) {
             if (par == nil)
                 root = tar;
@@ -734,6 +1083,312 @@ namespace qmj {
             return iterator(citer.get_node());
         }
 
+        enum {
+            rbt_union,
+            rbt_intersect,
+            rbt_difference,
+            fork_grain = 1 << 14
+        };
+
+        //subtrees cut loose by a set operation, chained through p
+        struct drop_list {
+            drop_list() : head(nullptr), tail(nullptr) {}
+
+            void push(link_type t) {
+                t->p = head;
+                head = t;
+                if (!tail)
+                    tail = t;
+            }
+
+            void splice(const drop_list &x) {
+                if (x.head) {
+                    x.tail->p = head;
+                    head = x.head;
+                    if (!tail)
+                        tail = x.tail;
+                }
+            }
+
+            link_type head;
+            link_type tail;
+        };
+
+        //black nodes on a path from t down to nil, nil itself not counted
+        int black_height(link_type t) const {
+            int h = 0;
+            for (; t != nil; t = t->left)
+                if (t->color)
+                    ++h;
+            return (h);
+        }
+
+        int child_height(link_type t, int h) const { return (t->color ? h - 1 : h); }
+
+        //points the nil children of the subtree t at to, returns its size
+        size_type rbt_relink(link_type t, link_type from, link_type to) const {
+            size_type n = 1;
+            if (t->left == from)
+                t->left = to;
+            else
+                n += rbt_relink(t->left, from, to);
+            if (t->right == from)
+                t->right = to;
+            else
+                n += rbt_relink(t->right, from, to);
+            return (n);
+        }
+
+        size_type rbt_destroy_count(link_type x) {
+            size_type n = 1;
+            if (x->left != nil)
+                n += rbt_destroy_count(x->left);
+            if (x->right != nil)
+                n += rbt_destroy_count(x->right);
+            destroy_and_free_node(x);
+            return (n);
+        }
+
+        //takes every node of x, which is left empty, and returns its root;
+        //the nodes of the smaller tree are relinked so both share this->nil
+        link_type adopt_nodes(self &x) {
+            link_type t = x.get_root();
+            if (t != x.nil) {
+                if (node_count < x.node_count) {
+                    if (get_root() != nil) {
+                        rbt_relink(get_root(), nil, x.nil);
+                        get_root()->p = x.nil;
+                    } else
+                        root = x.nil;
+                    std::swap(nil, x.nil);
+                } else {
+                    rbt_relink(t, x.nil, nil);
+                    t->p = nil;
+                }
+            } else
+                t = nil;
+            x.root = x.nil;
+            x.nil->left = x.nil->right = x.nil;
+            x.nil->p = nullptr;
+            x.node_count = 0;
+            return (t);
+        }
+
+        void reset_root(link_type t) {
+            root = t;
+            nil->p = nullptr;
+            if (t != nil) {
+                t->p = nil;
+                t->color = rbt_black;
+                nil->left = maximum(t);
+                nil->right = minimum(t);
+            } else
+                nil->left = nil->right = nil;
+        }
+
+        void set_operation(int op, self &other, int depth) {
+            if (this == &other) {
+                if (op == rbt_difference)
+                    clear();
+                return;
+            }
+            size_type n = node_count + other.node_count;
+            link_type t2 = adopt_nodes(other);
+            drop_list drop;
+            int h;
+            link_type t = set_operation_imple(op, get_root(), black_height(get_root()),
+                                              t2, black_height(t2), h, depth, drop);
+            for (link_type x = drop.head, next; x; x = next) {
+                next = x->p;
+                n -= rbt_destroy_count(x);
+            }
+            node_count = n;
+            reset_root(t);
+        }
+
+        //l < k < r, the result is black rooted with black height h; k is
+        //hung on the spine of the taller tree where the heights match and
+        //the insert fixup repairs the red violation this may cause
+        link_type join_imple(link_type l, int lh, link_type k, link_type r, int rh, int &h) const {
+            if (l != nil) {
+                l->p = nil;
+                if (!l->color) {
+                    l->color = rbt_black;
+                    ++lh;
+                }
+            }
+            if (r != nil) {
+                r->p = nil;
+                if (!r->color) {
+                    r->color = rbt_black;
+                    ++rh;
+                }
+            }
+            if (lh == rh) {
+                k->color = rbt_black;
+                k->p = nil;
+                k->left = l;
+                k->right = r;
+                if (l != nil)
+                    l->p = k;
+                if (r != nil)
+                    r->p = k;
+                h = lh + 1;
+                return (k);
+            }
+            link_type rt, par = nil, cur;
+            int ch;
+            k->color = rbt_red;
+            if (lh > rh) {
+                rt = l;
+                for (cur = l, ch = lh; !(cur->color && ch == rh); cur = cur->right) {
+                    ch = child_height(cur, ch);
+                    par = cur;
+                }
+                par->right = k;
+                k->left = cur;
+                k->right = r;
+                h = lh;
+            } else {
+                rt = r;
+                for (cur = r, ch = rh; !(cur->color && ch == lh); cur = cur->left) {
+                    ch = child_height(cur, ch);
+                    par = cur;
+                }
+                par->left = k;
+                k->left = l;
+                k->right = cur;
+                h = rh;
+            }
+            k->p = par;
+            if (k->left != nil)
+                k->left->p = k;
+            if (k->right != nil)
+                k->right->p = k;
+            rbt_insert_rebalance(k, rt);
+            if (!rt->color) {
+                rt->color = rbt_black;
+                ++h;
+            }
+            return (rt);
+        }
+
+        link_type join2_imple(link_type l, int lh, link_type r, int rh, int &h) const {
+            if (l == nil) {
+                h = rh;
+                return (r);
+            } else if (r == nil) {
+                h = lh;
+                return (l);
+            }
+            link_type rest;
+            int resth;
+            link_type k = split_last(l, lh, rest, resth);
+            return (join_imple(rest, resth, k, r, rh, h));
+        }
+
+        //detaches the largest node of t, rest holds what remains
+        link_type split_last(link_type t, int th, link_type &rest, int &resth) const {
+            int ch = child_height(t, th);
+            if (t->right == nil) {
+                rest = t->left;
+                resth = ch;
+                return (t);
+            }
+            link_type r;
+            int rh;
+            link_type k = split_last(t->right, ch, r, rh);
+            rest = join_imple(t->left, ch, t, r, rh, resth);
+            return (k);
+        }
+
+        //l gets the keys less than key; if extract, a node equal to key is
+        //returned apart from both sides, otherwise it goes to r with the rest
+        link_type split_imple(link_type t, int th, const key_type &key, bool extract,
+                              link_type &l, int &lh, link_type &r, int &rh) const {
+            if (t == nil) {
+                l = r = nil;
+                lh = rh = 0;
+                return (nil);
+            }
+            int ch = child_height(t, th);
+            link_type found, m;
+            int mh;
+            if (comp(get_key(t->value), key)) {
+                found = split_imple(t->right, ch, key, extract, m, mh, r, rh);
+                l = join_imple(t->left, ch, t, m, mh, lh);
+            } else if (!extract || comp(key, get_key(t->value))) {
+                found = split_imple(t->left, ch, key, extract, l, lh, m, mh);
+                r = join_imple(m, mh, t, t->right, ch, rh);
+            } else {
+                l = t->left;
+                r = t->right;
+                lh = rh = ch;
+                if (l != nil)
+                    l->p = nil;
+                if (r != nil)
+                    r->p = nil;
+                t->left = t->right = nil;
+                found = t;
+            }
+            return (found);
+        }
+
+        link_type set_operation_imple(int op, link_type t1, int h1, link_type t2, int h2,
+                                      int &h, int depth, drop_list &drop) const {
+            if (t1 == nil || t2 == nil) {
+                link_type keep = nil;
+                if (op == rbt_union)
+                    keep = t1 == nil ? t2 : t1;
+                else if (op == rbt_difference)
+                    keep = t1;
+                link_type lost = keep == t1 ? t2 : t1;
+                if (lost != nil)
+                    drop.push(lost);
+                h = keep == t1 ? h1 : h2;
+                return (keep);
+            }
+            //the difference cuts t1 by the root of t2, the others t2 by t1
+            link_type k, l1, r1, l2, r2, found;
+            int kh, l1h, r1h, l2h, r2h;
+            if (op == rbt_difference) {
+                k = t2;
+                kh = child_height(t2, h2);
+                l2 = t2->left;
+                r2 = t2->right;
+                l2h = r2h = kh;
+                found = split_imple(t1, h1, get_key(k->value), true, l1, l1h, r1, r1h);
+            } else {
+                k = t1;
+                kh = child_height(t1, h1);
+                l1 = t1->left;
+                r1 = t1->right;
+                l1h = r1h = kh;
+                found = split_imple(t2, h2, get_key(k->value), true, l2, l2h, r2, r2h);
+            }
+            link_type l, r;
+            int lh, rh;
+            if (depth > 0) {
+                drop_list left_drop;
+                fork_join([&] { l = set_operation_imple(op, l1, l1h, l2, l2h, lh, depth - 1, left_drop); },
+                          [&] { r = set_operation_imple(op, r1, r1h, r2, r2h, rh, depth - 1, drop); });
+                drop.splice(left_drop);
+            } else {
+                l = set_operation_imple(op, l1, l1h, l2, l2h, lh, 0, drop);
+                r = set_operation_imple(op, r1, r1h, r2, r2h, rh, 0, drop);
+            }
+            if (op == rbt_union || (op == rbt_intersect && found != nil)) {
+                if (found != nil)
+                    drop.push(found);
+                return (join_imple(l, lh, k, r, rh, h));
+            }
+            if (found != nil)
+                drop.push(found);
+            k->left = k->right = nil;
+            drop.push(k);
+            return (join2_imple(l, lh, r, rh, h));
+        }
+
     private:
         link_type nil;
         link_type root;
@@ -751,7 +1406,8 @@ namespace qmj {
     }
 
     template<typename traits>
-    typename rb_tree<traits>::const_iterator rb_tree<traits>::lower_bound_imple(const key_type &key) const {
+    template<typename K>
+    typename rb_tree<traits>::const_iterator rb_tree<traits>::lower_bound_imple(const K &key) const {
         auto cur = get_root();
         auto result = cur;
         while (cur != nil) {
@@ -770,7 +1426,8 @@ namespace qmj {
     }
 
     template<typename traits>
-    typename rb_tree<traits>::const_iterator rb_tree<traits>::upper_bound_imple(const key_type &key) const {
+    template<typename K>
+    typename rb_tree<traits>::const_iterator rb_tree<traits>::upper_bound_imple(const K &key) const {
         link_type cur = get_root();
         link_type result = cur;
         while (cur != nil) {
@@ -789,7 +1446,8 @@ namespace qmj {
     }
 
     template<typename traits>
-    typename rb_tree<traits>::const_iterator rb_tree<traits>::find_imple(const key_type &key) const {
+    template<typename K>
+    typename rb_tree<traits>::const_iterator rb_tree<traits>::find_imple(const K &key) const {
         link_type cur = get_root();
         while (cur != nil) {
             if (comp(key, get_key(cur->value)))
@@ -804,10 +1462,17 @@ namespace qmj {
 
     template<typename traits>
     typename rb_tree<traits>::iterator rb_tree<traits>::rbt_insert_fixup(link_type tar) {
-        iterator iter = iterator(tar);
+        rbt_insert_rebalance(tar, root);
+        root->color = rbt_black;
+        ++node_count;
+        return (iterator(tar));
+    }
+
+    template<typename traits>
+    void rb_tree<traits>::rbt_insert_rebalance(link_type tar, link_type &rt) const {
         while (!tar->p->color) {
             auto grandpar = tar->p->p;
-            if (tar->p == grandpar->p) {
+            if (tar->p == grandpar->left) {
                 if (!grandpar->right->color) {
                     grandpar->left->color = rbt_black;
                     grandpar->right->color = rbt_black;
@@ -815,12 +1480,12 @@ namespace qmj {
                     tar = grandpar;
                 } else {
                     if (tar == tar->p->right) {
-                        rbt_left_rotate(tar->p);
+                        rbt_left_rotate(tar->p, rt);
                         tar = tar->left;
                     }
                     grandpar->color = rbt_red;
                     grandpar->left->color = rbt_black;
-                    rbt_right_rotate(grandpar);
+                    rbt_right_rotate(grandpar, rt);
                 }
             } else {
                 if (!grandpar->left->color) {
@@ -830,24 +1495,19 @@ namespace qmj {
                     tar = grandpar;
                 } else {
                     if (tar == tar->p->left) {
-                        rbt_right_rotate(tar->p);
+                        rbt_right_rotate(tar->p, rt);
                         tar = tar->right;
                     }
                     grandpar->color = rbt_red;
                     grandpar->right->color = rbt_black;
-                    rbt_left_rotate(grandpar);
+                    rbt_left_rotate(grandpar, rt);
                 }
             }
         }
-        root->color = rbt_black;
-        ++node_count;
-        return (iter);
     }
 
     template<typename traits>
-    void rb_tree<traits>::rbt_delete(link_type tar) {
-        if (tar == nil)
-            return;
+    void rb_tree<traits>::rbt_unlink(link_type tar) {
         link_type y = tar;
         rbt_color_type y_original_color = y->color;
         link_type x;
@@ -877,7 +1537,6 @@ namespace qmj {
         if (y_original_color)
             rbt_delete_fixup(x);
         nil->p = nullptr;
-        destroy_and_free_node(tar);
     }
 
     template<typename traits>
@@ -941,7 +1600,7 @@ namespace qmj {
     }
 
     template<typename traits>
-    void rb_tree<traits>::rbt_left_rotate(link_type x) {
+    void rb_tree<traits>::rbt_left_rotate(link_type x, link_type &rt) const {
         auto xRight = x->right;
         xRight->p = x->p;
 
@@ -950,7 +1609,7 @@ namespace qmj {
         x->right = xRight->left;
 
         if (x->p == nil)
-            root = xRight;
+            rt = xRight;
         else if (x->p->left == x)
             x->p->left = xRight;
         else
@@ -960,7 +1619,7 @@ namespace qmj {
     }
 
     template<typename traits>
-    void rb_tree<traits>::rbt_right_rotate(link_type x) {
+    void rb_tree<traits>::rbt_right_rotate(link_type x, link_type &rt) const {
         auto xLeft = x->left;
         xLeft->p = x->p;
 
@@ -969,7 +1628,7 @@ namespace qmj {
         x->left = xLeft->right;
 
         if (x->p == nil)
-            root = xLeft;
+            rt = xLeft;
         else if (x->p->left == x)
             x->p->left = xLeft;
         else
@@ -0,0 +1,198 @@
+#pragma once
+#ifndef _SEARCHER_QMJ_
+#define _SEARCHER_QMJ_
+
+#include <cstdint>
+#include <utility>
+#include "algorithm_qmj.h"
+#include "flat_hash_map_qmj.h"
+#include "vector_qmj.h"
+
+namespace qmj {
+    //a searcher prepares its needle once and is handed to
+    //qmj::search(first, last, searcher) for any number of haystacks; each
+    //returns where the first match begins and ends, (last, last) if none
+
+    //the engine of qmj::search: integer keys in contiguous storage go
+    //through the vector filter, so this is the one to use for byte text
+    template<typename FIter, typename Pred = std::equal_to<>>
+    class default_searcher {
+    public:
+        default_searcher(FIter first, FIter last, const Pred &pred = Pred())
+                : first(first), last(last), pred(pred) {
+        }
+
+        template<typename FIter2>
+        std::pair<FIter2, FIter2> operator()(FIter2 hay_first, FIter2 hay_last) const {
+            FIter2 pos = _QMJ search(hay_first, hay_last, first, last, pred);
+            if (pos == hay_last)
+                return (std::pair<FIter2, FIter2>(hay_last, hay_last));
+            FIter2 end = pos;
+            for (FIter cur = first; cur != last; ++cur)
+                ++end;
+            return (std::pair<FIter2, FIter2>(pos, end));
+        }
+
+    private:
+        FIter first;
+        FIter last;
+        Pred pred;
+    };
+
+    //how far the needle may move for the haystack key under its last
+    //position: m - 1 - i for the last i < m - 1 holding that key, m for a
+    //key the needle does not hold. byte keys compared with == index an
+    //array, others look the shift up by Hash and Pred
+    template<typename key_type, typename Dif, typename Hash, typename Pred,
+            bool = std::is_integral<key_type>::value && sizeof(key_type) == 1 &&
+                   (is_same<Pred, std::equal_to<>>::value || is_same<Pred, std::equal_to<key_type>>::value)>
+    class _searcher_skip_table {
+    public:
+        _searcher_skip_table(const Dif m, const Hash &hf, const Pred &pred)
+                : table(size_t(m), hf, pred), miss(m) {
+        }
+
+        void set(const key_type &key, const Dif shift) {
+            table[key] = shift;
+        }
+
+        Dif operator[](const key_type &key) const {
+            typename flat_hash_map<key_type, Dif, Hash, Pred>::const_iterator iter = table.find(key);
+            return (iter == table.end() ? miss : iter->second);
+        }
+
+    private:
+        flat_hash_map<key_type, Dif, Hash, Pred> table;
+        Dif miss;
+    };
+
+    template<typename key_type, typename Dif, typename Hash, typename Pred>
+    class _searcher_skip_table<key_type, Dif, Hash, Pred, true> {
+    public:
+        _searcher_skip_table(const Dif m, const Hash &, const Pred &) {
+            for (int c = 0; c != 256; ++c)
+                table[c] = m;
+        }
+
+        void set(const key_type &key, const Dif shift) {
+            table[uint8_t(key)] = shift;
+        }
+
+        Dif operator[](const key_type &key) const {
+            return (table[uint8_t(key)]);
+        }
+
+    private:
+        Dif table[256];
+    };
+
+    template<typename RIter, typename Hash, typename Pred>
+    inline _searcher_skip_table<typename std::remove_cv<iter_val_t<RIter>>::type, iter_dif_t<RIter>, Hash, Pred>
+    _make_skip_table(RIter first, const iter_dif_t<RIter> m, const Hash &hf, const Pred &pred) {
+        _searcher_skip_table<typename std::remove_cv<iter_val_t<RIter>>::type, iter_dif_t<RIter>, Hash, Pred>
+                table(m, hf, pred);
+        for (iter_dif_t<RIter> i = 0; i < m - 1; ++i)
+            table.set(first[i], m - 1 - i);
+        return (table);
+    }
+
+    //compares from the needle's end and moves by the skip of the key under
+    //it; sublinear on average, but m keys a position on periodic input
+    template<typename RIter, typename Hash = qmj::hash<typename std::remove_cv<iter_val_t<RIter>>::type>,
+            typename Pred = std::equal_to<>>
+    class boyer_moore_horspool_searcher {
+    public:
+        typedef iter_dif_t<RIter> difference_type;
+
+        boyer_moore_horspool_searcher(RIter first, RIter last, const Hash &hf = Hash(), const Pred &pred = Pred())
+                : first(first), m(last - first), pred(pred),
+                  skip(_QMJ _make_skip_table(first, last - first, hf, pred)) {
+        }
+
+        template<typename RIter2>
+        std::pair<RIter2, RIter2> operator()(RIter2 hay_first, RIter2 hay_last) const {
+            const difference_type n = hay_last - hay_first;
+            if (!m)
+                return (std::pair<RIter2, RIter2>(hay_first, hay_first));
+            for (difference_type pos = 0; pos <= n - m;) {
+                const auto &key = hay_first[pos + m - 1];
+                difference_type i = m - 1;
+                for (; pred(hay_first[pos + i], first[i]); --i)
+                    if (!i)
+                        return (std::pair<RIter2, RIter2>(hay_first + pos, hay_first + pos + m));
+                pos += skip[key];
+            }
+            return (std::pair<RIter2, RIter2>(hay_last, hay_last));
+        }
+
+    private:
+        RIter first;
+        difference_type m;
+        Pred pred;
+        _searcher_skip_table<typename std::remove_cv<iter_val_t<RIter>>::type, difference_type, Hash, Pred> skip;
+    };
+
+    //horspool's skip together with the good suffix rule: after matching a
+    //suffix of the needle it moves to the next place that suffix recurs
+    template<typename RIter, typename Hash = qmj::hash<typename std::remove_cv<iter_val_t<RIter>>::type>,
+            typename Pred = std::equal_to<>>
+    class boyer_moore_searcher {
+    public:
+        typedef iter_dif_t<RIter> difference_type;
+
+        boyer_moore_searcher(RIter first, RIter last, const Hash &hf = Hash(), const Pred &pred = Pred())
+                : first(first), m(last - first), pred(pred),
+                  skip(_QMJ _make_skip_table(first, last - first, hf, pred)), good_suffix(size_t(m), m) {
+            if (!m)
+                return;
+            //suffix[i] is the length of the longest suffix of the needle
+            //that also ends at i
+            vector<difference_type> suffix(size_t(m), m);
+            difference_type f = m - 1, g = m - 1;
+            for (difference_type i = m - 2; i >= 0; --i) {
+                if (i > g && suffix[size_t(i + m - 1 - f)] < i - g)
+                    suffix[size_t(i)] = suffix[size_t(i + m - 1 - f)];
+                else {
+                    if (i < g)
+                        g = i;
+                    f = i;
+                    for (; g >= 0 && pred(first[g], first[g + m - 1 - f]); --g);
+                    suffix[size_t(i)] = f - g;
+                }
+            }
+            for (difference_type i = m - 1, j = 0; i >= 0; --i)
+                if (suffix[size_t(i)] == i + 1)
+                    for (; j < m - 1 - i; ++j)
+                        if (good_suffix[size_t(j)] == m)
+                            good_suffix[size_t(j)] = m - 1 - i;
+            for (difference_type i = 0; i <= m - 2; ++i)
+                good_suffix[size_t(m - 1 - suffix[size_t(i)])] = m - 1 - i;
+        }
+
+        template<typename RIter2>
+        std::pair<RIter2, RIter2> operator()(RIter2 hay_first, RIter2 hay_last) const {
+            const difference_type n = hay_last - hay_first;
+            if (!m)
+                return (std::pair<RIter2, RIter2>(hay_first, hay_first));
+            for (difference_type pos = 0; pos <= n - m;) {
+                difference_type i = m - 1;
+                for (; i >= 0 && pred(hay_first[pos + i], first[i]); --i);
+                if (i < 0)
+                    return (std::pair<RIter2, RIter2>(hay_first + pos, hay_first + pos + m));
+                const difference_type bad = skip[hay_first[pos + i]] - (m - 1 - i);
+                const difference_type good = good_suffix[size_t(i)];
+                pos += good > bad ? good : bad;
+            }
+            return (std::pair<RIter2, RIter2>(hay_last, hay_last));
+        }
+
+    private:
+        RIter first;
+        difference_type m;
+        Pred pred;
+        _searcher_skip_table<typename std::remove_cv<iter_val_t<RIter>>::type, difference_type, Hash, Pred> skip;
+        vector<difference_type> good_suffix;
+    };
+}
+
+#endif //_SEARCHER_QMJ_
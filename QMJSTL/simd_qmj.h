@@ -0,0 +1,877 @@
+#pragma once
+#ifndef _SIMD_QMJ_
+#define _SIMD_QMJ_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include "type_traits_qmj.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define _QMJ_SIMD_X86 1
+#include <immintrin.h>
+#define _QMJ_SSE2 __attribute__((target("sse2")))
+#define _QMJ_AVX2 __attribute__((target("avx2,popcnt")))
+#define _QMJ_AVX512 __attribute__((target("avx512f,avx2,popcnt")))
+#else
+#define _QMJ_SIMD_X86 0
+#endif
+
+namespace qmj {
+    //instruction sets the vector kernels are built for, in increasing order
+    enum simd_level {
+        simd_scalar = 0,
+        simd_sse2 = 1,
+        simd_avx2 = 2,
+        simd_avx512 = 3
+    };
+
+    inline simd_level _detect_simd_level() {
+#if _QMJ_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt"))
+            return (simd_avx512);
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+            return (simd_avx2);
+        if (__builtin_cpu_supports("sse2"))
+            return (simd_sse2);
+#endif
+        return (simd_scalar);
+    }
+
+    //the best level this cpu runs, looked up once
+    inline simd_level cpu_simd_level() {
+        static const simd_level level = _detect_simd_level();
+        return (level);
+    }
+
+    inline std::atomic<int> &_simd_level_cap() {
+        static std::atomic<int> cap(simd_avx512);
+        return (cap);
+    }
+
+    //caps the level the kernels dispatch to, so every path, the scalar one
+    //included, can be run on a single machine
+    inline void set_simd_level(const simd_level level) {
+        _simd_level_cap().store(level, std::memory_order_relaxed);
+    }
+
+    inline simd_level simd_dispatch_level() {
+        const int cap = _simd_level_cap().load(std::memory_order_relaxed);
+        const simd_level level = cpu_simd_level();
+        return (cap < level ? simd_level(cap) : level);
+    }
+
+    //element types the sort kernels handle: 32 and 64-bit signed integers,
+    //float and double
+    template<typename T>
+    struct is_simd_sortable : bool_type<(std::is_integral<T>::value && std::is_signed<T>::value &&
+                                         (sizeof(T) == 4 || sizeof(T) == 8)) ||
+                                        std::is_same<T, float>::value || std::is_same<T, double>::value> {
+    };
+
+    //blocks up to this size are sorted by one sorting network
+    constexpr size_t simd_network_size = 32;
+
+    template<typename T, bool Desc>
+    inline bool _simd_before(const T &x, const T &pivot) {
+        return (Desc ? pivot < x : x < pivot);
+    }
+
+    //the value a network pads a short block with, it sorts after everything
+    template<typename T, bool Desc>
+    inline T _simd_pad() {
+        typedef std::numeric_limits<T> limits;
+        if (limits::has_infinity)
+            return (Desc ? -limits::infinity() : limits::infinity());
+        return (Desc ? limits::lowest() : limits::max());
+    }
+
+    //moves the elements that go before pivot to the front and returns where
+    //they end
+    template<typename T, bool Desc>
+    inline T *_scalar_partition(T *first, T *last, const T pivot) {
+        for (;; ++first) {
+            while (first != last && _simd_before<T, Desc>(*first, pivot))
+                ++first;
+            while (first != last && !_simd_before<T, Desc>(*(last - 1), pivot))
+                --last;
+            if (first == last)
+                return (first);
+            std::swap(*first, *--last);
+        }
+    }
+
+    //the vector partitions keep the first and last vector aside and read
+    //next from whichever end has less room written back, so both ends
+    //always have a vector of room; what is left when fewer than a vector
+    //stays unread goes through here with the two kept vectors
+    template<typename T, bool Desc>
+    inline T *_simd_partition_tail(T *lw, T *rw, const T *rest, const size_t n, const T pivot) {
+        for (size_t i = 0; i != n; ++i)
+            if (_simd_before<T, Desc>(rest[i], pivot))
+                *lw++ = rest[i];
+            else
+                *--rw = rest[i];
+        return (lw);
+    }
+
+    //a substring search that has compared more keys than this for what it
+    //scanned gives up and says where, which keeps a needle full of near
+    //misses from going quadratic; the caller goes on with a linear search
+    inline bool _search_budget_spent(const size_t work, const size_t scanned) {
+        return (work > 8 * scanned + 4096);
+    }
+
+#if _QMJ_SIMD_X86
+    //lane orders shared by the avx2 kernels. compress[m] holds, four bits a
+    //lane, the order that brings the lanes whose bit in m is clear to the
+    //front; swap[j] pairs lane i with i ^ (1 << j) and upper[j] marks the
+    //lanes with bit j set, both for the sorting network
+    struct _avx2_tables {
+        _avx2_tables() {
+            for (int m = 0; m != 256; ++m) {
+                uint32_t order = 0;
+                int pos = 0;
+                for (int side = 0; side != 2; ++side)
+                    for (int i = 0; i != 8; ++i)
+                        if (((m >> i) & 1) == side)
+                            order |= uint32_t(i) << (4 * pos++);
+                compress[m] = order;
+            }
+            for (int j = 0; j != 3; ++j)
+                for (int i = 0; i != 8; ++i) {
+                    swap[j][i] = i ^ (1 << j);
+                    upper[j][i] = (i >> j) & 1 ? -1 : 0;
+                }
+        }
+
+        static const _avx2_tables &get() {
+            static const _avx2_tables tables;
+            return (tables);
+        }
+
+        alignas(32) int32_t swap[3][8];
+        alignas(32) int32_t upper[3][8];
+        uint32_t compress[256];
+    };
+
+    //with four lanes a vector the 64-bit keys gained nothing over the
+    //scalar block partition, so avx2 only runs the 32-bit ones
+    template<typename T, bool = std::is_floating_point<T>::value>
+    struct _avx2_ops;
+
+    template<typename T>
+    struct _avx2_ops<T, false> {
+        typedef __m256i vec;
+        enum {
+            lanes = 8
+        };
+
+        _QMJ_AVX2 static vec load(const T *p) { return (_mm256_loadu_si256((const __m256i *) p)); }
+
+        _QMJ_AVX2 static void store(T *p, const vec v) { _mm256_storeu_si256((__m256i *) p, v); }
+
+        _QMJ_AVX2 static vec set1(const T x) { return (_mm256_set1_epi32(x)); }
+
+        _QMJ_AVX2 static __m256i less(const vec a, const vec b) { return (_mm256_cmpgt_epi32(b, a)); }
+
+        _QMJ_AVX2 static vec blend(const vec a, const vec b, const __m256i m) {
+            return (_mm256_blendv_epi8(a, b, m));
+        }
+
+        _QMJ_AVX2 static vec permute(const vec v, const __m256i idx) { return (_mm256_permutevar8x32_epi32(v, idx)); }
+
+        _QMJ_AVX2 static int movemask(const __m256i m) { return (_mm256_movemask_ps(_mm256_castsi256_ps(m))); }
+    };
+
+    template<>
+    struct _avx2_ops<float, true> {
+        typedef __m256 vec;
+        enum {
+            lanes = 8
+        };
+
+        _QMJ_AVX2 static vec load(const float *p) { return (_mm256_loadu_ps(p)); }
+
+        _QMJ_AVX2 static void store(float *p, const vec v) { _mm256_storeu_ps(p, v); }
+
+        _QMJ_AVX2 static vec set1(const float x) { return (_mm256_set1_ps(x)); }
+
+        _QMJ_AVX2 static __m256i less(const vec a, const vec b) {
+            return (_mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)));
+        }
+
+        _QMJ_AVX2 static vec blend(const vec a, const vec b, const __m256i m) {
+            return (_mm256_blendv_ps(a, b, _mm256_castsi256_ps(m)));
+        }
+
+        _QMJ_AVX2 static vec permute(const vec v, const __m256i idx) { return (_mm256_permutevar8x32_ps(v, idx)); }
+
+        _QMJ_AVX2 static int movemask(const __m256i m) { return (_mm256_movemask_ps(_mm256_castsi256_ps(m))); }
+    };
+
+    //each vector read is permuted once so the lanes that go before pivot
+    //lead and the rest trail, then stored whole at both write ends: the
+    //left write end moves past the leading lanes, the right one back over
+    //the trailing lanes, and the lanes past either end are overwritten later
+    template<typename T, bool Desc>
+    _QMJ_AVX2 inline T *_avx2_partition(T *first, T *last, const T pivot, true_type) {
+        typedef _avx2_ops<T> ops;
+        typedef typename ops::vec vec;
+        const ptrdiff_t lanes = ops::lanes;
+        if (last - first < 2 * lanes)
+            return (_scalar_partition<T, Desc>(first, last, pivot));
+        const uint32_t *compress = _avx2_tables::get().compress;
+        const __m256i shift = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+        const __m256i nibble = _mm256_set1_epi32(15);
+        const int all = (1 << lanes) - 1;
+        const vec pv = ops::set1(pivot);
+        T rest[3 * ops::lanes];
+        ops::store(rest, ops::load(first));
+        ops::store(rest + lanes, ops::load(last - lanes));
+        T *lr = first + lanes, *rr = last - lanes;
+        T *lw = first, *rw = last;
+        while (rr - lr >= lanes) {
+            vec v;
+            if (lr - lw <= rw - rr) {
+                v = ops::load(lr);
+                lr += lanes;
+            } else {
+                rr -= lanes;
+                v = ops::load(rr);
+            }
+            const int left = ops::movemask(Desc ? ops::less(pv, v) : ops::less(v, pv));
+            const __m256i order = _mm256_set1_epi32(int(compress[~left & all]));
+            v = ops::permute(v, _mm256_and_si256(_mm256_srlv_epi32(order, shift), nibble));
+            ops::store(lw, v);
+            ops::store(rw - lanes, v);
+            const int n = __builtin_popcount(left);
+            lw += n;
+            rw -= lanes - n;
+        }
+        std::memcpy(rest + 2 * lanes, lr, (rr - lr) * sizeof(T));
+        return (_simd_partition_tail<T, Desc>(lw, rw, rest, size_t(2 * lanes + (rr - lr)), pivot));
+    }
+
+    //bitonic sort of one block held in simd_network_size / lanes vectors.
+    //a compare-exchange decides "upper element is less" the same way in
+    //both lanes of a pair, so equal keys with different bits, 0.0 and -0.0,
+    //are swapped or kept together and never duplicated
+    template<typename T, bool Desc>
+    _QMJ_AVX2 inline bool _avx2_network_sort(T *first, const size_t n, true_type) {
+        typedef _avx2_ops<T> ops;
+        typedef typename ops::vec vec;
+        const int lanes = ops::lanes;
+        const int count = int(simd_network_size);
+        const int regs = count / lanes;
+        const _avx2_tables &tab = _avx2_tables::get();
+        alignas(32) T buf[simd_network_size];
+        std::memcpy(buf, first, n * sizeof(T));
+        for (size_t i = n; i != simd_network_size; ++i)
+            buf[i] = _simd_pad<T, Desc>();
+        vec r[simd_network_size / ops::lanes];
+        for (int a = 0; a != regs; ++a)
+            r[a] = ops::load(buf + a * lanes);
+        const __m256i ones = _mm256_set1_epi32(-1);
+        const __m256i zero = _mm256_setzero_si256();
+        for (int k = 2, lk = 1; k <= count; k <<= 1, ++lk)
+            for (int j = k >> 1, lj = lk - 1; j > 0; j >>= 1, --lj)
+                if (j >= lanes) {
+                    const int step = j / lanes;
+                    for (int a = 0; a != regs; ++a)
+                        if (!(a & step)) {
+                            vec &lo = r[a], &hi = r[a | step];
+                            const bool up = (((a * lanes) & k) == 0) != Desc;
+                            const __m256i s = up ? ops::less(hi, lo) : ops::less(lo, hi);
+                            const vec t = lo;
+                            lo = ops::blend(lo, hi, s);
+                            hi = ops::blend(hi, t, s);
+                        }
+                } else {
+                    const __m256i swap = _mm256_load_si256((const __m256i *) tab.swap[lj]);
+                    const __m256i upper = _mm256_load_si256((const __m256i *) tab.upper[lj]);
+                    for (int a = 0; a != regs; ++a) {
+                        __m256i down = k < lanes ? _mm256_load_si256((const __m256i *) tab.upper[lk])
+                                                 : ((a * lanes) & k ? ones : zero);
+                        if (Desc)
+                            down = _mm256_xor_si256(down, ones);
+                        const vec p = ops::permute(r[a], swap);
+                        const __m256i s = _mm256_blendv_epi8(ops::less(p, r[a]), ops::less(r[a], p), upper);
+                        r[a] = ops::blend(r[a], p, _mm256_xor_si256(s, down));
+                    }
+                }
+        for (int a = 0; a != regs; ++a)
+            ops::store(buf + a * lanes, r[a]);
+        std::memcpy(first, buf, n * sizeof(T));
+        return (true);
+    }
+
+    template<typename T, bool Desc>
+    inline T *_avx2_partition(T *first, T *last, const T pivot, false_type) {
+        return (_scalar_partition<T, Desc>(first, last, pivot));
+    }
+
+    template<typename T, bool Desc>
+    inline bool _avx2_network_sort(T *, size_t, false_type) {
+        return (false);
+    }
+
+    template<typename T, size_t = sizeof(T), bool = std::is_floating_point<T>::value>
+    struct _avx512_ops;
+
+    template<typename T>
+    struct _avx512_ops<T, 4, false> {
+        typedef __m512i vec;
+        enum {
+            lanes = 16
+        };
+
+        _QMJ_AVX512 static vec load(const T *p) { return (_mm512_loadu_si512(p)); }
+
+        _QMJ_AVX512 static void store(T *p, const vec v) { _mm512_storeu_si512(p, v); }
+
+        _QMJ_AVX512 static vec set1(const T x) { return (_mm512_set1_epi32(x)); }
+
+        _QMJ_AVX512 static unsigned less(const vec a, const vec b) { return (_mm512_cmplt_epi32_mask(a, b)); }
+
+        _QMJ_AVX512 static void compress(T *p, const unsigned m, const vec v) {
+            _mm512_mask_compressstoreu_epi32(p, __mmask16(m), v);
+        }
+    };
+
+    template<typename T>
+    struct _avx512_ops<T, 8, false> {
+        typedef __m512i vec;
+        enum {
+            lanes = 8
+        };
+
+        _QMJ_AVX512 static vec load(const T *p) { return (_mm512_loadu_si512(p)); }
+
+        _QMJ_AVX512 static void store(T *p, const vec v) { _mm512_storeu_si512(p, v); }
+
+        _QMJ_AVX512 static vec set1(const T x) { return (_mm512_set1_epi64(x)); }
+
+        _QMJ_AVX512 static unsigned less(const vec a, const vec b) { return (_mm512_cmplt_epi64_mask(a, b)); }
+
+        _QMJ_AVX512 static void compress(T *p, const unsigned m, const vec v) {
+            _mm512_mask_compressstoreu_epi64(p, __mmask8(m), v);
+        }
+    };
+
+    template<>
+    struct _avx512_ops<float, 4, true> {
+        typedef __m512 vec;
+        enum {
+            lanes = 16
+        };
+
+        _QMJ_AVX512 static vec load(const float *p) { return (_mm512_loadu_ps(p)); }
+
+        _QMJ_AVX512 static void store(float *p, const vec v) { _mm512_storeu_ps(p, v); }
+
+        _QMJ_AVX512 static vec set1(const float x) { return (_mm512_set1_ps(x)); }
+
+        _QMJ_AVX512 static unsigned less(const vec a, const vec b) { return (_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ)); }
+
+        _QMJ_AVX512 static void compress(float *p, const unsigned m, const vec v) {
+            _mm512_mask_compressstoreu_ps(p, __mmask16(m), v);
+        }
+    };
+
+    template<>
+    struct _avx512_ops<double, 8, true> {
+        typedef __m512d vec;
+        enum {
+            lanes = 8
+        };
+
+        _QMJ_AVX512 static vec load(const double *p) { return (_mm512_loadu_pd(p)); }
+
+        _QMJ_AVX512 static void store(double *p, const vec v) { _mm512_storeu_pd(p, v); }
+
+        _QMJ_AVX512 static vec set1(const double x) { return (_mm512_set1_pd(x)); }
+
+        _QMJ_AVX512 static unsigned less(const vec a, const vec b) { return (_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ)); }
+
+        _QMJ_AVX512 static void compress(double *p, const unsigned m, const vec v) {
+            _mm512_mask_compressstoreu_pd(p, __mmask8(m), v);
+        }
+    };
+
+    //same scheme as the avx2 partition, with the compressing stores doing
+    //the permute and writing only the lanes that belong at each end
+    template<typename T, bool Desc>
+    _QMJ_AVX512 inline T *_avx512_partition(T *first, T *last, const T pivot) {
+        typedef _avx512_ops<T> ops;
+        typedef typename ops::vec vec;
+        const ptrdiff_t lanes = ops::lanes;
+        if (last - first < 2 * lanes)
+            return (_scalar_partition<T, Desc>(first, last, pivot));
+        const unsigned all = (1u << lanes) - 1;
+        const vec pv = ops::set1(pivot);
+        T rest[3 * ops::lanes];
+        ops::store(rest, ops::load(first));
+        ops::store(rest + lanes, ops::load(last - lanes));
+        T *lr = first + lanes, *rr = last - lanes;
+        T *lw = first, *rw = last;
+        while (rr - lr >= lanes) {
+            vec v;
+            if (lr - lw <= rw - rr) {
+                v = ops::load(lr);
+                lr += lanes;
+            } else {
+                rr -= lanes;
+                v = ops::load(rr);
+            }
+            const unsigned left = Desc ? ops::less(pv, v) : ops::less(v, pv);
+            const int n = __builtin_popcount(left);
+            ops::compress(lw, left, v);
+            ops::compress(rw - (lanes - n), ~left & all, v);
+            lw += n;
+            rw -= lanes - n;
+        }
+        std::memcpy(rest + 2 * lanes, lr, (rr - lr) * sizeof(T));
+        return (_simd_partition_tail<T, Desc>(lw, rw, rest, size_t(2 * lanes + (rr - lr)), pivot));
+    }
+
+    //the scan kernels compare whole vectors of keys for equality and read
+    //the result back as one bit a byte, so a key of width w that matched
+    //shows as w set bits and its index is the bit index over w
+    template<size_t width>
+    struct _sse2_eq;
+
+    template<>
+    struct _sse2_eq<1> {
+        _QMJ_SSE2 static __m128i cmp(const __m128i a, const __m128i b) { return (_mm_cmpeq_epi8(a, b)); }
+
+        _QMJ_SSE2 static __m128i set1(const int64_t x) { return (_mm_set1_epi8(char(x))); }
+    };
+
+    template<>
+    struct _sse2_eq<2> {
+        _QMJ_SSE2 static __m128i cmp(const __m128i a, const __m128i b) { return (_mm_cmpeq_epi16(a, b)); }
+
+        _QMJ_SSE2 static __m128i set1(const int64_t x) { return (_mm_set1_epi16(short(x))); }
+    };
+
+    template<>
+    struct _sse2_eq<4> {
+        _QMJ_SSE2 static __m128i cmp(const __m128i a, const __m128i b) { return (_mm_cmpeq_epi32(a, b)); }
+
+        _QMJ_SSE2 static __m128i set1(const int64_t x) { return (_mm_set1_epi32(int(x))); }
+    };
+
+    //sse2 has no 64-bit compare: both 32-bit halves must match
+    template<>
+    struct _sse2_eq<8> {
+        _QMJ_SSE2 static __m128i cmp(const __m128i a, const __m128i b) {
+            const __m128i c = _mm_cmpeq_epi32(a, b);
+            return (_mm_and_si128(c, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 3, 0, 1))));
+        }
+
+        _QMJ_SSE2 static __m128i set1(const int64_t x) { return (_mm_set1_epi64x(x)); }
+    };
+
+    template<size_t width>
+    struct _avx2_eq;
+
+    template<>
+    struct _avx2_eq<1> {
+        _QMJ_AVX2 static __m256i cmp(const __m256i a, const __m256i b) { return (_mm256_cmpeq_epi8(a, b)); }
+
+        _QMJ_AVX2 static __m256i set1(const int64_t x) { return (_mm256_set1_epi8(char(x))); }
+    };
+
+    template<>
+    struct _avx2_eq<2> {
+        _QMJ_AVX2 static __m256i cmp(const __m256i a, const __m256i b) { return (_mm256_cmpeq_epi16(a, b)); }
+
+        _QMJ_AVX2 static __m256i set1(const int64_t x) { return (_mm256_set1_epi16(short(x))); }
+    };
+
+    template<>
+    struct _avx2_eq<4> {
+        _QMJ_AVX2 static __m256i cmp(const __m256i a, const __m256i b) { return (_mm256_cmpeq_epi32(a, b)); }
+
+        _QMJ_AVX2 static __m256i set1(const int64_t x) { return (_mm256_set1_epi32(int(x))); }
+    };
+
+    template<>
+    struct _avx2_eq<8> {
+        _QMJ_AVX2 static __m256i cmp(const __m256i a, const __m256i b) { return (_mm256_cmpeq_epi64(a, b)); }
+
+        _QMJ_AVX2 static __m256i set1(const int64_t x) { return (_mm256_set1_epi64x(x)); }
+    };
+
+    template<typename T>
+    _QMJ_SSE2 inline size_t _sse2_find(const T *p, const size_t n, const T val, const bool want) {
+        typedef _sse2_eq<sizeof(T)> eq;
+        const size_t lanes = 16 / sizeof(T);
+        const __m128i v = eq::set1(int64_t(val));
+        const uint32_t flip = want ? 0 : 0xffff;
+        size_t i = 0;
+        for (; i + lanes <= n; i += lanes) {
+            const uint32_t m = uint32_t(_mm_movemask_epi8(eq::cmp(_mm_loadu_si128((const __m128i *) (p + i)), v))) ^ flip;
+            if (m)
+                return (i + __builtin_ctz(m) / sizeof(T));
+        }
+        for (; i != n && (p[i] == val) != want; ++i);
+        return (i);
+    }
+
+    //the lanes that matched are subtracted, as -1, from per-byte counters
+    //that are folded into the total before they can wrap
+    template<typename T>
+    _QMJ_SSE2 inline size_t _sse2_count(const T *p, const size_t n, const T val) {
+        typedef _sse2_eq<sizeof(T)> eq;
+        const size_t lanes = 16 / sizeof(T);
+        const __m128i v = eq::set1(int64_t(val));
+        size_t i = 0, total = 0;
+        while (i + lanes <= n) {
+            __m128i acc = _mm_setzero_si128();
+            for (size_t round = 0; round != 255 && i + lanes <= n; ++round, i += lanes)
+                acc = _mm_sub_epi8(acc, eq::cmp(_mm_loadu_si128((const __m128i *) (p + i)), v));
+            const __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+            total += size_t(_mm_cvtsi128_si32(sums)) + size_t(_mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+        }
+        total /= sizeof(T);
+        for (; i != n; ++i)
+            total += p[i] == val;
+        return (total);
+    }
+
+    template<typename T>
+    _QMJ_SSE2 inline size_t _sse2_find_pair(const T *a, const T *b, const size_t n, const bool want) {
+        typedef _sse2_eq<sizeof(T)> eq;
+        const size_t lanes = 16 / sizeof(T);
+        const uint32_t flip = want ? 0 : 0xffff;
+        size_t i = 0;
+        for (; i + lanes <= n; i += lanes) {
+            const uint32_t m = uint32_t(_mm_movemask_epi8(eq::cmp(_mm_loadu_si128((const __m128i *) (a + i)),
+                                                                  _mm_loadu_si128((const __m128i *) (b + i))))) ^ flip;
+            if (m)
+                return (i + __builtin_ctz(m) / sizeof(T));
+        }
+        for (; i != n && (a[i] == b[i]) != want; ++i);
+        return (i);
+    }
+
+    //four vectors a step, tested together, before any mask is looked at
+    template<typename T>
+    _QMJ_AVX2 inline size_t _avx2_find(const T *p, const size_t n, const T val, const bool want) {
+        typedef _avx2_eq<sizeof(T)> eq;
+        const size_t lanes = 32 / sizeof(T);
+        const __m256i v = eq::set1(int64_t(val));
+        const __m256i flip = want ? _mm256_setzero_si256() : _mm256_set1_epi32(-1);
+        size_t i = 0;
+        for (; i + 4 * lanes <= n; i += 4 * lanes) {
+            const __m256i c0 = _mm256_xor_si256(eq::cmp(_mm256_loadu_si256((const __m256i *) (p + i)), v), flip);
+            const __m256i c1 = _mm256_xor_si256(eq::cmp(_mm256_loadu_si256((const __m256i *) (p + i + lanes)), v), flip);
+            const __m256i c2 = _mm256_xor_si256(eq::cmp(_mm256_loadu_si256((const __m256i *) (p + i + 2 * lanes)), v), flip);
+            const __m256i c3 = _mm256_xor_si256(eq::cmp(_mm256_loadu_si256((const __m256i *) (p + i + 3 * lanes)), v), flip);
+            const __m256i any = _mm256_or_si256(_mm256_or_si256(c0, c1), _mm256_or_si256(c2, c3));
+            if (!_mm256_testz_si256(any, any)) {
+                const uint64_t lo = uint32_t(_mm256_movemask_epi8(c0)) | uint64_t(uint32_t(_mm256_movemask_epi8(c1))) << 32;
+                if (lo)
+                    return (i + __builtin_ctzll(lo) / sizeof(T));
+                const uint64_t hi = uint32_t(_mm256_movemask_epi8(c2)) | uint64_t(uint32_t(_mm256_movemask_epi8(c3))) << 32;
+                return (i + 2 * lanes + __builtin_ctzll(hi) / sizeof(T));
+            }
+        }
+        for (; i + lanes <= n; i += lanes) {
+            const uint32_t m = uint32_t(_mm256_movemask_epi8(
+                    _mm256_xor_si256(eq::cmp(_mm256_loadu_si256((const __m256i *) (p + i)), v), flip)));
+            if (m)
+                return (i + __builtin_ctz(m) / sizeof(T));
+        }
+        for (; i != n && (p[i] == val) != want; ++i);
+        return (i);
+    }
+
+    template<typename T>
+    _QMJ_AVX2 inline size_t _avx2_count(const T *p, const size_t n, const T val) {
+        typedef _avx2_eq<sizeof(T)> eq;
+        const size_t lanes = 32 / sizeof(T);
+        const __m256i v = eq::set1(int64_t(val));
+        size_t i = 0, total = 0;
+        while (i + lanes <= n) {
+            __m256i acc = _mm256_setzero_si256();
+            for (size_t round = 0; round != 255 && i + lanes <= n; ++round, i += lanes)
+                acc = _mm256_sub_epi8(acc, eq::cmp(_mm256_loadu_si256((const __m256i *) (p + i)), v));
+            const __m256i sums = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+            total += size_t(_mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+                            _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3));
+        }
+        total /= sizeof(T);
+        for (; i != n; ++i)
+            total += p[i] == val;
+        return (total);
+    }
+
+    template<typename T>
+    _QMJ_AVX2 inline size_t _avx2_find_pair(const T *a, const T *b, const size_t n, const bool want) {
+        typedef _avx2_eq<sizeof(T)> eq;
+        const size_t lanes = 32 / sizeof(T);
+        const uint32_t flip = want ? 0 : 0xffffffffu;
+        size_t i = 0;
+        for (; i + lanes <= n; i += lanes) {
+            const uint32_t m = uint32_t(_mm256_movemask_epi8(eq::cmp(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                                                     _mm256_loadu_si256((const __m256i *) (b + i))))) ^ flip;
+            if (m)
+                return (i + __builtin_ctz(m) / sizeof(T));
+        }
+        for (; i != n && (a[i] == b[i]) != want; ++i);
+        return (i);
+    }
+
+    //the substring kernels keep a start only when both the needle's first
+    //and last keys are in place, then compare the keys between
+    template<typename T>
+    _QMJ_SSE2 inline size_t _sse2_search(const T *hay, const size_t n, const T *needle, const size_t m,
+                                         bool &matched) {
+        typedef _sse2_eq<sizeof(T)> eq;
+        const size_t lanes = 16 / sizeof(T), starts = n - m + 1;
+        const __m128i head = eq::set1(int64_t(needle[0])), tail = eq::set1(int64_t(needle[m - 1]));
+        size_t i = 0, work = 0;
+        for (; i + lanes <= starts; i += lanes) {
+            uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_and_si128(
+                    eq::cmp(_mm_loadu_si128((const __m128i *) (hay + i)), head),
+                    eq::cmp(_mm_loadu_si128((const __m128i *) (hay + i + m - 1)), tail))));
+            for (; mask; mask &= mask - 1) {
+                const size_t bit = __builtin_ctz(mask);
+                if (bit % sizeof(T))
+                    continue;
+                const size_t pos = i + bit / sizeof(T);
+                if (!std::memcmp(hay + pos + 1, needle + 1, (m - 2) * sizeof(T))) {
+                    matched = true;
+                    return (pos);
+                }
+                if (_search_budget_spent(work += m, i))
+                    return (pos + 1);
+            }
+        }
+        for (; i != starts; ++i)
+            if (hay[i] == needle[0] && hay[i + m - 1] == needle[m - 1] &&
+                !std::memcmp(hay + i + 1, needle + 1, (m - 2) * sizeof(T))) {
+                matched = true;
+                return (i);
+            }
+        return (n);
+    }
+
+    template<typename T>
+    _QMJ_AVX2 inline size_t _avx2_search(const T *hay, const size_t n, const T *needle, const size_t m,
+                                         bool &matched) {
+        typedef _avx2_eq<sizeof(T)> eq;
+        const size_t lanes = 32 / sizeof(T), starts = n - m + 1;
+        const __m256i head = eq::set1(int64_t(needle[0])), tail = eq::set1(int64_t(needle[m - 1]));
+        size_t i = 0, work = 0;
+        for (; i + lanes <= starts; i += lanes) {
+            uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_and_si256(
+                    eq::cmp(_mm256_loadu_si256((const __m256i *) (hay + i)), head),
+                    eq::cmp(_mm256_loadu_si256((const __m256i *) (hay + i + m - 1)), tail))));
+            for (; mask; mask &= mask - 1) {
+                const size_t bit = __builtin_ctz(mask);
+                if (bit % sizeof(T))
+                    continue;
+                const size_t pos = i + bit / sizeof(T);
+                if (!std::memcmp(hay + pos + 1, needle + 1, (m - 2) * sizeof(T))) {
+                    matched = true;
+                    return (pos);
+                }
+                if (_search_budget_spent(work += m, i))
+                    return (pos + 1);
+            }
+        }
+        for (; i != starts; ++i)
+            if (hay[i] == needle[0] && hay[i + m - 1] == needle[m - 1] &&
+                !std::memcmp(hay + i + 1, needle + 1, (m - 2) * sizeof(T))) {
+                matched = true;
+                return (i);
+            }
+        return (n);
+    }
+
+    //intersects sorted 4-byte keys a block of eight from each side at a
+    //time: rotating b's block through all lanes compares every pair, the
+    //keys of a that matched are packed to the front through the partition
+    //table, and the block whose last key comes first moves on. it stops
+    //where fewer than nine keys are left on a side, and at equal
+    //neighbours, which only a merge counts right
+    template<typename T, bool Desc, typename OIter>
+    _QMJ_AVX2 inline OIter _avx2_intersect(const T *&a, const T *a_end, const T *&b, const T *b_end, OIter dest) {
+        const uint32_t *compress = _avx2_tables::get().compress;
+        const __m256i shift = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+        const __m256i nibble = _mm256_set1_epi32(15);
+        const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+        T found[8];
+        while (a_end - a > 8 && b_end - b > 8) {
+            const __m256i va = _mm256_loadu_si256((const __m256i *) a);
+            const __m256i vb = _mm256_loadu_si256((const __m256i *) b);
+            const __m256i repeat = _mm256_or_si256(
+                    _mm256_cmpeq_epi32(va, _mm256_loadu_si256((const __m256i *) (a + 1))),
+                    _mm256_cmpeq_epi32(vb, _mm256_loadu_si256((const __m256i *) (b + 1))));
+            if (!_mm256_testz_si256(repeat, repeat))
+                break;
+            __m256i hit = _mm256_cmpeq_epi32(va, vb), rb = vb;
+            for (int k = 1; k != 8; ++k) {
+                rb = _mm256_permutevar8x32_epi32(rb, rotate);
+                hit = _mm256_or_si256(hit, _mm256_cmpeq_epi32(va, rb));
+            }
+            const int matched = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+            if (matched) {
+                const __m256i order = _mm256_set1_epi32(int(compress[~matched & 0xff]));
+                _mm256_storeu_si256((__m256i *) found, _mm256_permutevar8x32_epi32(
+                        va, _mm256_and_si256(_mm256_srlv_epi32(order, shift), nibble)));
+                for (int k = 0, n = __builtin_popcount(matched); k != n; ++k)
+                    *dest++ = found[k];
+            }
+            const T last_a = a[7], last_b = b[7];
+            if (!_simd_before<T, Desc>(last_b, last_a))
+                a += 8;
+            if (!_simd_before<T, Desc>(last_a, last_b))
+                b += 8;
+        }
+        return (dest);
+    }
+#endif
+
+    //whether simd_partition has a vector kernel for T at the dispatch level
+    template<typename T>
+    inline bool simd_partition_enabled() {
+#if _QMJ_SIMD_X86
+        const simd_level level = simd_dispatch_level();
+        return (level == simd_avx512 || (level == simd_avx2 && sizeof(T) == 4));
+#else
+        return (false);
+#endif
+    }
+
+    //partitions [first,last) around pivot with the widest kernel the
+    //dispatch level allows: the elements that go before pivot, less or
+    //greater when Desc, come first and the returned pointer ends them
+    template<typename T, bool Desc>
+    inline T *simd_partition(T *first, T *last, const T pivot) {
+#if _QMJ_SIMD_X86
+        switch (simd_dispatch_level()) {
+            case simd_avx512:
+                return (_avx512_partition<T, Desc>(first, last, pivot));
+            case simd_avx2:
+                return (_avx2_partition<T, Desc>(first, last, pivot, bool_type<sizeof(T) == 4>()));
+            default:
+                break;
+        }
+#endif
+        return (_scalar_partition<T, Desc>(first, last, pivot));
+    }
+
+    //sorts n <= simd_network_size elements with a sorting network, false
+    //when no vector kernel can run and the caller has to do it
+    template<typename T, bool Desc>
+    inline bool simd_network_sort(T *first, const size_t n) {
+#if _QMJ_SIMD_X86
+        if (simd_dispatch_level() >= simd_avx2)
+            return (_avx2_network_sort<T, Desc>(first, n, bool_type<sizeof(T) == 4>()));
+#endif
+        return (false);
+    }
+
+    //keys the scan kernels compare bitwise: integers of one to eight bytes
+    template<typename T>
+    struct is_simd_scannable : bool_type<std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+                                         (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)> {
+    };
+
+    //index of the first of the n keys at p whose equality with val is want,
+    //or n when there is none
+    template<typename T>
+    inline size_t simd_find(const T *p, const size_t n, const T val, const bool want) {
+#if _QMJ_SIMD_X86
+        const simd_level level = simd_dispatch_level();
+        if (level >= simd_avx2)
+            return (_avx2_find(p, n, val, want));
+        if (level == simd_sse2)
+            return (_sse2_find(p, n, val, want));
+#endif
+        size_t i = 0;
+        for (; i != n && (p[i] == val) != want; ++i);
+        return (i);
+    }
+
+    template<typename T>
+    inline size_t simd_count(const T *p, const size_t n, const T val) {
+#if _QMJ_SIMD_X86
+        const simd_level level = simd_dispatch_level();
+        if (level >= simd_avx2)
+            return (_avx2_count(p, n, val));
+        if (level == simd_sse2)
+            return (_sse2_count(p, n, val));
+#endif
+        size_t total = 0;
+        for (size_t i = 0; i != n; ++i)
+            total += p[i] == val;
+        return (total);
+    }
+
+    //index of the first i < n where a[i] == b[i] is want, or n; b may
+    //overlap a, as it does for adjacent_find
+    template<typename T>
+    inline size_t simd_find_pair(const T *a, const T *b, const size_t n, const bool want) {
+#if _QMJ_SIMD_X86
+        const simd_level level = simd_dispatch_level();
+        if (level >= simd_avx2)
+            return (_avx2_find_pair(a, b, n, want));
+        if (level == simd_sse2)
+            return (_sse2_find_pair(a, b, n, want));
+#endif
+        size_t i = 0;
+        for (; i != n && (a[i] == b[i]) != want; ++i);
+        return (i);
+    }
+
+    //looks for the needle of 2 <= m <= n keys in the haystack: with matched
+    //set the result is where it starts, otherwise no start before the
+    //result matches and a result past n - m means there is none; without
+    //a kernel the answer is 0, leaving the whole search to the caller
+    template<typename T>
+    inline size_t simd_search(const T *hay, const size_t n, const T *needle, const size_t m, bool &matched) {
+        matched = false;
+#if _QMJ_SIMD_X86
+        const simd_level level = simd_dispatch_level();
+        if (level >= simd_avx2)
+            return (_avx2_search(hay, n, needle, m, matched));
+        if (level == simd_sse2)
+            return (_sse2_search(hay, n, needle, m, matched));
+#endif
+        return (0);
+    }
+
+    //whether simd_intersect has a vector kernel at the dispatch level
+    inline bool simd_intersect_enabled() {
+#if _QMJ_SIMD_X86
+        return (simd_dispatch_level() >= simd_avx2);
+#else
+        return (false);
+#endif
+    }
+
+    //intersects as much of the sorted, ascending or when Desc descending,
+    //4-byte keys [a,a_end) and [b,b_end) as a vector kernel can, moving a
+    //and b past what it took; the caller merges the rest
+    template<typename T, bool Desc, typename OIter>
+    inline OIter simd_intersect(const T *&a, const T *a_end, const T *&b, const T *b_end, OIter dest) {
+        static_assert(sizeof(T) == 4, "simd_intersect takes 4-byte keys");
+#if _QMJ_SIMD_X86
+        if (simd_dispatch_level() >= simd_avx2)
+            return (_avx2_intersect<T, Desc>(a, a_end, b, b_end, dest));
+#endif
+        return (dest);
+    }
+}
+
+#endif //_SIMD_QMJ_
@@ -9,6 +9,17 @@
 #define _QMJ qmj::
 #endif
 
+#if !defined _QMJ_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define _QMJ_PREFETCH(addr) __builtin_prefetch((const void *) (addr))
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define _QMJ_PREFETCH(addr) _mm_prefetch((const char *) (addr), _MM_HINT_T0)
+#else
+#define _QMJ_PREFETCH(addr) ((void) (addr))
+#endif
+#endif
+
 using std::ptrdiff_t;
 
 namespace qmj {
@@ -281,6 +292,16 @@ namespace qmj {
         typedef type1 type;
     };
 
+    //a comparator or hasher with an is_transparent typedef accepts keys of
+    //other types, so lookups need not build a key_type
+    template<typename type, typename = void>
+    struct is_transparent : false_type {
+    };
+
+    template<typename type>
+    struct is_transparent<type, void_t<typename type::is_transparent>> : true_type {
+    };
+
     template<typename value_type, typename = void>
     struct is_typedef_pod : false_type {
         typedef false_type type;
@@ -6,7 +6,8 @@
 
 namespace qmj {
     template<typename key_type_, typename data_type_, typename HashFunction_,
-            typename Equality_, typename Alloc, bool is_multi_>
+            typename Equality_, typename Alloc, bool is_multi_,
+            typename BucketPolicy = prime_bucket_policy>
     struct unordered_map_traits {
         typedef key_type_ key_type;
         typedef data_type_ data_type;
@@ -14,9 +15,10 @@ namespace qmj {
         typedef HashFunction_ HashFunction;
         typedef Equality_ EqualKey;
         typedef Alloc allocator_type;
+        typedef BucketPolicy bucket_policy;
 
         enum {
-            is_multi = is_multi_;
+            is_multi = is_multi_
         };
 
         template<typename type1, typename type2>
@@ -32,11 +34,12 @@ namespace qmj {
 
     template<typename key_type_, typename data_type_, typename HashFunction = qmj::hash<key_type_>,
             typename EqualKey = std::equal_to<key_type_>,
-            typename Alloc = qmj::allocator<std::pair<const key_type_, data_type_>>>
+            typename Alloc = qmj::allocator<std::pair<const key_type_, data_type_>>,
+            typename BucketPolicy = prime_bucket_policy>
     class unordered_map
-            : public hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, false>> {
+            : public hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, false, BucketPolicy>> {
     public:
-        typedef hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, false>> base_type;
+        typedef hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, false, BucketPolicy>> base_type;
         typedef data_type_ data_type;
         typedef data_type mapped_type;
         typedef typename base_type::key_type key_type;
@@ -45,7 +48,7 @@ namespace qmj {
         typedef typename base_type::key_equal key_equal;
         typedef typename base_type::size_type size_type;
 
-        typedef unordered_map<key_type, data_type, HashFunction, EqualKey, Alloc> self;
+        typedef unordered_map<key_type, data_type, HashFunction, EqualKey, Alloc, BucketPolicy> self;
         typedef typename base_type::difference_type difference_type;
         typedef typename base_type::pointer pointer;
         typedef typename base_type::const_pointer const_pointer;
@@ -112,20 +115,22 @@ namespace qmj {
         void swap(self &x) noexcept { base_type::swap(x); }
     };
 
-    template<typename key_type, typename data_type, typename HashFunction, typename EqualKey, typename Alloc>
-    void swap(unordered_map<key_type, data_type, HashFunction, EqualKey, Alloc> &left,
-              unordered_map<key_type, data_type, HashFunction, EqualKey, Alloc> &right) noexcept {
+    template<typename key_type, typename data_type, typename HashFunction, typename EqualKey, typename Alloc,
+            typename BucketPolicy>
+    void swap(unordered_map<key_type, data_type, HashFunction, EqualKey, Alloc, BucketPolicy> &left,
+              unordered_map<key_type, data_type, HashFunction, EqualKey, Alloc, BucketPolicy> &right) noexcept {
         left.swap(right);
     }
 
 
     template<typename key_type_, typename data_type_, typename HashFunction = qmj::hash<key_type_>,
             typename EqualKey = std::equal_to<key_type_>,
-            typename Alloc = qmj::allocator<std::pair<const key_type_, data_type_>>>
+            typename Alloc = qmj::allocator<std::pair<const key_type_, data_type_>>,
+            typename BucketPolicy = prime_bucket_policy>
     class unordered_multimap
-            : public hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, true>> {
+            : public hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, true, BucketPolicy>> {
     public:
-        typedef hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, true>> base_type;
+        typedef hashtable<unordered_map_traits<key_type_, data_type_, HashFunction, EqualKey, Alloc, true, BucketPolicy>> base_type;
         typedef data_type_ data_type;
         typedef data_type mapped_type;
         typedef typename base_type::key_type key_type;
@@ -134,7 +139,7 @@ namespace qmj {
         typedef typename base_type::key_equal key_equal;
         typedef typename base_type::size_type size_type;
 
-        typedef unordered_multimap<key_type, data_type, HashFunction, EqualKey, Alloc> self;
+        typedef unordered_multimap<key_type, data_type, HashFunction, EqualKey, Alloc, BucketPolicy> self;
         typedef typename base_type::difference_type difference_type;
         typedef typename base_type::pointer pointer;
         typedef typename base_type::const_pointer const_pointer;
@@ -201,9 +206,10 @@ namespace qmj {
         void swap(self &x) noexcept { base_type::swap(x); }
     };
 
-    template<typename key_type, typename data_type, typename HashFunction, typename EqualKey, typename Alloc>
-    void swap(unordered_multimap<key_type, data_type, HashFunction, EqualKey, Alloc> &left,
-              unordered_multimap<key_type, data_type, HashFunction, EqualKey, Alloc> &right) noexcept {
+    template<typename key_type, typename data_type, typename HashFunction, typename EqualKey, typename Alloc,
+            typename BucketPolicy>
+    void swap(unordered_multimap<key_type, data_type, HashFunction, EqualKey, Alloc, BucketPolicy> &left,
+              unordered_multimap<key_type, data_type, HashFunction, EqualKey, Alloc, BucketPolicy> &right) noexcept {
         left.swap(right);
     }
 }
@@ -8,13 +8,14 @@
 
 namespace qmj {
     template<typename key_type_, typename HashFunction_, typename EqualKey_,
-            typename Alloc, bool is_multi_>
+            typename Alloc, bool is_multi_, typename BucketPolicy = prime_bucket_policy>
     struct uset_traits {
         typedef key_type_ key_type;
         typedef key_type value_type;
         typedef HashFunction_ HashFunction;
         typedef EqualKey_ EqualKey;
         typedef Alloc allocator_type;
+        typedef BucketPolicy bucket_policy;
 
         enum {
             is_multi = is_multi_
@@ -25,11 +26,12 @@ namespace qmj {
 
     template<typename key_type_, typename HashFunction = qmj::hash<key_type_>,
             typename EqualKey = std::equal_to<key_type_>,
-            typename Alloc = qmj::allocator<key_type_>>
-    class unordered_set : public hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, false>> {
+            typename Alloc = qmj::allocator<key_type_>,
+            typename BucketPolicy = prime_bucket_policy>
+    class unordered_set : public hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, false, BucketPolicy>> {
     public:
-        typedef hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, false>> base_type;
-        typedef unordered_set<key_type_, HashFunction, EqualKey> self;
+        typedef hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, false, BucketPolicy>> base_type;
+        typedef unordered_set<key_type_, HashFunction, EqualKey, Alloc, BucketPolicy> self;
 
         typedef typename base_type::key_type key_type;
         typedef typename base_type::value_type value_type;
@@ -104,20 +106,22 @@ namespace qmj {
         void swap(self &x) noexcept { base_type::swap(x); }
     };
 
-    template<typename key_type, typename HashFunction, typename EqualKey, typename Alloc>
-    void swap(unordered_set<key_type, HashFunction, EqualKey, Alloc> &left,
-              unordered_set<key_type, HashFunction, EqualKey, Alloc> &right) noexcept {
+    template<typename key_type, typename HashFunction, typename EqualKey, typename Alloc,
+            typename BucketPolicy>
+    void swap(unordered_set<key_type, HashFunction, EqualKey, Alloc, BucketPolicy> &left,
+              unordered_set<key_type, HashFunction, EqualKey, Alloc, BucketPolicy> &right) noexcept {
         left.swap(right);
     }
 
 
     template<typename key_type_, typename HashFunction = qmj::hash<key_type_>,
             typename EqualKey = std::equal_to<key_type_>,
-            typename Alloc = qmj::allocator<key_type_>>
-    class unordered_multiset : public hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, true>> {
+            typename Alloc = qmj::allocator<key_type_>,
+            typename BucketPolicy = prime_bucket_policy>
+    class unordered_multiset : public hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, true, BucketPolicy>> {
     public:
-        typedef hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, true>> base_type;
-        typedef unordered_multiset<key_type_, HashFunction, EqualKey> self;
+        typedef hashtable<uset_traits<key_type_, HashFunction, EqualKey, Alloc, true, BucketPolicy>> base_type;
+        typedef unordered_multiset<key_type_, HashFunction, EqualKey, Alloc, BucketPolicy> self;
 
         typedef typename base_type::key_type key_type;
         typedef typename base_type::value_type value_type;
@@ -192,9 +196,10 @@ namespace qmj {
         void swap(self &x) noexcept { base_type::swap(x); }
     };
 
-    template<typename key_type, typename HashFunction, typename EqualKey, typename Alloc>
-    void swap(unordered_multiset<key_type, HashFunction, EqualKey, Alloc> &left,
-              unordered_multiset<key_type, HashFunction, EqualKey, Alloc> &right) noexcept {
+    template<typename key_type, typename HashFunction, typename EqualKey, typename Alloc,
+            typename BucketPolicy>
+    void swap(unordered_multiset<key_type, HashFunction, EqualKey, Alloc, BucketPolicy> &left,
+              unordered_multiset<key_type, HashFunction, EqualKey, Alloc, BucketPolicy> &right) noexcept {
         left.swap(right);
     }
 }
@@ -199,7 +199,7 @@ namespace qmj {
 
         explicit vector(const size_type n) : vector() {
             first = alloc::allocate(n);
-            alloc::construct(first, n);
+            alloc::construct_n(first, n);
             last = end_storage = first + n;
         }
 
@@ -237,7 +237,7 @@ namespace qmj {
 
         ~vector() {
             alloc::destroy(first, last);
-            alloc::deallocate(first);
+            alloc::deallocate(first, capacity());
         }
 
         void shrink_to_fit() {
@@ -468,7 +468,7 @@ namespace qmj {
         void assign_imple(Iter bg, Iter ed, std::forward_iterator_tag) {
             const size_t len = std::distance(bg, ed);
             if (capacity() < len) {
-                alloc::deallocate(first);
+                alloc::deallocate(first, capacity());
                 first = alloc::allocate(len);
                 end_storage = first + len;
             }
@@ -508,7 +508,7 @@ namespace qmj {
 
         void deallocate_and_update_ptr(pointer new_first, pointer new_last, const size_type n) {
             alloc::destroy(first, last);
-            alloc::deallocate(first);
+            alloc::deallocate(first, capacity());
             first = new_first;
             last = new_last;
             end_storage = first + n;
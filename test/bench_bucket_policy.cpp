@@ -0,0 +1,40 @@
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/unordered_map_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //each key maps to the next one on a random cycle through all keys,
+        //so every find waits for the one before it and the time per step is
+        //the latency of a lookup: hash, reduce to a bucket, walk the chain
+        template<typename Policy>
+        void bench_policy(const char *name, const size_t n) {
+            std::vector<int> keys;
+            create_data(keys, n);
+            qmj::unordered_map<int, int, qmj::hash<int>, std::equal_to<int>,
+                    qmj::allocator<std::pair<const int, int>>, Policy> con;
+            for (size_t i = 0; i != n; ++i)
+                con.insert(std::make_pair(keys[i], keys[(i + 1) % n]));
+
+            const size_t steps = 4000000;
+            int key = keys[0];
+            const double ms = bench_ms(3, [&] {
+                for (size_t i = 0; i != steps; ++i)
+                    key = con.find(key)->second;
+            });
+            bench_keep(size_t(key));
+            std::cout << "  " << name << ": " << ms * 1e6 / steps << " ns per find at load "
+                      << con.load_factor() << std::endl;
+        }
+
+        TEST(bucket_policy_bench, DISABLED_lookup_latency) {
+            for (size_t n : {size_t(1) << 10, size_t(1) << 16, size_t(1) << 20, size_t(1) << 23}) {
+                std::cout << n << " keys" << std::endl;
+                bench_policy<qmj::prime_bucket_policy>("prime", n);
+                bench_policy<qmj::power2_bucket_policy>("power2", n);
+                bench_policy<qmj::fastrange_bucket_policy>("fastrange", n);
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/concurrent_unordered_map_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //every thread draws keys from the same prefilled range and reads
+        //with probability reads_percent, else assigns; the throughput is
+        //all threads' operations over the wall time of the slowest
+        double concurrent_map_mops(const size_t shards, const int threads, const unsigned reads_percent) {
+            const int keys = 1 << 16;
+            const size_t ops = 400000;
+            qmj::concurrent_unordered_map<int, int> con(shards);
+            for (int k = 0; k != keys; ++k)
+                con.insert_or_assign(k, k);
+            const double ms = bench_ms(3, [&] {
+                std::vector<std::thread> pool;
+                for (int t = 0; t != threads; ++t)
+                    pool.emplace_back([&con, t, reads_percent] {
+                        std::uint64_t state = 0x9E3779B97F4A7C15ull * (t + 1);
+                        size_t hits = 0;
+                        int out;
+                        for (size_t i = 0; i != ops; ++i) {
+                            state ^= state << 13;
+                            state ^= state >> 7;
+                            state ^= state << 17;
+                            const int k = int(state >> 40) & (keys - 1);
+                            if ((state & 127) * 100 < 128 * reads_percent)
+                                hits += con.find(k, out);
+                            else
+                                con.insert_or_assign(k, int(i));
+                        }
+                        bench_keep(hits);
+                    });
+                for (auto &th : pool)
+                    th.join();
+            });
+            return (double(ops) * threads / ms / 1000);
+        }
+
+        TEST(concurrent_unordered_map_bench, DISABLED_throughput) {
+            std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+            for (unsigned reads : {100u, 90u, 50u})
+                for (int threads : {1, 2, 4, 8}) {
+                    std::cout << reads << "% reads, " << threads << " threads, Mops/s by shards:";
+                    for (size_t shards : {1, 4, 16, 64})
+                        std::cout << " " << shards << ":" << concurrent_map_mops(shards, threads, reads);
+                    std::cout << std::endl;
+                }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/flat_hash_map_qmj.h"
+#include "../QMJSTL/unordered_map_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //both tables get the same number of slots or buckets up front and
+        //are then filled to the load under test, so neither grows while it
+        //is timed. half of a shuffled permutation is inserted, the other
+        //half is the miss set
+        const size_t flat_bench_capacity = (size_t(1) << 20) - 1;
+
+        struct flat_bench_table {
+            typedef qmj::flat_hash_map<int, int> type;
+
+            static void prepare(type &con) {
+                con.clear();
+                con.reserve(flat_bench_capacity / 8 * 7);
+            }
+        };
+
+        struct chained_bench_table {
+            typedef qmj::unordered_map<int, int> type;
+
+            static void prepare(type &con) {
+                con.clear();
+                con.max_load_factor(1.0f);
+                con.rehash(flat_bench_capacity);
+            }
+        };
+
+        template<typename Table>
+        void bench_table(const char *name, const std::vector<int> &keys, const double load) {
+            typedef typename Table::type table_type;
+            const size_t n = size_t(load * flat_bench_capacity);
+            const std::vector<int> present(keys.begin(), keys.begin() + n);
+            const std::vector<int> absent(keys.begin() + n, keys.begin() + 2 * n);
+            table_type con;
+            auto fill = [&] {
+                Table::prepare(con);
+                for (int k : present)
+                    con.insert(std::make_pair(k, k));
+            };
+
+            std::cout << name << " at load " << load << " (" << n << " keys)" << std::endl;
+            bench_report("insert", bench_ms(3, [&] { Table::prepare(con); }, [&] {
+                for (int k : present)
+                    con.insert(std::make_pair(k, k));
+            }));
+            size_t found = 0;
+            bench_report("hit", bench_ms(3, [&] {
+                for (int k : present)
+                    found += con.find(k) != con.end();
+            }));
+            bench_report("miss", bench_ms(3, [&] {
+                for (int k : absent)
+                    found += con.find(k) != con.end();
+            }));
+            bench_report("erase", bench_ms(3, fill, [&] {
+                for (int k : present)
+                    found += con.erase(k);
+            }));
+            bench_keep(found);
+        }
+
+        TEST(flat_hash_map_bench, DISABLED_against_chained) {
+            std::vector<int> keys;
+            ASSERT_TRUE(create_data(keys, 2 * flat_bench_capacity));
+            for (double load : {0.25, 0.5, 0.75, 0.87}) {
+                bench_table<flat_bench_table>("flat_hash_map", keys, load);
+                bench_table<chained_bench_table>("unordered_map", keys, load);
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+#include "../QMJSTL/execution_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //the parallel sorts at 1..N planned threads, N twice the hardware
+        //threads and at least 8, so oversubscription shows up too
+        TEST(fork_join_bench, DISABLED_thread_scaling) {
+            std::vector<int> data;
+            ASSERT_TRUE(create_data(data, 10000000));
+            std::vector<int> work;
+            size_t most = 2 * std::thread::hardware_concurrency();
+            if (most < 8)
+                most = 8;
+            std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+            for (size_t threads = 1; threads <= most; ++threads) {
+                qmj::set_parallel_threads(threads);
+                std::cout << threads << " threads" << std::endl;
+                bench_report("sort(par)", bench_ms(3, [&] { work = data; }, [&] {
+                    qmj::sort(qmj::par, work.begin(), work.end());
+                }));
+                bench_report("stable_sort(par)", bench_ms(3, [&] { work = data; }, [&] {
+                    qmj::stable_sort(qmj::par, work.begin(), work.end());
+                }));
+                bench_keep(size_t(work[work.size() / 2]));
+            }
+            qmj::set_parallel_threads(0);
+        }
+    }
+}
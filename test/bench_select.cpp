@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+
+namespace qmj {
+    namespace test {
+        const size_t select_bench_size = 100000000;
+
+        //selections a top-k query asks for: the ten largest, the largest
+        //one percent and the median. every run starts from the same random
+        //input, the copy back is outside the timed region
+        TEST(select_bench, DISABLED_nth_element_and_partial_sort) {
+            std::vector<std::int32_t> data, work;
+            ASSERT_TRUE(create_data(data, select_bench_size, pattern_random));
+            const size_t ks[] = {10, select_bench_size / 100, select_bench_size / 2};
+            const char *names[] = {"top 10", "top 1%", "median"};
+            for (int i = 0; i != 3; ++i) {
+                const size_t k = ks[i];
+                std::cout << names[i] << " of " << select_bench_size << " int32_t" << std::endl;
+                auto nth = [&] { return (work.data() + k - 1); };
+                bench_report("std::nth_element", bench_ms(3, [&] { work = data; }, [&] {
+                    std::nth_element(work.data(), nth(), work.data() + work.size(), std::greater<>());
+                }));
+                bench_report("qmj::nth_element", bench_ms(3, [&] { work = data; }, [&] {
+                    qmj::nth_element(work.data(), nth(), work.data() + work.size(), std::greater<>());
+                }));
+                const std::int32_t kth = *nth();
+                ASSERT_TRUE(std::all_of(work.data(), nth(), [kth](std::int32_t x) { return (x >= kth); }));
+                ASSERT_TRUE(std::all_of(nth(), work.data() + work.size(),
+                                        [kth](std::int32_t x) { return (x <= kth); }));
+
+                bench_report("std::partial_sort", bench_ms(3, [&] { work = data; }, [&] {
+                    std::partial_sort(work.data(), work.data() + k, work.data() + work.size(),
+                                      std::greater<>());
+                }));
+                bench_report("qmj::partial_sort", bench_ms(3, [&] { work = data; }, [&] {
+                    qmj::partial_sort(work.data(), work.data() + k, work.data() + work.size(),
+                                      std::greater<>());
+                }));
+                ASSERT_TRUE(std::is_sorted(work.data(), work.data() + k, std::greater<>()));
+                ASSERT_EQ(kth, work[k - 1]);
+            }
+        }
+    }
+}
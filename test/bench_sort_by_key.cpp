@@ -0,0 +1,57 @@
+#include <cstdint>
+#include <random>
+#include <utility>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+#include "../QMJSTL/vector_qmj.h"
+
+namespace qmj {
+    namespace test {
+        const size_t sort_by_key_bench_size = 10000000;
+
+        //sort_by_key on separate key and value arrays against qmj::sort of
+        //the same records, both with 32 bit payloads
+        template<typename key_type>
+        void bench_sort_by_key(const char *name) {
+            std::mt19937_64 gen(42);
+            qmj::vector<key_type> keys(sort_by_key_bench_size);
+            qmj::vector<std::uint32_t> values(sort_by_key_bench_size);
+            qmj::vector<std::pair<key_type, std::uint32_t>> pairs(sort_by_key_bench_size);
+            for (size_t i = 0; i != sort_by_key_bench_size; ++i) {
+                keys[i] = key_type(gen());
+                values[i] = std::uint32_t(i);
+                pairs[i] = std::make_pair(keys[i], values[i]);
+            }
+            qmj::vector<key_type> kwork;
+            qmj::vector<std::uint32_t> vwork;
+            qmj::vector<std::pair<key_type, std::uint32_t>> pwork;
+            std::cout << name << " keys, " << sort_by_key_bench_size << " elements" << std::endl;
+            bench_report("qmj::sort keys only", bench_ms(3, [&] { kwork = keys; }, [&] {
+                qmj::sort(kwork.begin(), kwork.end());
+            }));
+            bench_report("qmj::sort pairs", bench_ms(3, [&] { pwork = pairs; }, [&] {
+                qmj::sort(pwork.begin(), pwork.end(), [](const std::pair<key_type, std::uint32_t> &l,
+                                                         const std::pair<key_type, std::uint32_t> &r) {
+                    return (l.first < r.first);
+                });
+            }));
+            bench_report("qmj::sort_by_key", bench_ms(3, [&] {
+                kwork = keys;
+                vwork = values;
+            }, [&] {
+                qmj::sort_by_key(kwork.begin(), kwork.end(), vwork.begin());
+            }));
+            bench_report("qmj::radix_sort pairs by first", bench_ms(3, [&] { pwork = pairs; }, [&] {
+                qmj::radix_sort(pwork.begin(), pwork.end(),
+                                [](const std::pair<key_type, std::uint32_t> &p) { return (p.first); });
+            }));
+            bench_keep(size_t(vwork[0]) + size_t(pwork[0].second) + size_t(kwork[0]));
+        }
+
+        TEST(sort_by_key_bench, DISABLED_against_sort) {
+            bench_sort_by_key<std::uint32_t>("uint32_t");
+            bench_sort_by_key<std::uint64_t>("uint64_t");
+        }
+    }
+}
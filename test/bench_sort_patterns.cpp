@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+#include "../QMJSTL/simd_qmj.h"
+
+namespace qmj {
+    namespace test {
+        const size_t sort_pattern_bench_size = 5000000;
+
+        //std::sort against qmj::sort on every input pattern; the scalar
+        //column caps the dispatch so it times the pattern-defeating engine
+        //without the vector kernels, which only take contiguous pointers
+        template<typename type>
+        void bench_sort_patterns(const char *name) {
+            std::cout << name << ", " << sort_pattern_bench_size << " elements" << std::endl;
+            const data_pattern patterns[] = {pattern_sorted, pattern_reverse, pattern_sawtooth,
+                                             pattern_few_unique, pattern_random};
+            for (data_pattern pattern : patterns) {
+                std::vector<type> data, work;
+                ASSERT_TRUE(create_data(data, sort_pattern_bench_size, pattern));
+                const double std_ms = bench_ms(3, [&] { work = data; }, [&] {
+                    std::sort(work.begin(), work.end());
+                });
+                qmj::set_simd_level(qmj::simd_scalar);
+                const double scalar_ms = bench_ms(3, [&] { work = data; }, [&] {
+                    qmj::sort(work.data(), work.data() + work.size());
+                });
+                qmj::set_simd_level(qmj::simd_avx512);
+                const double qmj_ms = bench_ms(3, [&] { work = data; }, [&] {
+                    qmj::sort(work.data(), work.data() + work.size());
+                });
+                ASSERT_TRUE(std::is_sorted(work.begin(), work.end()));
+                std::cout << "  " << pattern_name(pattern) << ": std::sort " << std_ms
+                          << " ms, qmj::sort scalar " << scalar_ms << " ms, qmj::sort " << qmj_ms
+                          << " ms" << std::endl;
+            }
+        }
+
+        TEST(sort_bench, DISABLED_patterns) {
+            bench_sort_patterns<std::int32_t>("int32_t");
+            bench_sort_patterns<std::int64_t>("int64_t");
+            bench_sort_patterns<double>("double");
+        }
+    }
+}
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+#include "../QMJSTL/searcher_qmj.h"
+#include "../QMJSTL/simd_qmj.h"
+#include "../QMJSTL/vector_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //every kernel is checked against the std algorithm at each dispatch
+        //level; levels the cpu lacks fall back to the best it has
+        const simd_level simd_levels[] = {simd_scalar, simd_sse2, simd_avx2, simd_avx512};
+
+        class simd_levels_test : public testing::Test {
+        protected:
+            void TearDown() override { set_simd_level(simd_avx512); }
+        };
+
+        //lengths around the network size, the partition block and the
+        //vector widths, then a few large ones
+        std::vector<size_t> sort_test_sizes() {
+            std::vector<size_t> sizes;
+            for (size_t n = 0; n <= 2 * simd_network_size + 2; ++n)
+                sizes.push_back(n);
+            for (size_t edge : {pdq_block_size, 2 * pdq_block_size, ninther_threshold, size_t(4096)})
+                for (size_t n = edge - 2; n <= edge + 2; ++n)
+                    sizes.push_back(n);
+            sizes.push_back(1000);
+            sizes.push_back(100003);
+            return (sizes);
+        }
+
+        template<typename type>
+        std::vector<type> sort_input(const size_t n, const int pattern, std::mt19937_64 &gen) {
+            std::vector<type> data(n);
+            for (size_t i = 0; i != n; ++i)
+                switch (pattern) {
+                    case 0:
+                        data[i] = type(std::int64_t(gen()) >> 8);
+                        break;
+                    case 1:
+                        data[i] = type(gen() % 5) - type(2);
+                        break;
+                    case 2:
+                        data[i] = type(n - i);
+                        break;
+                    default:
+                        data[i] = type(i % 17);
+                }
+            if (std::is_floating_point<type>::value && n > 3) {
+                data[n / 2] = type(-0.0);
+                data[n / 3] = type(0.0);
+            }
+            return (data);
+        }
+
+        template<typename type, typename Comp>
+        void check_sort(const Comp &cmp, const char *order) {
+            std::mt19937_64 gen(7);
+            for (simd_level level : simd_levels) {
+                set_simd_level(level);
+                for (size_t n : sort_test_sizes())
+                    for (int pattern = 0; pattern != 4; ++pattern) {
+                        std::vector<type> expect = sort_input<type>(n, pattern, gen);
+                        std::vector<type> got = expect;
+                        std::sort(expect.begin(), expect.end(), cmp);
+                        qmj::sort(got.data(), got.data() + got.size(), cmp);
+                        ASSERT_TRUE(expect == got) << "level " << level << ", " << order << ", n " << n
+                                                   << ", pattern " << pattern;
+                    }
+            }
+        }
+
+        TEST_F(simd_levels_test, sort_int32) {
+            check_sort<std::int32_t>(std::less<>(), "less");
+            check_sort<std::int32_t>(std::greater<>(), "greater");
+        }
+
+        TEST_F(simd_levels_test, sort_int64) {
+            check_sort<std::int64_t>(std::less<>(), "less");
+            check_sort<std::int64_t>(std::greater<>(), "greater");
+        }
+
+        TEST_F(simd_levels_test, sort_float) {
+            check_sort<float>(std::less<>(), "less");
+            check_sort<float>(std::greater<>(), "greater");
+        }
+
+        TEST_F(simd_levels_test, sort_double) {
+            check_sort<double>(std::less<>(), "less");
+            check_sort<double>(std::greater<>(), "greater");
+        }
+
+        //short ranges over a few values, so matches, runs and the first
+        //difference land on every lane and in the scalar tails
+        template<typename type>
+        void check_scans(std::mt19937_64 &gen) {
+            for (int it = 0; it != 300; ++it) {
+                const size_t n = gen() % 300;
+                const unsigned range = 1 + gen() % 6;
+                std::vector<type> v(n);
+                for (auto &x : v)
+                    x = type(gen() % range);
+                const type val = type(gen() % range);
+                const type *first = v.data(), *last = v.data() + n;
+                ASSERT_EQ(std::find(first, last, val), qmj::find(first, last, val)) << n;
+                ASSERT_EQ(std::count(first, last, val), qmj::count(first, last, val)) << n;
+                ASSERT_EQ(std::adjacent_find(first, last), qmj::adjacent_find(first, last)) << n;
+                for (long k : {0L, 1L, 2L, 3L, 5L, 40L})
+                    ASSERT_EQ(std::search_n(first, last, k, val), qmj::search_n(first, last, k, val))
+                                                << n << ", count " << k;
+
+                std::vector<type> w = v;
+                if (n)
+                    w[gen() % n] ^= type(1);
+                const size_t m = n ? gen() % n : 0;
+                const type *wfirst = w.data();
+                ASSERT_TRUE(std::mismatch(first, last, wfirst) == qmj::mismatch(first, last, wfirst)) << n;
+                ASSERT_TRUE(std::mismatch(first, last, wfirst, wfirst + m) ==
+                            qmj::mismatch(first, last, wfirst, wfirst + m)) << n;
+                ASSERT_EQ(std::equal(first, last, wfirst), qmj::equal(first, last, wfirst)) << n;
+                ASSERT_EQ(std::equal(first, last, wfirst, wfirst + m),
+                          qmj::equal(first, last, wfirst, wfirst + m)) << n;
+
+                qmj::vector<type> qv(v.begin(), v.end());
+                ASSERT_EQ(std::find(first, last, val) - first, qmj::find(qv.begin(), qv.end(), val) - qv.begin());
+                ASSERT_EQ(std::count(first, last, val), qmj::count(qv.cbegin(), qv.cend(), val));
+            }
+        }
+
+        TEST_F(simd_levels_test, find_count_mismatch) {
+            std::mt19937_64 gen(5);
+            for (simd_level level : simd_levels) {
+                set_simd_level(level);
+                SCOPED_TRACE(level);
+                check_scans<char>(gen);
+                check_scans<signed char>(gen);
+                check_scans<unsigned char>(gen);
+                check_scans<short>(gen);
+                check_scans<unsigned short>(gen);
+                check_scans<int>(gen);
+                check_scans<unsigned>(gen);
+                check_scans<long long>(gen);
+                check_scans<unsigned long>(gen);
+
+                //values the element type cannot hold never match
+                std::vector<unsigned char> bytes(100, 44);
+                EXPECT_EQ(bytes.data() + 100, qmj::find(bytes.data(), bytes.data() + 100, 300));
+                EXPECT_EQ(bytes.data() + 100, qmj::find(bytes.data(), bytes.data() + 100, 44 + 256));
+                EXPECT_EQ(100, qmj::count(bytes.data(), bytes.data() + 100, 44));
+                std::vector<int> neg(70, -1);
+                EXPECT_EQ(70, qmj::count(neg.data(), neg.data() + 70, 0xffffffffu));
+                EXPECT_EQ(neg.data(), qmj::find(neg.data(), neg.data() + 70, -1LL));
+                EXPECT_EQ(neg.data() + 70, qmj::find(neg.data(), neg.data() + 70, 0xffffffffLL));
+                std::vector<double> zeros = {1.0, -0.0, 0.0};
+                EXPECT_EQ(zeros.data() + 1, qmj::find(zeros.data(), zeros.data() + 3, 0.0));
+            }
+        }
+
+        //needles of up to 70 elements, half of them planted in the
+        //haystack, cover the filter, Horspool and Two-Way lengths
+        template<typename type>
+        void check_search(std::mt19937_64 &gen) {
+            for (int it = 0; it != 400; ++it) {
+                const size_t n = gen() % 400;
+                const size_t m = gen() % 4 ? gen() % 70 : gen() % 5;
+                const unsigned range = 1 + gen() % 4;
+                std::vector<type> hay(n), needle(m);
+                for (auto &x : hay)
+                    x = type(gen() % range);
+                for (auto &x : needle)
+                    x = type(gen() % range);
+                if (m && n >= m && gen() % 2)
+                    std::copy(needle.begin(), needle.end(), hay.begin() + gen() % (n - m + 1));
+                const type *first = hay.data(), *last = hay.data() + n;
+                const type *expect = std::search(first, last, needle.data(), needle.data() + m);
+                ASSERT_EQ(expect, qmj::search(first, last, needle.data(), needle.data() + m))
+                                            << n << ", needle " << m;
+                ASSERT_EQ(expect, qmj::search(first, last, needle.data(), needle.data() + m,
+                                              [](type a, type b) { return (a == b); }));
+                ASSERT_EQ(expect - first, qmj::search(hay.begin(), hay.end(), needle.begin(), needle.end())
+                                          - hay.begin());
+                std::deque<type> dq(hay.begin(), hay.end());
+                ASSERT_EQ(expect - first, qmj::search(dq.begin(), dq.end(), needle.begin(), needle.end())
+                                          - dq.begin());
+
+                typedef typename std::vector<type>::const_iterator iter;
+                const iter expect_it = hay.cbegin() + (expect - first);
+                const iter expect_end = expect == last ? hay.cend() : expect_it + m;
+                qmj::default_searcher<iter> plain(needle.cbegin(), needle.cend());
+                qmj::boyer_moore_horspool_searcher<iter> horspool(needle.cbegin(), needle.cend());
+                qmj::boyer_moore_searcher<iter> bm(needle.cbegin(), needle.cend());
+                EXPECT_TRUE(std::make_pair(expect_it, expect_end) == plain(hay.cbegin(), hay.cend()));
+                EXPECT_TRUE(std::make_pair(expect_it, expect_end) == horspool(hay.cbegin(), hay.cend()));
+                EXPECT_TRUE(std::make_pair(expect_it, expect_end) == bm(hay.cbegin(), hay.cend()));
+                EXPECT_EQ(expect_it, qmj::search(hay.cbegin(), hay.cend(), bm));
+            }
+        }
+
+        TEST_F(simd_levels_test, search) {
+            std::mt19937_64 gen(7);
+            for (simd_level level : simd_levels) {
+                set_simd_level(level);
+                SCOPED_TRACE(level);
+                check_search<char>(gen);
+                check_search<unsigned char>(gen);
+                check_search<short>(gen);
+                check_search<int>(gen);
+                check_search<unsigned long>(gen);
+
+                //periodic haystacks where the filter passes almost every
+                //position; the needle differs from the haystack in the middle
+                std::string hay(200000, 'a'), needle(1000, 'a');
+                needle[500] = 'b';
+                EXPECT_EQ(hay.data() + hay.size(), qmj::search(hay.data(), hay.data() + hay.size(),
+                                                               needle.data(), needle.data() + needle.size()));
+                hay[150000] = 'b';
+                std::string short_needle(21, 'a');
+                short_needle[10] = 'b';
+                EXPECT_EQ(150000 - 10, qmj::search(hay.data(), hay.data() + hay.size(), short_needle.data(),
+                                                   short_needle.data() + short_needle.size()) - hay.data());
+                EXPECT_EQ(150000 - 10, qmj::search(hay.begin(), hay.end(), short_needle.begin(),
+                                                   short_needle.end()) - hay.begin());
+            }
+        }
+
+        //one side is often a handful of elements so the galloping paths
+        //run; without duplicates the uint32 intersection kernel runs too
+#define QMJ_CHECK_SET_OP(op)                                                                       \
+        {                                                                                          \
+            std::vector<type> expect, got;                                                         \
+            std::op(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expect), cmp);     \
+            qmj::op(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(got), cmp);        \
+            ASSERT_TRUE(expect == got) << #op;                                                     \
+            got.assign(expect.size() + 1, type(77));                                               \
+            ASSERT_EQ(got.data() + expect.size(), qmj::op(a.data(), a.data() + a.size(), b.data(), \
+                                                          b.data() + b.size(), got.data(), cmp)) << #op; \
+            got.pop_back();                                                                        \
+            ASSERT_TRUE(expect == got) << #op;                                                     \
+            std::list<type> la(a.begin(), a.end());                                                \
+            got.clear();                                                                           \
+            qmj::op(la.begin(), la.end(), b.data(), b.data() + b.size(), std::back_inserter(got), cmp); \
+            ASSERT_TRUE(expect == got) << #op;                                                     \
+        }
+
+        template<typename type, typename Comp>
+        void check_set_ops(std::mt19937_64 &gen, const Comp &cmp) {
+            for (int it = 0; it != 600; ++it) {
+                size_t n1 = gen() % 400, n2 = gen() % 400;
+                if (gen() % 3 == 0)
+                    n1 = gen() % 6;
+                else if (gen() % 3 == 0)
+                    n2 = gen() % 6;
+                const bool dup = gen() % 3 == 0;
+                const std::uint64_t range = dup ? 1 + gen() % 50 : 1 + gen() % 5000;
+                std::vector<type> a(n1), b(n2);
+                for (auto &x : a)
+                    x = type(gen() % range);
+                for (auto &x : b)
+                    x = type(gen() % range);
+                std::sort(a.begin(), a.end(), cmp);
+                std::sort(b.begin(), b.end(), cmp);
+                if (!dup) {
+                    a.erase(std::unique(a.begin(), a.end()), a.end());
+                    b.erase(std::unique(b.begin(), b.end()), b.end());
+                }
+                QMJ_CHECK_SET_OP(set_union)
+                QMJ_CHECK_SET_OP(set_intersection)
+                QMJ_CHECK_SET_OP(set_difference)
+                QMJ_CHECK_SET_OP(set_symmetric_difference)
+
+                ASSERT_EQ(std::includes(a.begin(), a.end(), b.begin(), b.end(), cmp),
+                          qmj::includes(a.begin(), a.end(), b.begin(), b.end(), cmp));
+                std::vector<type> sub;
+                for (const type &x : a)
+                    if (gen() % 50 == 0)
+                        sub.push_back(x);
+                ASSERT_TRUE(qmj::includes(a.data(), a.data() + a.size(), sub.data(), sub.data() + sub.size(), cmp));
+            }
+        }
+
+#undef QMJ_CHECK_SET_OP
+
+        TEST_F(simd_levels_test, set_operations) {
+            std::mt19937_64 gen(11);
+            for (simd_level level : simd_levels) {
+                set_simd_level(level);
+                SCOPED_TRACE(level);
+                check_set_ops<unsigned>(gen, std::less<>());
+                check_set_ops<unsigned>(gen, std::greater<unsigned>());
+                check_set_ops<int>(gen, std::less<int>());
+                check_set_ops<int>(gen, std::greater<>());
+                check_set_ops<long>(gen, std::less<>());
+                check_set_ops<short>(gen, std::less<>());
+                check_set_ops<double>(gen, [](double x, double y) { return (x < y); });
+            }
+
+            //every key of both sides once, in order
+            std::vector<int> a = {1, 2, 3}, b = {2, 3, 4}, u(6);
+            u.resize(qmj::set_union(a.begin(), a.end(), b.begin(), b.end(), u.begin()) - u.begin());
+            EXPECT_TRUE((u == std::vector<int>{1, 2, 3, 4}));
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/concurrent_map_qmj.h"
+#include "../QMJSTL/concurrent_unordered_map_qmj.h"
+
+namespace qmj {
+    namespace test {
+        TEST(concurrent_map, insert_or_assign_at) {
+            qmj::concurrent_map<int, int> con;
+            EXPECT_TRUE(con.insert_or_assign(1, 10));
+            EXPECT_FALSE(con.insert_or_assign(1, 11));
+            EXPECT_EQ(con.at(1), 11);
+            EXPECT_EQ(con.size(), 1u);
+            EXPECT_THROW(con.at(2), std::out_of_range);
+
+            con.insert_or_assign(3, 30);
+            con.insert_or_assign(5, 50);
+            auto range = con.equal_range(3);
+            ASSERT_TRUE(range.first != range.second);
+            EXPECT_EQ(range.first->first, 3);
+            EXPECT_EQ(range.second->first, 5);
+            range = con.equal_range(4);
+            EXPECT_TRUE(range.first == range.second);
+
+            auto next = con.erase(con.find(3));
+            EXPECT_EQ(next->first, 5);
+            EXPECT_FALSE(con.contains(3));
+        }
+
+        //each writer owns the keys congruent to its index and counts them up,
+        //while the erasers race them; whatever survives holds a value its
+        //writer assigned and at never sees a torn or stale-erased element
+        TEST(concurrent_map, concurrent_assign) {
+            const int threads = 4, keys = 256, rounds = 2000;
+            qmj::concurrent_map<int, long long> con;
+            std::vector<std::thread> pool;
+            for (int t = 0; t != threads; ++t)
+                pool.emplace_back([&con, t] {
+                    for (int r = 1; r <= rounds; ++r)
+                        for (int k = t; k < keys; k += threads) {
+                            con.insert_or_assign(k, (long long) r * keys + k);
+                            if (r % 7 == 0 && k % 3 == 0)
+                                con.erase(k);
+                        }
+                });
+            pool.emplace_back([&con] {
+                for (int r = 0; r != rounds; ++r)
+                    for (int k = 0; k < keys; ++k)
+                        try {
+                            long long v = con.at(k);
+                            if (v % keys != k)
+                                throw std::logic_error("wrong value");
+                        } catch (const std::out_of_range &) {
+                        }
+            });
+            for (auto &th : pool)
+                th.join();
+            EXPECT_EQ(con.size(), size_t(keys));
+            for (int k = 0; k != keys; ++k)
+                EXPECT_EQ(con.at(k), (long long) rounds * keys + k);
+        }
+
+        //the longest chain in any shard's table; keys spread over the
+        //shards must still spread over each shard's buckets
+        template<typename Policy>
+        size_t longest_shard_chain(const size_t shards, const int keys) {
+            qmj::concurrent_unordered_map<int, int, qmj::hash<int>, std::equal_to<int>,
+                    qmj::simple_allocator<std::pair<const int, int>>, Policy> con(shards);
+            for (int k = 0; k != keys; ++k)
+                con.insert_or_assign(k, k);
+            size_t longest = 0;
+            con.for_each_shard([&](const typename decltype(con)::table_type &table) {
+                for (size_t i = 0; i != table.bucket_count(); ++i)
+                    longest = std::max(longest, table.bucket_size(i));
+            });
+            return (longest);
+        }
+
+        TEST(concurrent_unordered_map, shard_and_bucket_independent) {
+            const int keys = 200000;
+            for (size_t shards : {1, 4, 64}) {
+                EXPECT_LT(longest_shard_chain<qmj::prime_bucket_policy>(shards, keys), 16u) << shards;
+                EXPECT_LT(longest_shard_chain<qmj::power2_bucket_policy>(shards, keys), 16u) << shards;
+                EXPECT_LT(longest_shard_chain<qmj::fastrange_bucket_policy>(shards, keys), 16u) << shards;
+            }
+        }
+
+        TEST(concurrent_unordered_map, find_assign_erase) {
+            qmj::concurrent_unordered_map<int, int> con(8);
+            int out = 0;
+            EXPECT_FALSE(con.find(1, out));
+            EXPECT_TRUE(con.insert_or_assign(1, 10));
+            EXPECT_FALSE(con.insert_or_assign(1, 11));
+            ASSERT_TRUE(con.find(1, out));
+            EXPECT_EQ(out, 11);
+            EXPECT_EQ(con.count(1), 1u);
+            EXPECT_EQ(con.erase(1), 1u);
+            EXPECT_EQ(con.erase(1), 0u);
+            EXPECT_FALSE(con.find(1, out));
+            EXPECT_TRUE(con.empty());
+
+            for (int k = 0; k != 1000; ++k)
+                con.insert_or_assign(k, -k);
+            EXPECT_EQ(con.size(), 1000u);
+            EXPECT_EQ(con.erase_if([](const std::pair<const int, int> &x) { return (x.first % 3 == 0); }), 334u);
+            EXPECT_EQ(con.size(), 666u);
+            for (int k = 0; k != 1000; ++k) {
+                EXPECT_EQ(con.find(k, out), k % 3 != 0) << k;
+                if (k % 3)
+                    EXPECT_EQ(out, -k);
+            }
+            con.clear();
+            EXPECT_TRUE(con.empty());
+        }
+
+        TEST(concurrent_unordered_map, for_each_shard_par) {
+            qmj::set_parallel_threads(4);
+            qmj::concurrent_unordered_map<int, int> con(16);
+            for (int k = 0; k != 5000; ++k)
+                con.insert_or_assign(k, k);
+            std::atomic<size_t> seen(0);
+            std::atomic<long long> sum(0);
+            con.for_each_shard(qmj::par, [&](typename decltype(con)::table_type &table) {
+                for (auto &x : table) {
+                    x.second *= 2;
+                    sum += x.second;
+                }
+                seen += table.size();
+            });
+            EXPECT_EQ(seen.load(), 5000u);
+            EXPECT_EQ(sum.load(), 5000LL * 4999);
+            const auto &ccon = con;
+            seen = 0;
+            ccon.for_each_shard(qmj::par, [&](const typename decltype(con)::table_type &table) {
+                for (const auto &x : table)
+                    seen += x.second == 2 * x.first;
+            });
+            EXPECT_EQ(seen.load(), 5000u);
+            qmj::set_parallel_threads(0);
+        }
+
+        //writers own the keys congruent to their index and stamp them with
+        //the round, an eraser and an erase_if sweep race them and readers
+        //check that any value they find belongs to its key. after the join
+        //the writers' last round is all that is left
+        TEST(concurrent_unordered_map, concurrent_writers_erasers_readers) {
+            const int threads = 4, keys = 512, rounds = 300;
+            qmj::concurrent_unordered_map<int, long long> con(8);
+            std::atomic<bool> bad(false);
+            std::vector<std::thread> pool;
+            for (int t = 0; t != threads; ++t)
+                pool.emplace_back([&con, t] {
+                    for (int r = 1; r <= rounds; ++r)
+                        for (int k = t; k < keys; k += threads)
+                            con.insert_or_assign(k, (long long) r * keys + k);
+                });
+            pool.emplace_back([&con] {
+                for (int r = 0; r != rounds / 2; ++r)
+                    for (int k = 0; k < keys; k += 5)
+                        con.erase(k);
+            });
+            pool.emplace_back([&con] {
+                for (int r = 0; r != 20; ++r)
+                    con.erase_if([](const std::pair<const int, long long> &x) { return (x.second % 7 == 0); });
+            });
+            for (int t = 0; t != 2; ++t)
+                pool.emplace_back([&con, &bad] {
+                    long long v;
+                    for (int r = 0; r != rounds; ++r)
+                        for (int k = 0; k < keys; ++k)
+                            if (con.find(k, v) && v % keys != k)
+                                bad = true;
+                });
+            for (auto &th : pool)
+                th.join();
+            EXPECT_FALSE(bad.load());
+            for (int t = 0; t != threads; ++t)
+                for (int k = t; k < keys; k += threads)
+                    con.insert_or_assign(k, (long long) (rounds + 1) * keys + k);
+            EXPECT_EQ(con.size(), size_t(keys));
+            long long v;
+            for (int k = 0; k != keys; ++k) {
+                ASSERT_TRUE(con.find(k, v));
+                EXPECT_EQ(v, (long long) (rounds + 1) * keys + k);
+            }
+        }
+    }
+}
@@ -2,7 +2,11 @@
 #define _TEST_CREATE_DATA_
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <random>
 #include <string>
 #include <utility>
 #include <vector>
@@ -151,6 +155,124 @@ namespace qmj {
             return true;
         }
 
+        //input orders the sort benchmarks run over
+        enum data_pattern {
+            pattern_sorted, pattern_reverse, pattern_sawtooth, pattern_few_unique, pattern_random
+        };
+
+        inline const char *pattern_name(const data_pattern pattern) {
+            static const char *names[] = {"sorted", "reverse", "sawtooth", "few unique", "random"};
+            return (names[pattern]);
+        }
+
+        //data_size values of an arithmetic type in the given order: sawtooth
+        //repeats ascending runs of about sqrt(n), few unique draws from 16
+        //values, random draws from the whole range with a fixed seed
+        template<typename type>
+        bool create_data(std::vector<type> &vec, const size_t data_size, const data_pattern pattern) {
+            std::vector<type> temp;
+            try {
+                temp.reserve(data_size);
+                std::mt19937_64 gen(data_size);
+                size_t run = 1;
+                while (run * run < data_size)
+                    ++run;
+                for (size_t i = 0; i != data_size; ++i) {
+                    switch (pattern) {
+                        case pattern_sorted:
+                            temp.push_back(type(i));
+                            break;
+                        case pattern_reverse:
+                            temp.push_back(type(data_size - i));
+                            break;
+                        case pattern_sawtooth:
+                            temp.push_back(type(i % run));
+                            break;
+                        case pattern_few_unique:
+                            temp.push_back(type(gen() % 16));
+                            break;
+                        default:
+                            temp.push_back(type(std::int64_t(gen() >> 1) % std::int64_t(data_size)));
+                    }
+                }
+            }
+            catch (...) {
+                return false;
+            }
+            vec.swap(temp);
+            return true;
+        }
+
+        //the benchmarks are DISABLED_ tests, run them with
+        //--gtest_also_run_disabled_tests; each reports the best of reps runs
+        //in milliseconds, setup runs untimed before every one so fn may
+        //consume its input
+        template<typename Setup, typename Fn>
+        double bench_ms(const int reps, Setup setup, Fn fn) {
+            double best = 0;
+            for (int i = 0; i != reps; ++i) {
+                setup();
+                auto start = std::chrono::steady_clock::now();
+                fn();
+                std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+                if (!i || ms.count() < best)
+                    best = ms.count();
+            }
+            return best;
+        }
+
+        template<typename Fn>
+        double bench_ms(const int reps, Fn fn) {
+            return bench_ms(reps, [] {}, fn);
+        }
+
+        //results a benchmark computes go here so the work is not elided;
+        //the empty asm claims to read x, elsewhere a volatile is stored and
+        //loaded back
+        inline void bench_keep(size_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+            asm volatile("" : : "r"(x) : "memory");
+#else
+            static volatile size_t sink;
+            sink = x;
+            x = sink;
+            (void) x;
+#endif
+        }
+
+        inline void bench_report(const std::string &what, const double ms) {
+            std::cout << "  " << what << ": " << ms << " ms" << std::endl;
+        }
+
+        //yields *cur converted to type by value, so whatever keeps the
+        //address of a dereferenced element is left with a dead temporary
+        template<typename Iter, typename type>
+        struct by_value_iterator {
+            typedef std::forward_iterator_tag iterator_category;
+            typedef type value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef type reference;
+
+            type operator*() const { return (type(*cur)); }
+
+            by_value_iterator &operator++() {
+                ++cur;
+                return (*this);
+            }
+
+            bool operator==(const by_value_iterator &x) const { return (cur == x.cur); }
+
+            bool operator!=(const by_value_iterator &x) const { return (cur != x.cur); }
+
+            Iter cur;
+        };
+
+        template<typename type, typename Iter>
+        by_value_iterator<Iter, type> by_value(Iter iter) {
+            return (by_value_iterator<Iter, type>{iter});
+        }
+
         template<typename Container, typename = void>
         struct is_map_type : qmj::false_type {
             typedef typename Container::value_type key_type;
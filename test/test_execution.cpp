@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+#include "../QMJSTL/execution_qmj.h"
+
+namespace qmj {
+    namespace test {
+        long long fork_sum(const int lo, const int hi) {
+            if (hi - lo < 64) {
+                long long sum = 0;
+                for (int i = lo; i != hi; ++i)
+                    sum += i;
+                return (sum);
+            }
+            long long left = 0, right = 0;
+            const int mid = lo + (hi - lo) / 2;
+            qmj::fork_join([&] { left = fork_sum(lo, mid); }, [&] { right = fork_sum(mid, hi); });
+            return (left + right);
+        }
+
+        //nested forks far outnumber the workers, so most branches are taken
+        //back and run by the thread that queued them
+        TEST(execution, nested_fork_join) {
+            for (size_t threads : {1, 2, 4, 8}) {
+                qmj::set_parallel_threads(threads);
+                EXPECT_EQ(fork_sum(0, 100000), 100000LL * 99999 / 2);
+            }
+            qmj::set_parallel_threads(0);
+        }
+
+        TEST(execution, fork_join_rethrows) {
+            qmj::set_parallel_threads(4);
+            std::atomic<int> ran(0);
+            EXPECT_THROW(qmj::fork_join([&] {
+                ++ran;
+                throw std::runtime_error("fn1");
+            }, [&] { ++ran; }), std::runtime_error);
+            EXPECT_EQ(ran.load(), 2);
+            EXPECT_THROW(qmj::fork_join([&] { ++ran; }, [&] {
+                ++ran;
+                throw std::logic_error("fn2");
+            }), std::logic_error);
+            EXPECT_EQ(ran.load(), 4);
+            qmj::set_parallel_threads(0);
+        }
+
+        TEST(execution, parallel_sorts) {
+            std::vector<int> data;
+            create_data(data, 1 << 20);
+            std::vector<int> expect(data);
+            std::sort(expect.begin(), expect.end());
+            for (size_t threads : {1, 3, 8}) {
+                qmj::set_parallel_threads(threads);
+                std::vector<int> got(data);
+                qmj::sort(qmj::par, got.begin(), got.end());
+                EXPECT_TRUE(got == expect) << threads << " threads";
+                got = data;
+                qmj::stable_sort(qmj::par, got.begin(), got.end());
+                EXPECT_TRUE(got == expect) << threads << " threads";
+            }
+            qmj::set_parallel_threads(0);
+        }
+    }
+}
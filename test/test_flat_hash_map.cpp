@@ -0,0 +1,153 @@
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/flat_hash_map_qmj.h"
+#include "../QMJSTL/flat_hash_set_qmj.h"
+
+//the group is picked at compile time; build with -D_QMJ_FLAT_SSE2=0 to run
+//these against the 8 byte portable group instead of the SSE2 one
+namespace qmj {
+    namespace test {
+        //a few hash values for many keys, so probe sequences run long and
+        //cross the tombstones erase leaves behind
+        struct clustered_hash {
+            size_t operator()(int k) const { return (size_t(k % 64)); }
+        };
+
+        template<typename Map>
+        void expect_same(const Map &con, const std::unordered_map<int, int> &expect) {
+            ASSERT_EQ(con.size(), expect.size());
+            size_t seen = 0;
+            for (const auto &x : con) {
+                auto iter = expect.find(x.first);
+                ASSERT_TRUE(iter != expect.end()) << x.first;
+                ASSERT_EQ(x.second, iter->second) << x.first;
+                ++seen;
+            }
+            ASSERT_EQ(seen, expect.size());
+            for (const auto &x : expect) {
+                ASSERT_EQ(con.count(x.first), 1u) << x.first;
+                ASSERT_EQ(con.find(x.first)->second, x.second) << x.first;
+            }
+        }
+
+        //random inserts, assignments and erases over a small key range keep
+        //the table near its load limit and full of tombstones; every so
+        //often it is rehashed, reserved, copied, moved or cleared
+        template<typename Map>
+        void check_against_std(const int keys, const int ops) {
+            std::mt19937_64 gen(keys);
+            Map con;
+            std::unordered_map<int, int> expect;
+            for (int op = 0; op != ops; ++op) {
+                const int k = int(gen() % keys);
+                const int v = int(gen() % 1000);
+                switch (gen() % 8) {
+                    case 0:
+                    case 1: {
+                        const bool inserted = con.insert(std::make_pair(k, v)).second;
+                        ASSERT_EQ(inserted, expect.insert(std::make_pair(k, v)).second) << k;
+                        break;
+                    }
+                    case 2:
+                        con[k] = v;
+                        expect[k] = v;
+                        break;
+                    case 3:
+                    case 4:
+                        ASSERT_EQ(con.erase(k), expect.erase(k)) << k;
+                        break;
+                    case 5: {
+                        auto iter = con.find(k);
+                        ASSERT_EQ(iter != con.end(), expect.count(k) != 0) << k;
+                        if (iter != con.end()) {
+                            con.erase(iter);
+                            expect.erase(k);
+                        }
+                        break;
+                    }
+                    case 6:
+                        ASSERT_EQ(con.emplace(k, v).second, expect.emplace(k, v).second) << k;
+                        break;
+                    default:
+                        ASSERT_EQ(con.count(k), expect.count(k)) << k;
+                }
+                ASSERT_LE(con.load_factor(), con.max_load_factor());
+                if (op % 997 == 0) {
+                    switch (op / 997 % 6) {
+                        case 0:
+                            con.rehash(0);
+                            break;
+                        case 1:
+                            con.reserve(size_t(keys) * 2);
+                            break;
+                        case 2: {
+                            Map copy(con);
+                            expect_same(copy, expect);
+                            copy.insert(std::make_pair(keys + 1, 0));
+                            ASSERT_EQ(con.count(keys + 1), 0u);
+                            break;
+                        }
+                        case 3: {
+                            Map copy;
+                            copy = con;
+                            Map moved(std::move(copy));
+                            expect_same(moved, expect);
+                            con = std::move(moved);
+                            break;
+                        }
+                        case 4:
+                            con.rehash(con.size() * 4 + 1);
+                            break;
+                        default:
+                            if (op % 5 == 0) {
+                                con.clear();
+                                expect.clear();
+                                ASSERT_TRUE(con.empty());
+                                ASSERT_TRUE(con.begin() == con.end());
+                            }
+                    }
+                    expect_same(con, expect);
+                }
+            }
+            expect_same(con, expect);
+        }
+
+        TEST(flat_hash_map, matches_std_unordered_map) {
+            for (int keys : {8, 100, 5000})
+                check_against_std<qmj::flat_hash_map<int, int>>(keys, 60000);
+        }
+
+        TEST(flat_hash_map, long_probes_across_tombstones) {
+            for (int keys : {100, 2000})
+                check_against_std<qmj::flat_hash_map<int, int, clustered_hash>>(keys, 40000);
+        }
+
+        TEST(flat_hash_set, matches_std_unordered_set) {
+            std::vector<std::string> words;
+            create_data(words, 4000);
+            qmj::flat_hash_set<std::string> con;
+            std::unordered_set<std::string> expect;
+            std::mt19937_64 gen(9);
+            for (int op = 0; op != 30000; ++op) {
+                const std::string &w = words[gen() % words.size()];
+                if (gen() % 3)
+                    ASSERT_EQ(con.insert(w).second, expect.insert(w).second) << w;
+                else
+                    ASSERT_EQ(con.erase(w), expect.erase(w)) << w;
+            }
+            ASSERT_EQ(con.size(), expect.size());
+            for (const std::string &w : con)
+                ASSERT_EQ(expect.count(w), 1u) << w;
+            for (const std::string &w : words)
+                ASSERT_EQ(con.count(w), expect.count(w)) << w;
+            con.erase(con.begin(), con.end());
+            EXPECT_TRUE(con.empty());
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/unordered_set_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //what qmj::hash<integer> used to be
+        struct identity_hash {
+            size_t operator()(std::uint64_t k) const { return (size_t(k)); }
+        };
+
+        struct chain_stats {
+            size_t histogram[5];
+            size_t longest;
+        };
+
+        //histogram[i] counts the buckets holding i nodes, the last entry
+        //those holding four or more
+        template<typename Hash, typename Policy>
+        chain_stats chains_of(const std::vector<std::uint64_t> &keys) {
+            qmj::unordered_set<std::uint64_t, Hash, std::equal_to<std::uint64_t>,
+                    qmj::allocator<std::uint64_t>, Policy> con(keys.size());
+            con.insert(keys.begin(), keys.end());
+            chain_stats stats = {{0, 0, 0, 0, 0}, 0};
+            for (size_t i = 0; i != con.bucket_count(); ++i) {
+                const size_t len = con.bucket_size(i);
+                ++stats.histogram[len < 4 ? len : 4];
+                if (len > stats.longest)
+                    stats.longest = len;
+            }
+            return (stats);
+        }
+
+        void report_chains(const char *what, const chain_stats &stats) {
+            std::cout << "  " << what << ": longest " << stats.longest << ", buckets by length";
+            for (size_t count : stats.histogram)
+                std::cout << " " << count;
+            std::cout << std::endl;
+        }
+
+        template<typename Policy>
+        void compare_hashes(const char *policy, const std::vector<std::uint64_t> &keys,
+                            const char *pattern) {
+            const chain_stats old_stats = chains_of<identity_hash, Policy>(keys);
+            const chain_stats new_stats = chains_of<qmj::hash<std::uint64_t>, Policy>(keys);
+            std::cout << pattern << " keys, " << policy << std::endl;
+            report_chains("identity", old_stats);
+            report_chains("qmj::hash", new_stats);
+            //a random hash at load <= 1 keeps the longest of 2^12 chains near
+            //ln n / ln ln n, well under 12
+            EXPECT_LT(new_stats.longest, 12u) << pattern << " keys, " << policy;
+        }
+
+        TEST(hash_quality, chain_lengths) {
+            const size_t n = size_t(1) << 12;
+            const std::uint64_t strides[] = {1, 64, 4096, std::uint64_t(1) << 32};
+            const char *patterns[] = {"sequential", "stride 64", "stride 4096", "stride 2^32"};
+            for (int p = 0; p != 4; ++p) {
+                std::vector<std::uint64_t> keys;
+                for (size_t i = 0; i != n; ++i)
+                    keys.push_back(i * strides[p]);
+                compare_hashes<qmj::prime_bucket_policy>("prime", keys, patterns[p]);
+                compare_hashes<qmj::power2_bucket_policy>("power2", keys, patterns[p]);
+                compare_hashes<qmj::fastrange_bucket_policy>("fastrange", keys, patterns[p]);
+            }
+        }
+    }
+}
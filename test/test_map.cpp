@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/execution_qmj.h"
+#include "../QMJSTL/map_qmj.h"
+#include "../QMJSTL/set_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //both batch lookups must hand back what find does, key by key,
+        //hits and misses alike
+        TEST(map, find_batch_matches_find) {
+            std::vector<int> data;
+            create_data(data, 5000);
+            qmj::map<int, int> con;
+            for (size_t i = 0; i < data.size(); i += 2)
+                con.insert(std::make_pair(data[i], -data[i]));
+
+            std::vector<qmj::map<int, int>::iterator> found;
+            con.find_batch(data.begin(), data.end(), std::back_inserter(found));
+            ASSERT_EQ(found.size(), data.size());
+            for (size_t i = 0; i != data.size(); ++i)
+                ASSERT_TRUE(found[i] == con.find(data[i])) << data[i];
+
+            std::vector<long> sorted(data.begin(), data.end());
+            std::sort(sorted.begin(), sorted.end());
+            std::vector<qmj::map<int, int>::const_iterator> sorted_found;
+            const qmj::map<int, int> &ccon = con;
+            ccon.find_batch_sorted(by_value<int>(sorted.begin()), by_value<int>(sorted.end()),
+                                   std::back_inserter(sorted_found));
+            ASSERT_EQ(sorted_found.size(), sorted.size());
+            for (size_t i = 0; i != sorted.size(); ++i)
+                ASSERT_TRUE(sorted_found[i] == ccon.find(int(sorted[i]))) << sorted[i];
+
+            //keys handed out by value, then of another type
+            found.clear();
+            con.find_batch(by_value<int>(sorted.begin()), by_value<int>(sorted.end()), std::back_inserter(found));
+            for (size_t i = 0; i != sorted.size(); ++i)
+                ASSERT_TRUE(found[i] == con.find(int(sorted[i]))) << sorted[i];
+            found.clear();
+            con.find_batch(sorted.begin(), sorted.end(), std::back_inserter(found));
+            for (size_t i = 0; i != sorted.size(); ++i)
+                ASSERT_TRUE(found[i] == con.find(int(sorted[i]))) << sorted[i];
+        }
+
+        //under a transparent comparator the batch compares the caller's
+        //keys as they are, views handed out by value included
+        TEST(map, find_batch_transparent) {
+            std::vector<std::string> words;
+            create_data(words, 2000);
+            qmj::map<std::string, size_t, std::less<>> con;
+            for (size_t i = 0; i < words.size(); i += 3)
+                con.insert(std::make_pair(words[i], i));
+            words.push_back("no such word in the data");
+
+            std::vector<const char *> cstrs;
+            for (const std::string &w : words)
+                cstrs.push_back(w.c_str());
+            std::vector<qmj::map<std::string, size_t, std::less<>>::iterator> found;
+            con.find_batch(cstrs.begin(), cstrs.end(), std::back_inserter(found));
+            ASSERT_EQ(found.size(), words.size());
+            for (size_t i = 0; i != words.size(); ++i)
+                ASSERT_TRUE(found[i] == con.find(words[i])) << words[i];
+
+            found.clear();
+            con.find_batch(by_value<std::string_view>(words.begin()), by_value<std::string_view>(words.end()),
+                           std::back_inserter(found));
+            for (size_t i = 0; i != words.size(); ++i)
+                ASSERT_TRUE(found[i] == con.find(words[i])) << words[i];
+        }
+
+        //reaches the nodes to check the red-black rules: a black root, no
+        //red node with a red child, one black height on every path, parent
+        //links that match, keys in order and the cached begin and end
+        struct checked_set : qmj::set<int> {
+            typedef qmj::set<int> base;
+            typedef base::link_type link_type;
+
+            bool valid() const {
+                const link_type rt = this->get_root();
+                if (rt != this->get_nil() && rt->color != qmj::rbt_black)
+                    return (false);
+                size_t count = 0;
+                const int *prev = nullptr;
+                if (black_height(rt, count, prev) < 0 || count != this->size())
+                    return (false);
+                return (!count || (*begin() == min_key(rt) && *--end() == max_key(rt)));
+            }
+
+        private:
+            int black_height(const link_type t, size_t &count, const int *&prev) const {
+                if (t == this->get_nil())
+                    return (0);
+                for (link_type child : {t->left, t->right})
+                    if (child != this->get_nil() &&
+                        (child->p != t || (t->color == qmj::rbt_red && child->color == qmj::rbt_red)))
+                        return (-1);
+                const int left = black_height(t->left, count, prev);
+                if (left < 0 || (prev && !(*prev < t->value)))
+                    return (-1);
+                prev = &t->value;
+                ++count;
+                const int right = black_height(t->right, count, prev);
+                if (right != left)
+                    return (-1);
+                return (left + (t->color == qmj::rbt_black));
+            }
+
+            int min_key(link_type t) const {
+                while (t->left != this->get_nil())
+                    t = t->left;
+                return (t->value);
+            }
+
+            int max_key(link_type t) const {
+                while (t->right != this->get_nil())
+                    t = t->right;
+                return (t->value);
+            }
+        };
+
+        checked_set make_set(const std::vector<int> &keys) {
+            checked_set con;
+            for (int k : keys)
+                con.insert(k);
+            return (con);
+        }
+
+        //the insert fixup once tested tar->p against grandpar->p, so a
+        //parent on the left was handled as if it were on the right; runs
+        //that keep landing on the left broke the rules within a few keys
+        TEST(set, insert_keeps_red_black_rules) {
+            std::vector<int> keys;
+            create_data(keys, 3000);
+            std::vector<std::vector<int>> orders = {keys, keys, keys};
+            std::sort(orders[1].begin(), orders[1].end());
+            std::sort(orders[2].rbegin(), orders[2].rend());
+            for (const std::vector<int> &order : orders) {
+                checked_set con;
+                for (size_t i = 0; i != order.size(); ++i) {
+                    con.insert(order[i]);
+                    if (i < 100 || i % 97 == 0) {
+                        ASSERT_TRUE(con.valid()) << i;
+                    }
+                }
+                ASSERT_TRUE(con.valid());
+                for (size_t i = 0; i < order.size(); i += 2)
+                    con.erase(order[i]);
+                ASSERT_TRUE(con.valid());
+                EXPECT_EQ(con.size(), order.size() / 2);
+            }
+        }
+
+        TEST(set, split_and_join) {
+            for (int n : {0, 1, 2, 7, 100, 5000}) {
+                std::vector<int> keys;
+                for (int k = 0; k != n; ++k)
+                    keys.push_back(2 * k);
+                for (int cut : {-1, 0, 1, n / 3, n, 2 * n, 2 * n + 5}) {
+                    checked_set left = make_set(keys), right = make_set({-7, 3});
+                    left.split(cut, right);
+                    ASSERT_TRUE(left.valid() && right.valid()) << n << ", " << cut;
+                    std::vector<int> lo, hi;
+                    for (int k : keys)
+                        (k < cut ? lo : hi).push_back(k);
+                    ASSERT_TRUE(std::equal(lo.begin(), lo.end(), left.begin(), left.end())) << n << ", " << cut;
+                    ASSERT_TRUE(std::equal(hi.begin(), hi.end(), right.begin(), right.end())) << n << ", " << cut;
+
+                    left.join(right);
+                    ASSERT_TRUE(left.valid() && right.valid() && right.empty()) << n << ", " << cut;
+                    ASSERT_TRUE(std::equal(keys.begin(), keys.end(), left.begin(), left.end()));
+                }
+
+                //join(value, right) with the key between the two halves
+                const int cut = n / 2 * 2;
+                checked_set left = make_set(keys), right;
+                left.split(cut, right);
+                left.join(cut - 1, right);
+                ASSERT_TRUE(left.valid() && right.empty()) << n;
+                EXPECT_EQ(left.size(), keys.size() + 1);
+                EXPECT_EQ(left.count(cut - 1), 1u);
+            }
+        }
+
+        //sizes from empty to past the fork grain, overlaps from disjoint
+        //through interleaved to one inside the other and identical
+        std::vector<std::pair<std::vector<int>, std::vector<int>>> set_op_inputs() {
+            std::mt19937_64 gen(29);
+            std::vector<std::pair<std::vector<int>, std::vector<int>>> inputs;
+            const size_t sizes[] = {0, 1, 10, 1000, 40000};
+            for (size_t n1 : sizes)
+                for (size_t n2 : sizes)
+                    for (int overlap = 0; overlap != 4; ++overlap) {
+                        std::set<int> a, b;
+                        const int range = int(2 * (n1 + n2) + 2);
+                        while (a.size() != n1)
+                            a.insert(int(gen() % range));
+                        if (overlap == 0)
+                            for (int i = 0; b.size() != n2; ++i)
+                                b.insert(range + i);
+                        else if (overlap == 1)
+                            while (b.size() != n2)
+                                b.insert(int(gen() % range));
+                        else if (overlap == 2)
+                            b.insert(a.begin(), std::next(a.begin(), std::min(n1, n2) / 2));
+                        else
+                            b = a;
+                        inputs.emplace_back(std::vector<int>(a.begin(), a.end()),
+                                            std::vector<int>(b.begin(), b.end()));
+                    }
+            return (inputs);
+        }
+
+        template<typename Op, typename StdOp>
+        void check_set_op(const char *name, Op op, StdOp std_op) {
+            qmj::set_parallel_threads(4);
+            for (const auto &input : set_op_inputs()) {
+                const std::vector<int> &a = input.first, &b = input.second;
+                std::vector<int> expect;
+                std_op(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expect));
+                for (int policy = 0; policy != 3; ++policy) {
+                    checked_set x = make_set(a), y = make_set(b);
+                    op(policy, x, y);
+                    ASSERT_TRUE(x.valid()) << name << ", policy " << policy << ", " << a.size() << " " << b.size();
+                    ASSERT_TRUE(y.empty());
+                    ASSERT_TRUE(std::equal(expect.begin(), expect.end(), x.begin(), x.end()))
+                                                << name << ", policy " << policy << ", " << a.size() << " " << b.size();
+                }
+            }
+            qmj::set_parallel_threads(0);
+        }
+
+        TEST(set, set_operations_match_std) {
+            typedef std::vector<int>::const_iterator iter;
+            typedef std::back_insert_iterator<std::vector<int>> out;
+            check_set_op("union", [](int policy, checked_set &x, checked_set &y) {
+                if (policy == 0)
+                    x.union_with(y);
+                else if (policy == 1)
+                    x.union_with(qmj::seq, y);
+                else
+                    x.union_with(qmj::par, y);
+            }, std::set_union<iter, iter, out>);
+            check_set_op("intersection", [](int policy, checked_set &x, checked_set &y) {
+                if (policy == 0)
+                    x.intersect_with(y);
+                else if (policy == 1)
+                    x.intersect_with(qmj::seq, y);
+                else
+                    x.intersect_with(qmj::par, y);
+            }, std::set_intersection<iter, iter, out>);
+            check_set_op("difference", [](int policy, checked_set &x, checked_set &y) {
+                if (policy == 0)
+                    x.difference_with(y);
+                else if (policy == 1)
+                    x.difference_with(qmj::seq, y);
+                else
+                    x.difference_with(qmj::par, y);
+            }, std::set_difference<iter, iter, out>);
+        }
+
+        TEST(map, extract_and_reinsert) {
+            qmj::map<int, std::string> con, other;
+            for (int k = 0; k != 100; ++k)
+                con.insert(std::make_pair(k, std::to_string(k)));
+
+            auto nh = con.extract(42);
+            ASSERT_FALSE(nh.empty());
+            EXPECT_EQ(nh.key(), 42);
+            EXPECT_EQ(nh.mapped(), "42");
+            EXPECT_EQ(con.size(), 99u);
+            EXPECT_EQ(con.count(42), 0u);
+
+            //the key of a handle may change before it is linked again
+            nh.key() = 1000;
+            const std::string *value = &nh.mapped();
+            auto ret = con.insert(std::move(nh));
+            EXPECT_TRUE(ret.inserted);
+            EXPECT_TRUE(ret.node.empty());
+            EXPECT_TRUE(nh.empty());
+            ASSERT_TRUE(ret.position != con.end());
+            EXPECT_EQ(ret.position->first, 1000);
+            EXPECT_EQ(&ret.position->second, value);
+
+            //a taken key hands the node back untouched
+            nh = con.extract(con.find(7));
+            nh.key() = 8;
+            ret = con.insert(std::move(nh));
+            EXPECT_FALSE(ret.inserted);
+            ASSERT_FALSE(ret.node.empty());
+            EXPECT_EQ(ret.node.mapped(), "7");
+            EXPECT_EQ(ret.position->first, 8);
+            EXPECT_EQ(ret.position->second, "8");
+            ret = other.insert(std::move(ret.node));
+            EXPECT_TRUE(ret.inserted);
+            EXPECT_EQ(other.size(), 1u);
+            EXPECT_EQ(other.find(8)->second, "7");
+            EXPECT_EQ(con.size(), 99u);
+
+            //an empty handle inserts nothing
+            auto none = con.extract(12345);
+            EXPECT_TRUE(none.empty());
+            EXPECT_FALSE(bool(none));
+            ret = con.insert(std::move(none));
+            EXPECT_FALSE(ret.inserted);
+            EXPECT_TRUE(ret.position == con.end());
+            EXPECT_TRUE(ret.node.empty());
+            EXPECT_EQ(con.size(), 99u);
+
+            qmj::multimap<int, int> multi;
+            EXPECT_TRUE(multi.insert(decltype(multi)::node_handle_type()) == multi.end());
+            multi.insert(std::make_pair(1, 1));
+            multi.insert(std::make_pair(1, 2));
+            auto mh = multi.extract(1);
+            EXPECT_EQ(multi.size(), 1u);
+            EXPECT_EQ(multi.insert(std::move(mh))->first, 1);
+            EXPECT_EQ(multi.count(1), 2u);
+        }
+
+        //merge moves what std's merge moves and leaves the rest, the keys
+        //*this already holds, in the source
+        template<typename Target, typename Source, typename StdTarget, typename StdSource>
+        void check_merge(const std::vector<int> &to, const std::vector<int> &from) {
+            Target con;
+            Source source;
+            StdTarget expect;
+            StdSource expect_source;
+            for (int k : to) {
+                con.insert(std::make_pair(k, k));
+                expect.insert(std::make_pair(k, k));
+            }
+            for (int k : from) {
+                source.insert(std::make_pair(k, -k));
+                expect_source.insert(std::make_pair(k, -k));
+            }
+            con.merge(source);
+            expect.merge(expect_source);
+            ASSERT_EQ(con.size(), expect.size());
+            ASSERT_EQ(source.size(), expect_source.size());
+            ASSERT_TRUE(std::equal(con.begin(), con.end(), expect.begin(), expect.end(),
+                                   [](const std::pair<const int, int> &x, const std::pair<const int, int> &y) {
+                                       return (x.first == y.first && x.second == y.second);
+                                   }));
+            ASSERT_TRUE(std::equal(source.begin(), source.end(), expect_source.begin(), expect_source.end(),
+                                   [](const std::pair<const int, int> &x, const std::pair<const int, int> &y) {
+                                       return (x.first == y.first && x.second == y.second);
+                                   }));
+        }
+
+        TEST(map, merge_leaves_duplicates_in_source) {
+            const std::vector<int> to = {1, 3, 5, 7, 9, 9}, from = {0, 1, 1, 2, 3, 9, 10};
+            typedef qmj::map<int, int> umap;
+            typedef qmj::multimap<int, int> mmap;
+            typedef std::map<int, int> std_umap;
+            typedef std::multimap<int, int> std_mmap;
+            check_merge<umap, umap, std_umap, std_umap>(to, from);
+            check_merge<umap, mmap, std_umap, std_mmap>(to, from);
+            check_merge<mmap, umap, std_mmap, std_umap>(to, from);
+            check_merge<mmap, mmap, std_mmap, std_mmap>(to, from);
+            check_merge<umap, umap, std_umap, std_umap>({}, from);
+            check_merge<umap, mmap, std_umap, std_mmap>(to, {});
+
+            //the tree a merge builds still keeps the red-black rules
+            checked_set con;
+            qmj::set<int> source;
+            for (int k = 0; k != 3000; ++k)
+                (k % 3 ? con : source).insert(k % 5 ? k : k / 2);
+            con.merge(source);
+            EXPECT_TRUE(con.valid());
+        }
+    }
+}
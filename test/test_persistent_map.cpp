@@ -0,0 +1,74 @@
+#include <map>
+#include <random>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/persistent_map_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //counts the live copies and throws from the copy constructor once
+        //copies_left reaches zero
+        struct throwing_value {
+            static int live;
+            static int copies_left;
+
+            explicit throwing_value(int v) : v(v) { ++live; }
+
+            throwing_value(const throwing_value &x) : v(x.v) {
+                if (copies_left >= 0 && copies_left-- == 0)
+                    throw std::runtime_error("copy");
+                ++live;
+            }
+
+            ~throwing_value() { --live; }
+
+            int v;
+        };
+
+        int throwing_value::live = 0;
+        int throwing_value::copies_left = -1;
+
+        typedef qmj::persistent_map<int, throwing_value> throwing_map;
+
+        bool same_as(const throwing_map &con, const std::map<int, int> &model) {
+            if (con.size() != model.size())
+                return false;
+            auto iter = model.begin();
+            for (const auto &val : con) {
+                if (val.first != iter->first || val.second.v != iter->second)
+                    return false;
+                ++iter;
+            }
+            return true;
+        }
+
+        //a copy that throws anywhere on the path, including inside the
+        //rotations, leaves the tree as it was and leaks no node
+        TEST(persistent_map, throwing_copy) {
+            std::mt19937 gen(5);
+            {
+                throwing_map con;
+                std::map<int, int> model;
+                std::vector<throwing_map> snapshots;
+                for (int round = 0; round != 4000; ++round) {
+                    int key = int(gen() % 512);
+                    throwing_value::copies_left = int(gen() % 12);
+                    try {
+                        if (gen() % 3) {
+                            con.insert_or_assign(key, throwing_value(round));
+                            model[key] = round;
+                        } else if (con.erase(key))
+                            model.erase(key);
+                    } catch (const std::runtime_error &) {
+                    }
+                    throwing_value::copies_left = -1;
+                    ASSERT_TRUE(same_as(con, model)) << "tree changed by a throwing update";
+                    if (round % 500 == 0)
+                        snapshots.push_back(con.snapshot());
+                }
+            }
+            EXPECT_EQ(throwing_value::live, 0) << "nodes leaked";
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //no default constructor, so it cannot sit in a temporary_buffer
+        struct tagged {
+            explicit tagged(int v) : v(v), name(std::to_string(v)) {}
+
+            int v;
+            std::string name;
+        };
+
+        struct record {
+            explicit record(std::int64_t id) : id(id) {}
+
+            std::int64_t id;
+        };
+
+        struct record_id {
+            std::int64_t operator()(const record &r) const { return (r.id); }
+        };
+
+        //a move that may throw takes the permutation path
+        struct throwing_move {
+            explicit throwing_move(int v) : v(v) {}
+
+            throwing_move(throwing_move &&x) noexcept(false) : v(x.v) {}
+
+            throwing_move &operator=(throwing_move &&x) noexcept(false) {
+                v = x.v;
+                return (*this);
+            }
+
+            int v;
+        };
+
+        template<typename Key, typename Value, typename KeyOf>
+        void expect_sorted_by_key(const std::vector<Key> &keys, const std::vector<Value> &values,
+                                  const std::vector<std::pair<std::int64_t, int>> &expect, KeyOf key_of) {
+            ASSERT_EQ(keys.size(), expect.size());
+            for (size_t i = 0; i != keys.size(); ++i) {
+                ASSERT_EQ(key_of(keys[i]), expect[i].first) << i;
+                ASSERT_EQ(values[i].v, expect[i].second) << i;
+            }
+        }
+
+        TEST(sort_by_key, stable_without_default_constructor) {
+            std::vector<int> data;
+            create_data(data, 100000);
+            std::vector<std::pair<std::int64_t, int>> expect;
+            std::vector<std::int32_t> keys;
+            std::vector<tagged> values;
+            for (size_t i = 0; i != data.size(); ++i) {
+                keys.push_back(data[i] % 1000 - 500);
+                values.emplace_back(int(i));
+                expect.emplace_back(keys.back(), int(i));
+            }
+            std::stable_sort(expect.begin(), expect.end(),
+                             [](const std::pair<std::int64_t, int> &l, const std::pair<std::int64_t, int> &r) {
+                                 return (l.first < r.first);
+                             });
+            qmj::sort_by_key(keys.begin(), keys.end(), values.begin());
+            expect_sorted_by_key(keys, values, expect, [](std::int32_t k) { return (std::int64_t(k)); });
+            for (const tagged &t : values)
+                ASSERT_EQ(t.name, std::to_string(t.v));
+        }
+
+        TEST(sort_by_key, key_projection) {
+            std::vector<int> data;
+            create_data(data, 50000);
+            std::vector<std::pair<std::int64_t, int>> expect;
+            std::vector<record> keys;
+            std::vector<tagged> values;
+            for (size_t i = 0; i != data.size(); ++i) {
+                const std::int64_t id = (std::int64_t(data[i] % 777) - 300) * 0x100000001ll;
+                keys.emplace_back(id);
+                values.emplace_back(int(i));
+                expect.emplace_back(id, int(i));
+            }
+            std::stable_sort(expect.begin(), expect.end(),
+                             [](const std::pair<std::int64_t, int> &l, const std::pair<std::int64_t, int> &r) {
+                                 return (l.first < r.first);
+                             });
+            qmj::sort_by_key(keys.begin(), keys.end(), values.begin(), record_id());
+            expect_sorted_by_key(keys, values, expect, record_id());
+        }
+
+        TEST(sort_by_key, throwing_move_permutes) {
+            std::vector<std::pair<std::int64_t, int>> expect;
+            std::vector<std::uint16_t> keys;
+            std::vector<throwing_move> values;
+            for (int i = 0; i != 5000; ++i) {
+                keys.push_back(std::uint16_t((i * 7919) % 613));
+                values.emplace_back(i);
+                expect.emplace_back(keys.back(), i);
+            }
+            std::stable_sort(expect.begin(), expect.end(),
+                             [](const std::pair<std::int64_t, int> &l, const std::pair<std::int64_t, int> &r) {
+                                 return (l.first < r.first);
+                             });
+            qmj::sort_by_key(keys.begin(), keys.end(), values.begin());
+            expect_sorted_by_key(keys, values, expect, [](std::uint16_t k) { return (std::int64_t(k)); });
+        }
+    }
+}
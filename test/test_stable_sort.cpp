@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/algorithm_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //first is the key, second the input position; the comparators only
+        //look at the key, so any reordering of equal keys shows
+        typedef std::pair<int, int> keyed;
+
+        struct key_less {
+            bool operator()(const keyed &x, const keyed &y) const { return (x.first < y.first); }
+        };
+
+        struct key_greater {
+            bool operator()(const keyed &x, const keyed &y) const { return (x.first > y.first); }
+        };
+
+        //patterns aimed at the run detection: ascending and descending runs
+        //of repeated keys, runs shorter and longer than sort_threshold, a
+        //few swaps in sorted input and plain random keys over a small range
+        std::vector<keyed> stable_input(const size_t n, const int pattern, std::mt19937_64 &gen) {
+            std::vector<keyed> data(n);
+            for (size_t i = 0; i != n; ++i) {
+                int key;
+                switch (pattern) {
+                    case 0:
+                        key = int(gen() % 16);
+                        break;
+                    case 1:
+                        key = int(i / 3);
+                        break;
+                    case 2:
+                        key = int((n - i) / 3);
+                        break;
+                    case 3:
+                        key = int(i % 50);
+                        break;
+                    case 4:
+                        key = int(i % 7 < 4 ? i % 7 : 7 - i % 7) + int(i / 100);
+                        break;
+                    default:
+                        key = int(i / 2);
+                }
+                data[i] = keyed(key, int(i));
+            }
+            if (pattern == 5)
+                for (size_t i = 0; n > 1 && i != n / 50 + 1; ++i)
+                    std::swap(data[gen() % n].first, data[gen() % n].first);
+            return (data);
+        }
+
+        template<typename Comp>
+        void check_stable_sort(const Comp &cmp) {
+            std::mt19937_64 gen(3);
+            std::vector<size_t> sizes;
+            for (size_t n = 0; n <= 2 * sort_threshold + 2; ++n)
+                sizes.push_back(n);
+            sizes.push_back(1000);
+            sizes.push_back(4099);
+            sizes.push_back(100003);
+            for (size_t n : sizes)
+                for (int pattern = 0; pattern != 6; ++pattern) {
+                    std::vector<keyed> expect = stable_input(n, pattern, gen);
+                    std::vector<keyed> got = expect;
+                    std::list<keyed> got_list(expect.begin(), expect.end());
+                    std::stable_sort(expect.begin(), expect.end(), cmp);
+                    qmj::stable_sort(got.begin(), got.end(), cmp);
+                    ASSERT_TRUE(expect == got) << "n " << n << ", pattern " << pattern;
+                    qmj::stable_sort(got_list.begin(), got_list.end(), cmp);
+                    ASSERT_TRUE(std::equal(expect.begin(), expect.end(), got_list.begin()))
+                                                << "list, n " << n << ", pattern " << pattern;
+                }
+        }
+
+        TEST(stable_sort, matches_std_on_equal_keys) {
+            check_stable_sort(key_less());
+            check_stable_sort(key_greater());
+        }
+    }
+}
@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+#include "gtest/gtest.h"
+#include "test_create_data.h"
+#include "../QMJSTL/unordered_map_qmj.h"
+
+namespace qmj {
+    namespace test {
+        //every key sits in the bucket bucket(key) names, and all count(key)
+        //copies of it sit there
+        template<typename Map>
+        void check_buckets(const Map &con) {
+            std::map<typename Map::key_type, std::pair<size_t, size_t>> seen;
+            size_t total = 0;
+            for (size_t i = 0; i != con.bucket_count(); ++i) {
+                size_t n = 0;
+                for (auto iter = con.begin(i); iter != con.end(i); ++iter, ++n) {
+                    ASSERT_EQ(con.bucket(iter->first), i);
+                    auto &at = seen.insert(std::make_pair(iter->first, std::make_pair(i, size_t(0)))).first->second;
+                    ASSERT_EQ(at.first, i);
+                    ++at.second;
+                }
+                ASSERT_EQ(con.bucket_size(i), n);
+                total += n;
+            }
+            ASSERT_EQ(total, con.size());
+            for (const auto &x : seen)
+                ASSERT_EQ(x.second.second, con.count(x.first));
+        }
+
+        //the const bucket queries answer for the new table while a migration
+        //is pending, without moving a node
+        TEST(unordered_map, const_bucket_interface_while_rehashing) {
+            std::vector<int> data;
+            create_data(data, 5000);
+            qmj::unordered_map<int, int> con;
+            con.incremental_rehash(true);
+            bool checked = false;
+            for (int v : data) {
+                con.insert(std::make_pair(v, v));
+                if (con.rehashing() && !checked) {
+                    const auto &ccon = con;
+                    check_buckets(ccon);
+                    ASSERT_TRUE(con.rehashing());
+                    checked = true;
+                } else if (!con.rehashing())
+                    checked = false;
+            }
+            check_buckets(static_cast<const qmj::unordered_map<int, int> &>(con));
+        }
+
+        //a non-positive or NaN bound is clamped instead of turning the
+        //bucket count computations into casts of infinity
+        TEST(unordered_map, max_load_factor_clamped) {
+            qmj::unordered_map<int, int> con;
+            for (int i = 0; i != 100; ++i)
+                con.insert(std::make_pair(i, i));
+            for (float z : {0.0f, -1.0f, std::numeric_limits<float>::quiet_NaN(),
+                            std::numeric_limits<float>::infinity()}) {
+                con.max_load_factor(z);
+                EXPECT_GT(con.max_load_factor(), 0.0f);
+                EXPECT_TRUE(std::isfinite(con.max_load_factor()));
+                con.insert(std::make_pair(100 + int(con.size()), 0));
+                con.rehash(0);
+                EXPECT_LE(con.load_factor(), con.max_load_factor());
+            }
+            EXPECT_EQ(con.size(), 104u);
+        }
+
+        //the multiply-shift takes the whole hash, so counts past 2^32 are
+        //all reachable, and any count is accepted
+        TEST(unordered_map, fastrange_bucket_policy) {
+            typedef qmj::fastrange_bucket_policy policy;
+            if (sizeof(size_t) == 8) {
+                const size_t n = (size_t(1) << 33) + 3;
+                EXPECT_EQ(policy::index(~size_t(0), n), n - 1);
+                EXPECT_GT(policy::index(size_t(1) << 63, n), size_t(1) << 32);
+            }
+            for (size_t n : {size_t(6), size_t(7), size_t(12), size_t(1000)})
+                for (size_t h : {size_t(0), size_t(12345), ~size_t(0)})
+                    EXPECT_LT(policy::index(h, n), n);
+            for (size_t n = 1; n < 100000; n = n * 3 / 2 + 1)
+                EXPECT_GE(policy::bucket_count(n), n);
+
+            std::vector<int> data;
+            create_data(data, 20000);
+            qmj::unordered_map<int, int, qmj::hash<int>, std::equal_to<int>,
+                    qmj::allocator<std::pair<const int, int>>, policy> con;
+            for (int v : data)
+                con.insert(std::make_pair(v, -v));
+            EXPECT_EQ(con.size(), data.size());
+            for (int v : data)
+                ASSERT_EQ(con.find(v)->second, -v);
+            EXPECT_TRUE(con.find(-1) == con.end());
+        }
+
+        //hands out pair<int, int> by value, so nothing a batch keeps may
+        //point into the dereferenced element
+        struct pair_by_value_iterator {
+            typedef std::forward_iterator_tag iterator_category;
+            typedef std::pair<int, int> value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef std::pair<int, int> reference;
+
+            std::pair<int, int> operator*() const { return (std::make_pair(*cur, -*cur)); }
+
+            pair_by_value_iterator &operator++() {
+                ++cur;
+                return (*this);
+            }
+
+            bool operator==(const pair_by_value_iterator &x) const { return (cur == x.cur); }
+
+            bool operator!=(const pair_by_value_iterator &x) const { return (cur != x.cur); }
+
+            const int *cur;
+        };
+
+        //insert_batch must leave the table insert would, and find_batch
+        //answer what find does, also while a migration is pending
+        template<typename Map>
+        void check_batches(const bool incremental) {
+            std::vector<int> data;
+            create_data(data, 20000);
+            const size_t distinct = data.size();
+            for (size_t i = 0; i < distinct; i += 7)
+                data.push_back(int(data[i]));
+            std::vector<std::pair<int, int>> pairs;
+            for (int v : data)
+                pairs.push_back(std::make_pair(v, -v));
+
+            Map expect, from_pairs, from_proxies;
+            from_pairs.incremental_rehash(incremental);
+            from_proxies.incremental_rehash(incremental);
+            bool saw_rehashing = false;
+            for (size_t first = 0; first < data.size(); first += 1000) {
+                const size_t last = std::min(first + 1000, data.size());
+                for (size_t i = first; i != last; ++i)
+                    expect.insert(pairs[i]);
+                from_pairs.insert_batch(pairs.begin() + first, pairs.begin() + last);
+                from_proxies.insert_batch(pair_by_value_iterator{data.data() + first},
+                                          pair_by_value_iterator{data.data() + last});
+                saw_rehashing |= from_pairs.rehashing();
+
+                std::vector<int> keys(data.begin(), data.begin() + last);
+                keys.push_back(-1);
+                keys.push_back(int(data.size()) + 5);
+                std::vector<typename Map::const_iterator> found;
+                const Map &con = from_pairs;
+                con.find_batch(keys.begin(), keys.end(), std::back_inserter(found));
+                ASSERT_EQ(found.size(), keys.size());
+                for (size_t i = 0; i != keys.size(); ++i)
+                    ASSERT_TRUE(found[i] == con.find(keys[i])) << keys[i];
+            }
+            EXPECT_EQ(saw_rehashing, incremental);
+            ASSERT_EQ(from_pairs.size(), expect.size());
+            ASSERT_EQ(from_proxies.size(), expect.size());
+            for (int v : data) {
+                ASSERT_EQ(from_pairs.count(v), expect.count(v));
+                ASSERT_EQ(from_proxies.count(v), expect.count(v));
+                ASSERT_EQ(from_pairs.find(v)->second, -v);
+            }
+        }
+
+        TEST(unordered_map, insert_and_find_batch) {
+            check_batches<qmj::unordered_map<int, int>>(false);
+            check_batches<qmj::unordered_map<int, int>>(true);
+            check_batches<qmj::unordered_multimap<int, int>>(false);
+            check_batches<qmj::unordered_multimap<int, int>>(true);
+        }
+
+        //a transparent table hashes and compares the caller's keys as they
+        //are, views handed out by value included
+        TEST(unordered_map, find_batch_transparent) {
+            typedef qmj::unordered_map<std::string, size_t, qmj::hash<std::string>, std::equal_to<>> map_type;
+            std::vector<std::string> words;
+            create_data(words, 2000);
+            map_type con;
+            for (size_t i = 0; i < words.size(); i += 3)
+                con.insert(std::make_pair(words[i], i));
+            words.push_back("no such word in the data");
+
+            std::vector<const char *> cstrs;
+            for (const std::string &w : words)
+                cstrs.push_back(w.c_str());
+            std::vector<map_type::iterator> found;
+            con.find_batch(cstrs.begin(), cstrs.end(), std::back_inserter(found));
+            ASSERT_EQ(found.size(), words.size());
+            for (size_t i = 0; i != words.size(); ++i)
+                ASSERT_TRUE(found[i] == con.find(words[i])) << words[i];
+
+            found.clear();
+            con.find_batch(by_value<std::string_view>(words.begin()), by_value<std::string_view>(words.end()),
+                           std::back_inserter(found));
+            for (size_t i = 0; i != words.size(); ++i)
+                ASSERT_TRUE(found[i] == con.find(words[i])) << words[i];
+        }
+
+        TEST(unordered_map, extract_and_reinsert) {
+            qmj::unordered_map<int, std::string> con, other;
+            for (int k = 0; k != 100; ++k)
+                con.insert(std::make_pair(k, std::to_string(k)));
+
+            auto nh = con.extract(42);
+            ASSERT_FALSE(nh.empty());
+            EXPECT_EQ(nh.key(), 42);
+            EXPECT_EQ(con.size(), 99u);
+            EXPECT_TRUE(con.find(42) == con.end());
+            nh.key() = 1000;
+            const std::string *value = &nh.mapped();
+            auto ret = con.insert(std::move(nh));
+            EXPECT_TRUE(ret.inserted);
+            EXPECT_TRUE(ret.node.empty());
+            EXPECT_EQ(ret.position->first, 1000);
+            EXPECT_EQ(&ret.position->second, value);
+            EXPECT_TRUE(con.find(1000) == ret.position);
+
+            nh = con.extract(con.find(7));
+            nh.key() = 8;
+            ret = con.insert(std::move(nh));
+            EXPECT_FALSE(ret.inserted);
+            ASSERT_FALSE(ret.node.empty());
+            EXPECT_EQ(ret.node.mapped(), "7");
+            EXPECT_EQ(ret.position->second, "8");
+            ret = other.insert(std::move(ret.node));
+            EXPECT_TRUE(ret.inserted);
+            EXPECT_EQ(other.find(8)->second, "7");
+
+            auto none = con.extract(12345);
+            EXPECT_TRUE(none.empty());
+            ret = con.insert(std::move(none));
+            EXPECT_FALSE(ret.inserted);
+            EXPECT_TRUE(ret.position == con.end());
+            EXPECT_EQ(con.size(), 99u);
+
+            qmj::unordered_multimap<int, int> multi;
+            EXPECT_TRUE(multi.insert(decltype(multi)::node_handle_type()) == multi.end());
+            multi.insert(std::make_pair(1, 1));
+            multi.insert(std::make_pair(1, 2));
+            auto mh = multi.extract(1);
+            EXPECT_EQ(multi.size(), 1u);
+            EXPECT_EQ(multi.insert(std::move(mh))->first, 1);
+            EXPECT_EQ(multi.count(1), 2u);
+        }
+
+        template<typename Map>
+        std::multiset<std::pair<int, int>> sorted_copy(const Map &con) {
+            return (std::multiset<std::pair<int, int>>(con.begin(), con.end()));
+        }
+
+        template<typename Target, typename Source, typename StdTarget, typename StdSource>
+        void check_merge(const std::vector<int> &to, const std::vector<int> &from) {
+            Target con;
+            Source source;
+            StdTarget expect;
+            StdSource expect_source;
+            for (int k : to) {
+                con.insert(std::make_pair(k, k));
+                expect.insert(std::make_pair(k, k));
+            }
+            for (int k : from) {
+                source.insert(std::make_pair(k, -k));
+                expect_source.insert(std::make_pair(k, -k));
+            }
+            con.merge(source);
+            expect.merge(expect_source);
+            ASSERT_TRUE(sorted_copy(con) == sorted_copy(expect));
+            ASSERT_TRUE(sorted_copy(source) == sorted_copy(expect_source));
+            check_buckets(static_cast<const Target &>(con));
+            check_buckets(static_cast<const Source &>(source));
+        }
+
+        TEST(unordered_map, merge_leaves_duplicates_in_source) {
+            std::vector<int> to, from;
+            for (int k = 0; k != 300; ++k) {
+                to.push_back(k * 3);
+                from.push_back(k * 2);
+                if (k % 7 == 0) {
+                    to.push_back(k * 3);
+                    from.push_back(k * 2);
+                }
+            }
+            typedef qmj::unordered_map<int, int> umap;
+            typedef qmj::unordered_multimap<int, int> mmap;
+            typedef std::unordered_map<int, int> std_umap;
+            typedef std::unordered_multimap<int, int> std_mmap;
+            check_merge<umap, umap, std_umap, std_umap>(to, from);
+            check_merge<umap, mmap, std_umap, std_mmap>(to, from);
+            check_merge<mmap, umap, std_mmap, std_umap>(to, from);
+            check_merge<mmap, mmap, std_mmap, std_mmap>(to, from);
+            check_merge<umap, umap, std_umap, std_umap>({}, from);
+            check_merge<umap, mmap, std_umap, std_mmap>(to, {});
+        }
+
+        //counts every hash a table asks for
+        struct counting_string_hash : qmj::hash<std::string> {
+            static size_t calls;
+
+            template<typename K>
+            size_t operator()(const K &k) const {
+                ++calls;
+                return (qmj::hash<std::string>::operator()(k));
+            }
+        };
+
+        size_t counting_string_hash::calls = 0;
+
+        //string keys cache their codes: an insertion hashes its key once, and
+        //moving nodes between tables or walking them hashes nothing
+        void check_cached_codes(const bool incremental) {
+            qmj::unordered_map<std::string, int, counting_string_hash> con;
+            con.incremental_rehash(incremental);
+            counting_string_hash::calls = 0;
+            for (int i = 0; i != 20000; ++i)
+                con.insert(std::make_pair(std::to_string(i * 7), i));
+            ASSERT_EQ(counting_string_hash::calls, 20000u);
+            for (int i = 0; i < 20000; i += 3)
+                ASSERT_EQ(con.erase(std::to_string(i * 7)), 1u);
+            const size_t left = con.size();
+
+            counting_string_hash::calls = 0;
+            const auto &ccon = con;
+            ASSERT_EQ(size_t(std::distance(ccon.begin(), ccon.end())), left);
+            con.rehash(con.bucket_count() * 4);
+            ASSERT_EQ(size_t(std::distance(ccon.begin(), ccon.end())), left);
+            con.shrink_to_fit();
+            ASSERT_EQ(size_t(std::distance(ccon.begin(), ccon.end())), left);
+            ASSERT_EQ(counting_string_hash::calls, 0u);
+
+            check_buckets(ccon);
+            for (int i = 0; i != 20000; ++i)
+                ASSERT_EQ(con.count(std::to_string(i * 7)), i % 3 ? 1u : 0u);
+        }
+
+        TEST(unordered_map, cached_codes_skip_the_hasher) {
+            check_cached_codes(false);
+            check_cached_codes(true);
+        }
+
+        //a full walk visits every element once and a bucket's nodes in one
+        //run, in the order its local walk gives them. mid-migration a bucket
+        //of the new table is spread over both tables, only its members are
+        //compared then
+        template<typename Map>
+        void check_iteration(const Map &con, const std::multiset<std::pair<int, int>> &expect) {
+            typedef const typename Map::value_type *pointer;
+            ASSERT_TRUE(sorted_copy(con) == expect);
+            std::vector<std::vector<pointer>> runs(con.bucket_count());
+            size_t last = con.bucket_count();
+            for (auto iter = con.begin(); iter != con.end(); ++iter) {
+                const size_t i = con.bucket(iter->first);
+                if (!con.rehashing()) {
+                    ASSERT_TRUE(i == last || runs[i].empty());
+                }
+                last = i;
+                runs[i].push_back(&*iter);
+            }
+            for (size_t i = 0; i != con.bucket_count(); ++i) {
+                std::vector<pointer> local;
+                for (auto iter = con.begin(i); iter != con.end(i); ++iter)
+                    local.push_back(&*iter);
+                if (con.rehashing()) {
+                    std::sort(runs[i].begin(), runs[i].end());
+                    std::sort(local.begin(), local.end());
+                }
+                ASSERT_TRUE(runs[i] == local);
+            }
+            check_buckets(con);
+        }
+
+        //equal keys stay next to each other through erase and rehash
+        template<typename Map>
+        void check_equal_runs(const Map &con, const std::multiset<std::pair<int, int>> &expect) {
+            std::set<int> done;
+            for (auto iter = con.begin(); iter != con.end();) {
+                const int k = iter->first;
+                ASSERT_TRUE(done.insert(k).second);
+                //equal_range hands back the same nodes the walk reaches
+                auto range = con.equal_range(k);
+                size_t n = 0;
+                for (; iter != con.end() && iter->first == k; ++iter, ++range.first, ++n) {
+                    ASSERT_TRUE(range.first != range.second);
+                    ASSERT_EQ(&*range.first, &*iter);
+                }
+                ASSERT_TRUE(range.first == range.second);
+                ASSERT_EQ(n, con.count(k));
+                ASSERT_EQ(n, size_t(std::distance(expect.lower_bound(std::make_pair(k, INT_MIN)),
+                                                  expect.upper_bound(std::make_pair(k, INT_MAX)))));
+            }
+        }
+
+        void check_erase_and_rehash(const bool incremental) {
+            qmj::unordered_multimap<int, int> con;
+            std::multiset<std::pair<int, int>> expect;
+            con.incremental_rehash(incremental);
+            for (int i = 0; i != 8000; ++i) {
+                const int k = i % 7 ? i : i % 700;
+                con.insert(std::make_pair(k, i));
+                expect.insert(std::make_pair(k, i));
+                if (i % 997 == 0) {
+                    check_iteration(static_cast<const decltype(con) &>(con), expect);
+                    check_equal_runs(static_cast<const decltype(con) &>(con), expect);
+                }
+            }
+            for (int i = 0; i < 8000; i += 5) {
+                const int k = i % 7 ? i : i % 700;
+                auto iter = con.find(k);
+                ASSERT_TRUE(iter != con.end());
+                expect.erase(expect.find(*iter));
+                con.erase(iter);
+            }
+            for (int k = 0; k < 700; k += 3) {
+                auto first = expect.lower_bound(std::make_pair(k, INT_MIN));
+                auto last = expect.upper_bound(std::make_pair(k, INT_MAX));
+                ASSERT_EQ(con.erase(k), size_t(std::distance(first, last)));
+                expect.erase(first, last);
+            }
+            const auto &ccon = con;
+            check_iteration(ccon, expect);
+            check_equal_runs(ccon, expect);
+            con.rehash(con.bucket_count() * 3);
+            check_iteration(ccon, expect);
+            check_equal_runs(ccon, expect);
+            con.shrink_to_fit();
+            check_iteration(ccon, expect);
+            check_equal_runs(ccon, expect);
+        }
+
+        TEST(unordered_multimap, iteration_after_erase_and_rehash) {
+            check_erase_and_rehash(false);
+            check_erase_and_rehash(true);
+        }
+
+        //counts the hashes and comparisons that are handed a std::string as
+        //the probe, which a lookup by a view or a const char * never needs
+        struct string_probe_hash : qmj::hash<std::string> {
+            static size_t strings;
+
+            size_t operator()(const std::string &s) const {
+                ++strings;
+                return (qmj::hash<std::string>::operator()(s));
+            }
+
+            size_t operator()(const char *s) const { return (qmj::hash<std::string>::operator()(s)); }
+
+            size_t operator()(std::string_view s) const { return (qmj::hash<std::string>::operator()(s)); }
+        };
+
+        struct string_probe_equal {
+            typedef void is_transparent;
+            static size_t strings;
+
+            bool operator()(const std::string &x, const std::string &y) const {
+                ++strings;
+                return (x == y);
+            }
+
+            template<typename K>
+            bool operator()(const K &x, const std::string &y) const { return (y == x); }
+        };
+
+        size_t string_probe_hash::strings = 0;
+        size_t string_probe_equal::strings = 0;
+
+        template<typename Map>
+        void check_transparent_lookup() {
+            std::vector<std::string> words;
+            create_data(words, 3000);
+            std::sort(words.begin(), words.end());
+            words.erase(std::unique(words.begin(), words.end()), words.end());
+            Map con;
+            for (size_t i = 0; i < words.size(); i += 2) {
+                con.insert(std::make_pair(words[i], i));
+                if (i % 6 == 0)
+                    con.insert(std::make_pair(words[i], i + 1));
+            }
+            words.push_back("no such word in the data");
+
+            string_probe_hash::strings = 0;
+            string_probe_equal::strings = 0;
+            const Map &ccon = con;
+            for (size_t i = 0; i != words.size(); ++i) {
+                const std::string &w = words[i];
+                const std::string_view view(w);
+                const size_t n = con.count(w.c_str());
+                ASSERT_EQ(ccon.count(view), n);
+
+                auto iter = con.find(w.c_str());
+                ASSERT_EQ(iter == con.end(), n == 0) << w;
+                if (n) {
+                    ASSERT_EQ(iter->first, w);
+                }
+                auto citer = ccon.find(view);
+                ASSERT_TRUE(citer == ccon.find(w.c_str()));
+
+                auto range = con.equal_range(w.c_str());
+                auto crange = ccon.equal_range(view);
+                size_t in_range = 0;
+                for (; range.first != range.second; ++range.first, ++crange.first, ++in_range) {
+                    ASSERT_TRUE(crange.first != crange.second);
+                    ASSERT_EQ(&*range.first, &*crange.first);
+                    ASSERT_EQ(range.first->first, w);
+                }
+                ASSERT_TRUE(crange.first == crange.second);
+                ASSERT_EQ(in_range, n);
+            }
+            ASSERT_EQ(string_probe_hash::strings, 0u);
+            ASSERT_EQ(string_probe_equal::strings, 0u);
+
+            for (size_t i = 0; i != words.size(); ++i)
+                ASSERT_EQ(con.count(words[i].c_str()), con.count(words[i]));
+            ASSERT_GT(string_probe_hash::strings, 0u);
+        }
+
+        TEST(unordered_map, transparent_lookup_builds_no_string) {
+            check_transparent_lookup<qmj::unordered_map<std::string, size_t, string_probe_hash, string_probe_equal>>();
+            check_transparent_lookup<qmj::unordered_multimap<std::string, size_t, string_probe_hash,
+                    string_probe_equal>>();
+        }
+    }
+}